@@ -0,0 +1,79 @@
+/*! @file
+@brief Misura del tempo necessario per cambiare profilo radio
+
+Questo programma misura quanto dura `applicaProfilo()` alternando un profilo a
+lungo raggio (4.8 kbps, preambolo lungo) e uno per trasferimenti rapidi
+(200 kbps), e lo confronta con la scrittura di tutti i registri del profilo e
+con le funzioni di impostazione singole (`impostaBitRate()`, `impostaFreqDev()`).
+Basta una radio; i risultati sono stampati sul monitor seriale (115200 Baud).
+*/
+
+#include <Arduino.h>
+#include "RFM69.h"
+
+
+// Pin SS, pin Interrupt, (eventualmente pin Reset)
+RFM69 radio(RFM69::creaInterfacciaSpi(23), 2);
+
+// numero di cambi di profilo per ogni misura
+#define RIPETIZIONI 100
+
+
+RFM69::ProfiloRadio lungoRaggio;
+RFM69::ProfiloRadio rapido;
+RFM69::ProfiloRadio iniziale;
+
+
+void stampaRisultato(const __FlashStringHelper* nome, uint32_t totaleUs) {
+    Serial.print(nome);
+    Serial.print(F(": "));
+    Serial.print(totaleUs / RIPETIZIONI);
+    Serial.println(F(" us"));
+}
+
+
+void setup() {
+
+    Serial.begin(115200);
+    radio.inizializza(4, Serial);
+
+    radio.creaProfilo(lungoRaggio, "lungo raggio", 4800, 5000, 8);
+    radio.creaProfilo(rapido, "rapido", 200000, 100000);
+    radio.salvaProfilo(iniziale, "iniziale");
+
+    uint32_t totale;
+
+    // 1. Cambio tra due profili: solo i registri diversi
+    radio.applicaProfilo(lungoRaggio);
+    totale = 0;
+    for(int i = 0; i < RIPETIZIONI; i++) {
+        radio.applicaProfilo(i % 2 ? lungoRaggio : rapido);
+        totale += radio.durataUltimoCambioProfiloUs();
+    }
+    stampaRisultato(F("applicaProfilo (differenze)"), totale);
+
+    // 2. Scrittura completa: un profilo impostato in altro modo non è noto
+    totale = 0;
+    for(int i = 0; i < RIPETIZIONI; i++) {
+        radio.impostaBitRate(9600);
+        radio.applicaProfilo(i % 2 ? lungoRaggio : rapido);
+        totale += radio.durataUltimoCambioProfiloUs();
+    }
+    stampaRisultato(F("applicaProfilo (tutti i registri)"), totale);
+
+    // 3. Funzioni di impostazione singole (bit rate e Frequency Deviation)
+    totale = 0;
+    for(int i = 0; i < RIPETIZIONI; i++) {
+        uint32_t t = micros();
+        radio.impostaBitRate(i % 2 ? 4800 : 200000);
+        radio.impostaFreqDev(i % 2 ? 5000 : 100000);
+        totale += micros() - t;
+    }
+    stampaRisultato(F("impostaBitRate + impostaFreqDev"), totale);
+
+    radio.applicaProfilo(iniziale);
+}
+
+
+void loop() {
+}
@@ -0,0 +1,94 @@
+/*! @file
+@brief Misura del traffico consegnato a un gateway da molte radio
+
+Lo stesso programma va caricato su tutte le radio. Quella con GATEWAY 1
+riceve e ogni 10 secondi stampa sul monitor seriale (115200 Baud) i messaggi
+ricevuti al secondo e il carico del canale che riporta negli ACK. Le altre
+(GATEWAY 0) inviano messaggi con ACK il più spesso possibile e stampano la
+frazione di ACK ricevuti e l'intervallo scelto dal controllo della congestione.
+
+Con CONTROLLO 0 le radio inviano invece un messaggio ogni INTERVALLO ms, come
+nel test delle collisioni: aggiungendo radio il traffico consegnato dovrebbe
+crollare oltre la saturazione, mentre con CONTROLLO 1 dovrebbe restare vicino
+alla capacità del canale.
+*/
+
+#include <Arduino.h>
+#include "RFM69.h"
+
+
+// Pin SS, pin Interrupt, (eventualmente pin Reset)
+RFM69 radio(RFM69::creaInterfacciaSpi(23), 2);
+
+#define GATEWAY         0
+#define CONTROLLO       1
+#define INTERVALLO      20
+#define LUNGHEZZA       8
+
+RFM69::Memoria<LUNGHEZZA, 8, 0> memoriaRicezione;
+
+uint32_t nrInviati = 0, nrAck = 0, nrRicevuti = 0;
+uint32_t tempoInvio = 0, tempoStampa = 0;
+bool esitoDaContare = false;
+
+
+void setup() {
+
+    Serial.begin(115200);
+    radio.inizializza(memoriaRicezione, Serial);
+
+    if(GATEWAY) radio.attivaSegnalazioneCarico();
+    else if(CONTROLLO) radio.attivaControlloCongestione(INTERVALLO);
+
+    radio.modalitaRicezione();
+}
+
+
+void loop() {
+
+    radio.controlla();
+
+    if(GATEWAY) {
+        if(radio.nuovoMessaggio()) {
+            uint8_t messaggio[LUNGHEZZA];
+            uint8_t lunghezza = sizeof(messaggio);
+            if(radio.leggi(messaggio, lunghezza) == RFM69::Errore::ok) ++nrRicevuti;
+        }
+    }
+    else if(!radio.ackInSospeso() && (CONTROLLO || millis() - tempoInvio > INTERVALLO)) {
+        if(esitoDaContare && radio.ricevutoAck()) ++nrAck;
+        esitoDaContare = false;
+        uint8_t messaggio[LUNGHEZZA] = {0};
+        // con il controllo attivo l'invio è rifiutato finché non è il momento
+        if(radio.inviaConAck(messaggio, LUNGHEZZA) == RFM69::Errore::ok) {
+            tempoInvio = millis();
+            ++nrInviati;
+            esitoDaContare = true;
+        }
+    }
+
+    if(millis() - tempoStampa > 10000) {
+        tempoStampa = millis();
+
+        if(GATEWAY) {
+            Serial.print(F("ricevuti: "));
+            Serial.print(nrRicevuti / 10.0);
+            Serial.print(F(" mess/s, carico: "));
+            Serial.print(100 * radio.caricoCanale() / 255);
+            Serial.println(F(" %"));
+            nrRicevuti = 0;
+        }
+        else {
+            Serial.print(F("inviati: "));
+            Serial.print(nrInviati / 10.0);
+            Serial.print(F(" mess/s, ACK: "));
+            Serial.print(nrInviati ? 100 * nrAck / nrInviati : 0);
+            Serial.print(F(" %, intervallo: "));
+            Serial.print(radio.intervalloInvio());
+            Serial.print(F(" ms, carico riportato: "));
+            Serial.print(100 * radio.caricoCanale() / 255);
+            Serial.println(F(" %"));
+            nrInviati = nrAck = 0;
+        }
+    }
+}
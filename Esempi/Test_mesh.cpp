@@ -0,0 +1,98 @@
+/*! @file
+@brief Misura di consegna, latenza e sovraccarico di una rete mesh
+
+Lo stesso programma va caricato su tutte le radio, cambiando INDIRIZZO. La
+radio con indirizzo ORIGINE invia un messaggio numerato ogni INTERVALLO ms alla
+radio DESTINAZIONE; le altre fanno da ripetitori (per avere due o tre salti
+basta allontanarle o abbassare la potenza). Ogni 10 secondi tutte stampano
+sul monitor seriale (115200 Baud):
+- la destinazione: la frazione di messaggi arrivati (dai numeri mancanti);
+- tutte: consegna e latenza media per salto, messaggi inoltrati e persi, e
+  il tempo in aria aggiunto a ogni salto dall'intestazione mesh e dall'ACK;
+- le tabelle dei vicini e delle rotte.
+*/
+
+#include <Arduino.h>
+#include "RFM69.h"
+
+
+// Pin SS, pin Interrupt, (eventualmente pin Reset)
+RFM69 radio(RFM69::creaInterfacciaSpi(23), 2);
+
+#define INDIRIZZO       1
+#define ORIGINE         1
+#define DESTINAZIONE    3
+#define INTERVALLO      1000
+#define LUNGHEZZA       16
+
+// la coda di ricezione deve contenere anche l'intestazione mesh
+RFM69::Memoria<LUNGHEZZA + RFM69::byteIntestazioneMesh, 4, 0> memoriaRicezione;
+RFM69::MemoriaMesh<8, LUNGHEZZA, 4> memoriaMesh;
+
+uint32_t numeroInviato = 0;
+uint32_t primoRicevuto = 0, ultimoRicevuto = 0, nrRicevuti = 0;
+uint32_t tempoInvio = 0, tempoStampa = 0;
+
+
+void setup() {
+
+    Serial.begin(115200);
+    radio.inizializza(memoriaRicezione, Serial);
+
+    int errore = radio.attivaMesh(INDIRIZZO, memoriaMesh, 5000);
+    if(errore) radio.stampaErroreSerial(Serial, errore);
+
+    radio.modalitaRicezione();
+}
+
+
+void loop() {
+
+    radio.controlla();
+
+    if(INDIRIZZO == ORIGINE && millis() - tempoInvio > INTERVALLO) {
+        tempoInvio = millis();
+        uint8_t messaggio[LUNGHEZZA] = {0};
+        memcpy(messaggio, &numeroInviato, sizeof(numeroInviato));
+        if(radio.inviaMesh(DESTINAZIONE, messaggio, LUNGHEZZA) == RFM69::Errore::ok) {
+            ++numeroInviato;
+        }
+    }
+
+    // [origine][messaggio...]
+    if(radio.nuovoMessaggio()) {
+        uint8_t messaggio[LUNGHEZZA + 1];
+        uint8_t lunghezza = sizeof(messaggio);
+        if(radio.leggi(messaggio, lunghezza) == RFM69::Errore::ok && lunghezza > 4) {
+            uint32_t numero;
+            memcpy(&numero, messaggio + 1, sizeof(numero));
+            if(nrRicevuti == 0) primoRicevuto = numero;
+            ultimoRicevuto = numero;
+            ++nrRicevuti;
+        }
+    }
+
+    if(millis() - tempoStampa > 10000) {
+        tempoStampa = millis();
+
+        if(INDIRIZZO == DESTINAZIONE && nrRicevuti) {
+            Serial.print(F("consegna end-to-end: "));
+            Serial.print(100 * nrRicevuti / (ultimoRicevuto - primoRicevuto + 1));
+            Serial.println(F(" %"));
+        }
+        Serial.print(F("consegna per salto: "));
+        Serial.print(radio.consegnaSaltoMesh());
+        Serial.print(F(" %, latenza per salto: "));
+        Serial.print(radio.latenzaMediaSaltoUs());
+        Serial.println(F(" us"));
+        Serial.print(F("inoltrati: "));
+        Serial.print(radio.nrMessaggiInoltratiMesh());
+        Serial.print(F(", persi: "));
+        Serial.println(radio.nrMessaggiPersiMesh());
+        Serial.print(F("sovraccarico per salto: "));
+        Serial.print(radio.tempoInAria(LUNGHEZZA + RFM69::byteIntestazioneMesh)
+                     - radio.tempoInAria(LUNGHEZZA) + radio.tempoInAria(1));
+        Serial.println(F(" us in aria"));
+        radio.stampaTabelleMesh(Serial);
+    }
+}
@@ -0,0 +1,119 @@
+/*! @file
+@brief Verifica dell'"ora" di ricezione dei messaggi multicast
+
+`tempoRicezioneUs()` deve riferirsi alla fine della sync word qualunque sia
+il tipo di messaggio. Questo programma lo verifica con due radio: il
+mittente (MITTENTE 1) alterna un messaggio normale di LUNGHEZZA + 4 bytes e
+un broadcast di LUNGHEZZA bytes, che con l'intestazione multicast ha la
+stessa durata in aria. Dopo ognuno invia un secondo messaggio con l'"ora"
+esatta del primo (`tempoUltimoInvioUs()`).
+
+Il mittente è la radice della sincronizzazione del tempo, quindi il
+ricevente può confrontare le due "ore" sullo stesso orologio. Ogni 10
+messaggi stampa sul monitor seriale (115200 Baud) l'errore medio per i due
+tipi: la differenza deve essere di pochi microsecondi. Se il ricevente
+usasse la lunghezza senza intestazione il broadcast risulterebbe ricevuto
+4 bytes di tempo in aria più tardi.
+*/
+
+#include <Arduino.h>
+#include "RFM69.h"
+
+
+// Pin SS, pin Interrupt, (eventualmente pin Reset)
+RFM69 radio(RFM69::creaInterfacciaSpi(23), 2);
+
+#define MITTENTE        1
+#define LUNGHEZZA       16
+#define INTERVALLO      500
+
+// titoli dei messaggi
+#define NORMALE         1
+#define BROADCAST       2
+#define ORA_INVIO       3
+
+int32_t sommaErrori[2] = {0, 0};
+uint8_t nrErrori[2] = {0, 0};
+uint32_t oraRicezione[2];
+// il messaggio dell'ora riguarda solo un messaggio appena ricevuto
+bool ricevuto[2] = {false, false};
+uint32_t tempoInvio = 0;
+bool broadcast = false;
+
+RFM69::StatoSincronizzazione statoSincronizzazione;
+
+
+void setup() {
+
+    Serial.begin(115200);
+    radio.inizializza(LUNGHEZZA + 4, Serial);
+    radio.attivaSincronizzazione(MITTENTE, statoSincronizzazione, 2000);
+    radio.modalitaRicezione();
+}
+
+
+// Invia l'"ora" del messaggio appena inviato: [tipo][ora (4 bytes)]
+void inviaOra(uint8_t tipo) {
+    while(radio.staTrasmettendo()) radio.controlla();
+    uint8_t messaggio[5];
+    messaggio[0] = tipo;
+    uint32_t ora = radio.tempoUltimoInvioUs();
+    memcpy(messaggio + 1, &ora, sizeof(ora));
+    radio.invia(messaggio, sizeof(messaggio), ORA_INVIO);
+}
+
+
+void loop() {
+
+    radio.controlla();
+
+    if(MITTENTE) {
+        if(millis() - tempoInvio > INTERVALLO) {
+            tempoInvio = millis();
+            uint8_t messaggio[LUNGHEZZA + 4] = {0};
+            if(broadcast) {
+                if(radio.inviaBroadcast(messaggio, LUNGHEZZA, BROADCAST) == RFM69::Errore::ok) inviaOra(1);
+            }
+            else {
+                if(radio.invia(messaggio, LUNGHEZZA + 4, NORMALE) == RFM69::Errore::ok) inviaOra(0);
+            }
+            broadcast = !broadcast;
+        }
+        return;
+    }
+
+    if(!radio.nuovoMessaggio()) return;
+
+    uint8_t titolo = radio.titoloMessaggio();
+    uint32_t ora = radio.localeInGlobale(radio.tempoRicezioneUs());
+    uint8_t messaggio[LUNGHEZZA + 4];
+    uint8_t lunghezza = sizeof(messaggio);
+    if(radio.leggi(messaggio, lunghezza) != RFM69::Errore::ok) return;
+    if(!radio.sincronizzato()) return;
+
+    if(titolo == NORMALE || titolo == BROADCAST) {
+        uint8_t tipo = titolo == BROADCAST;
+        oraRicezione[tipo] = ora;
+        ricevuto[tipo] = true;
+    }
+    else if(titolo == ORA_INVIO && lunghezza == 5 && messaggio[0] < 2 && ricevuto[messaggio[0]]) {
+        uint8_t tipo = messaggio[0];
+        ricevuto[tipo] = false;
+        uint32_t oraInvio;
+        memcpy(&oraInvio, messaggio + 1, sizeof(oraInvio));
+        sommaErrori[tipo] += (int32_t)(oraRicezione[tipo] - oraInvio);
+        ++nrErrori[tipo];
+    }
+
+    if(nrErrori[0] >= 10 && nrErrori[1] >= 10) {
+        Serial.print(F("errore medio: normale "));
+        Serial.print(sommaErrori[0] / nrErrori[0]);
+        Serial.print(F(" us, broadcast "));
+        Serial.print(sommaErrori[1] / nrErrori[1]);
+        Serial.print(F(" us (4 bytes in aria: "));
+        Serial.print(radio.tempoInAria(LUNGHEZZA + 4) - radio.tempoInAria(LUNGHEZZA));
+        Serial.println(F(" us)"));
+        sommaErrori[0] = sommaErrori[1] = 0;
+        nrErrori[0] = nrErrori[1] = 0;
+    }
+}
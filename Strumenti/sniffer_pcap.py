@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Convertitore per il flusso dello sniffer RFM69 (cfr. `RFM69::attivaSniffer()`).
+
+Legge il flusso pcap scritto dalla radio sulla porta seriale (o da un file già
+salvato), lo salva in un file .pcap apribile con Wireshark e, se richiesto,
+stampa ogni pacchetto decodificato.
+
+Esempi:
+    sniffer_pcap.py /dev/ttyUSB0 -b 115200 -o cattura.pcap
+    sniffer_pcap.py flusso.bin -o cattura.pcap --testo
+
+La lettura dalla porta seriale richiede pyserial. Eventuali bytes scritti sulla
+porta prima dell'intestazione pcap (ad es. messaggi di avvio) sono ignorati.
+
+Formato di un record (tipo di collegamento LINKTYPE_USER0 = 147):
+    [0]     versione (1)
+    [1]     flag: bit 0 CRC corretto
+    [2]     RSSI in dBm (int8)
+    [3]     numero di byte di parità FEC alla fine del pacchetto
+    [4-7]   errore di frequenza (AFC) in Hz (int32 little endian)
+    [8-11]  frequenza in Hz (uint32 little endian)
+    [12]    intestazione: bit 0 ack, bit 1 richiesta ACK, bit 2-7 titolo
+    [13-]   messaggio e byte di parità
+
+In Wireshark: Preferenze > Protocolli > DLT_USER, DLT 147, per associare un
+dissector; senza di esso i pacchetti sono mostrati come dati grezzi.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = struct.pack('<I', 0xA1B2C3D4)
+LUNGHEZZA_INTESTAZIONE_GLOBALE = 24
+LUNGHEZZA_INTESTAZIONE_RECORD = 16
+LUNGHEZZA_INTESTAZIONE_COLLEGAMENTO = 12
+TITOLO_SERVIZIO = 63
+
+
+def apri_ingresso(nome, baud):
+    """Restituisce un oggetto con read(n): porta seriale o file ("-" è stdin)."""
+    if nome == '-':
+        return sys.stdin.buffer
+    if nome.startswith('/dev/') or nome.upper().startswith('COM'):
+        try:
+            import serial
+        except ImportError:
+            sys.exit('per leggere da una porta seriale serve pyserial (pip install pyserial)')
+        return serial.Serial(nome, baud)
+    return open(nome, 'rb')
+
+
+def leggi_esatti(ingresso, n):
+    """Legge esattamente n bytes, None alla fine del flusso."""
+    dati = b''
+    while len(dati) < n:
+        parte = ingresso.read(n - len(dati))
+        if not parte:
+            return None
+        dati += parte
+    return dati
+
+
+def cerca_intestazione(ingresso):
+    """Scarta i bytes fino al magic number e restituisce l'intestazione globale."""
+    finestra = b''
+    while True:
+        b = ingresso.read(1)
+        if not b:
+            return None
+        finestra = (finestra + b)[-4:]
+        if finestra == MAGIC:
+            resto = leggi_esatti(ingresso, LUNGHEZZA_INTESTAZIONE_GLOBALE - 4)
+            return None if resto is None else MAGIC + resto
+
+
+def descrivi(secondi, microsecondi, dati, lunghezza_originale):
+    if len(dati) < LUNGHEZZA_INTESTAZIONE_COLLEGAMENTO:
+        return '%d.%06d record troppo corto' % (secondi, microsecondi)
+    versione, flag, rssi, parita, afc, frequenza = struct.unpack('<BBbBiI', dati[:12])
+    pacchetto = dati[12:]
+    testo = '%d.%06d %.4f MHz rssi %d dBm afc %+d Hz %s' % (
+        secondi, microsecondi, frequenza / 1e6, rssi, afc, 'crc ok' if flag & 1 else 'CRC ERRATO')
+    if pacchetto:
+        intestazione = pacchetto[0]
+        titolo = intestazione >> 2
+        tipo = 'ack' if intestazione & 0x01 else ('servizio' if titolo == TITOLO_SERVIZIO else 'titolo %d' % titolo)
+        messaggio = pacchetto[1:len(pacchetto) - parita] if parita else pacchetto[1:]
+        testo += ' %s%s [%d] %s' % (tipo, ' (richiesta ACK)' if intestazione & 0x02 else '',
+                                    len(messaggio), messaggio.hex())
+    if lunghezza_originale > len(dati):
+        testo += ' (troncato, %d bytes)' % (lunghezza_originale - LUNGHEZZA_INTESTAZIONE_COLLEGAMENTO)
+    return testo
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Salva e decodifica il flusso dello sniffer RFM69')
+    parser.add_argument('ingresso', help='porta seriale, file o "-" per stdin')
+    parser.add_argument('-b', '--baud', type=int, default=115200, help='velocità della porta seriale')
+    parser.add_argument('-o', '--uscita', help='file .pcap da scrivere')
+    parser.add_argument('--testo', action='store_true', help='stampa ogni pacchetto')
+    args = parser.parse_args()
+
+    if not args.uscita and not args.testo:
+        parser.error('indicare almeno --uscita o --testo')
+
+    ingresso = apri_ingresso(args.ingresso, args.baud)
+    intestazione = cerca_intestazione(ingresso)
+    if intestazione is None:
+        sys.exit('intestazione pcap non trovata')
+
+    uscita = open(args.uscita, 'wb') if args.uscita else None
+    if uscita:
+        uscita.write(intestazione)
+
+    pacchetti = errati = 0
+    try:
+        while True:
+            record = leggi_esatti(ingresso, LUNGHEZZA_INTESTAZIONE_RECORD)
+            if record is None:
+                break
+            secondi, microsecondi, salvati, originale = struct.unpack('<IIII', record)
+            # un riavvio della radio scrive una nuova intestazione globale
+            if record[:4] == MAGIC:
+                leggi_esatti(ingresso, LUNGHEZZA_INTESTAZIONE_GLOBALE - LUNGHEZZA_INTESTAZIONE_RECORD)
+                continue
+            dati = leggi_esatti(ingresso, salvati)
+            if dati is None:
+                break
+            pacchetti += 1
+            if len(dati) > 1 and not dati[1] & 1:
+                errati += 1
+            if uscita:
+                uscita.write(record + dati)
+                uscita.flush()
+            if args.testo:
+                print(descrivi(secondi, microsecondi, dati, originale))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if uscita:
+            uscita.close()
+
+    print('%d pacchetti, %d con CRC errato' % (pacchetti, errati), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -50,7 +50,9 @@ public:
 
    //! Helper per il constructor: usa l'interfaccia SPI
    /*! Questa funzione genera un oggetto della classe 'RFM69::Spi', che gestisce
-    la comunicazione con la radio.
+    la comunicazione con la radio. L'oggetto è costruito in una memoria statica
+    della classe (non nello heap), che può contenere una sola interfaccia: la
+    funzione va chiamata una sola volta (come quella sottostante).
         @param pinSS Numero del pin Slave Select
    */
    static Bus* creaInterfacciaSpi(uint8_t pinSS);
@@ -101,13 +103,17 @@ public:
         - scrive tutti i registri della radio inserendovi le impostazioni stabilite
             nel file RFM69_impostazioni.h
         - inizializza alcune variabili della classe
-        - crea un buffer di `lunghezzaMaxMessaggio` bytes che resterà allocato
-            fino alla distruzione dell'istanza della classe.
+        - crea una coda di `nrMessaggiInCoda` messaggi di `lunghezzaMaxMessaggio`
+            bytes che resterà allocata fino alla distruzione dell'istanza della
+            classe.
 
         @note L'esecuzione di questa funzione richiede alcuni decimi di secondo.
 
 
-        @note Sarà allocata un'array di `lunghezzaMaxMessaggio` bytes.
+        @note Sarà allocata un'array di `(nrMessaggiInCoda + 1) *
+              lunghezzaMaxMessaggio` bytes: una posizione in più resta sempre
+              libera per scaricare il messaggio (o l'ACK) successivo senza
+              sovrascrivere quelli in attesa di lettura.
 
         @param lunghezzaMaxMessaggio  Lunghezza massima dei messagi ricevuti da
         questa radio. Può essere diverso dalla lunghezza massima dei messaggi
@@ -116,10 +122,13 @@ public:
         interna mentre la radio li sta ricevendo, mentre nell'attuale
         implementazione di questa libreria è possibile leggerli solo dopo che
         sono arrivati).
+        @param nrMessaggiInCoda  Numero di messaggi ricevuti che possono
+        aspettare di essere letti (1 - `maxMessaggiInCoda`). Quando la coda è
+        piena i nuovi messaggi sono scartati senza inviare l'ACK.
 
         @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
     */
-    int inizializza(uint8_t lunghezzaMaxMessaggio);
+    int inizializza(uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda = 1);
 
     //! Inizializza la radio e stampa il risultato (ok o errore...) sul monitor seriale.
     /*! Questa funzione chima `inizializza(uint8_t)` e `stampaErroreSerial()`:
@@ -136,7 +145,48 @@ public:
         @return La funzione restituisce comunque il codice di errore restituito da
                 `inizializza(uint8_t)`
     */
-    int inizializza(uint8_t lunghezzaMaxMessaggio, HardwareSerial& serial);
+    int inizializza(uint8_t lunghezzaMaxMessaggio, HardwareSerial& serial, uint8_t nrMessaggiInCoda = 1);
+
+    //! Memoria statica per la coda di ricezione
+    /*! Alternativa all'allocazione dinamica della coda in `inizializza(uint8_t)`:
+        la memoria è dichiarata dall'utente (tipicamente come variabile globale)
+        e la sua dimensione è quindi nota al momento della compilazione.
+        ~~~{.cpp}
+        RFM69::Memoria<20, 4> memoriaRadio; // messaggi di 20 bytes, 4 in coda
+        ...
+        radio.inizializza(memoriaRadio);
+        ~~~
+        @tparam lunghezzaMaxMessaggio  cfr. `inizializza(uint8_t)`
+        @tparam nrMessaggiInCoda       cfr. `inizializza(uint8_t)`
+        @tparam byteParitaFEC          deve essere almeno uguale a FEC_BYTE_PARITA
+                                       se la FEC è attiva nel file di impostazione
+    */
+    template<uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda = 1, uint8_t byteParitaFEC = 0>
+    class Memoria;
+
+    //! Inizializza la radio usando una memoria statica per la coda di ricezione
+    /*! Come `inizializza(uint8_t)`, ma senza alcuna allocazione dinamica. La
+        memoria deve esistere fino alla distruzione dell'istanza della classe (o
+        alla prossima inizializzazione).
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+                (`initLunghMaxMessEccessiva` anche se `memoria` non ha spazio
+                per i byte di parità della FEC)
+    */
+    template<uint8_t lung, uint8_t nr, uint8_t fec>
+    int inizializza(Memoria<lung, nr, fec>& memoria) {
+        return inizializza(lung, nr, memoria.dati, memoria.info, fec);
+    }
+
+    //! Inizializza la radio usando una memoria statica e stampa il risultato
+    /*! cfr. `inizializza(uint8_t, HardwareSerial&)`
+    */
+    template<uint8_t lung, uint8_t nr, uint8_t fec>
+    int inizializza(Memoria<lung, nr, fec>& memoria, HardwareSerial& serial) {
+        return inizializza(lung, nr, memoria.dati, memoria.info, fec, serial);
+    }
+
+    //! Numero massimo di messaggi nella coda di ricezione
+    static constexpr uint8_t maxMessaggiInCoda = 16;
 
 
     //! Test della connessione con il dispositivo
@@ -290,18 +340,25 @@ public:
 
 
     //! Controlla se c'è un nuovo messaggio
-    /*! @return `true` se il buffer della classe contiene un nuovo messaggio.
+    /*! @return `true` se la coda della classe contiene almeno un messaggio.
     */
     bool nuovoMessaggio();
 
+    //! Restituisce il numero di messaggi in attesa di essere letti
+    uint8_t nrMessaggiInCoda() {return buffer.nrMessaggi();}
+
     //! Restituisce la dimensione dell'ultimo mesasggio
-    /*! @return la dimensione dell'utlimo messaggio ricevuto in bytes
+    /*! Se ci sono messaggi in coda le funzioni `dimensioneMessaggio()`,
+        `titoloMessaggio()` e `tempoRicezione()` si riferiscono al prossimo
+        messaggio che sarà restituito da `leggi()`.
+        @return la dimensione dell'utlimo messaggio ricevuto in bytes
     */
     uint8_t dimensioneMessaggio();
 
     //! Restituisce il titolo dell'ultimo messaggio
-    /*! Il titolo di un messaggio è un numero compreso tra 1 e 64 scritto
+    /*! Il titolo di un messaggio è un numero compreso tra 0 e 62 scritto
         nell'intestazione dall'utente (con il parametro `titolo` di `invia()`).
+        Il titolo 63 è riservato ai messaggi di servizio della classe.
         La classe si limita a inviarlo e renderlo disponibile prima della lettura
         del messaggio tramite questa funzione, non lo utilizza. L'utente può
         usarlo per scartare subito messaggi non interessanti e dare grande importanza
@@ -366,6 +423,147 @@ public:
     bool ricevutoAck(uint8_t titolo);
 
 
+    //!@}
+    /*! @name Ricezione tramite funzioni di gestione
+    Alternativa a `nuovoMessaggio()` e `leggi()`: la classe chiama una funzione
+    dell'utente appena un messaggio è arrivato. I collegamenti tra titoli e
+    funzioni sono in una tabella dell'utente (cfr. `attivaFunzioniRicezione()`).
+    */
+    //!@{
+
+    //! Vista in sola lettura di un messaggio ricevuto
+    /*! Passata alle funzioni di gestione collegate con
+        `collegaFunzioneRicezione()` e restituita da `prestaMessaggio()`. Nel
+        primo caso i dati sono una copia valida solo durante la chiamata alla
+        funzione, nel secondo restano nella coda fino alla chiamata a
+        `rilasciaMessaggio()`.
+    */
+    struct Messaggio {
+        //! contenuto del messaggio
+        const uint8_t* dati;
+        //! lunghezza del contenuto in bytes
+        uint8_t lunghezza;
+        //! titolo (cfr. `titoloMessaggio()`)
+        uint8_t titolo;
+        //! il mittente ha richiesto un ACK (già inviato dalla classe)
+        bool richiestaAck;
+        //! RSSI del messaggio
+        int8_t rssi;
+        //! "ora" della ricezione in millisecondi (cfr. `tempoRicezione()`)
+        uint32_t tempoRicezione;
+        //! "ora" della ricezione in microsecondi (cfr. `tempoRicezioneUs()`)
+        uint32_t tempoRicezioneUs;
+    };
+
+    //! Tipo delle funzioni di gestione dei messaggi
+    typedef void (*FunzioneRicezione)(const Messaggio& messaggio);
+
+    //! Numero massimo di funzioni di gestione collegate a un titolo
+    static constexpr uint8_t maxFunzioniRicezione = 4;
+
+    //! Tabella delle funzioni di gestione (contenuto privato)
+    class TabellaRicezione;
+
+    //! Attiva la ricezione tramite funzioni di gestione
+    /*! La tabella è svuotata: le funzioni vanno collegate dopo.
+        @param tabella  tabella dei collegamenti. Deve esistere finché la
+                        ricezione tramite funzioni è attiva.
+    */
+    void attivaFunzioniRicezione(TabellaRicezione& tabella);
+
+    //! Disattiva la ricezione tramite funzioni di gestione (i messaggi tornano
+    //! nella coda)
+    void disattivaFunzioniRicezione();
+
+    //! Collega una funzione ai messaggi con un certo titolo
+    /*! La funzione sarà chiamata da `controlla()` (quindi anche da
+        `nuovoMessaggio()`, `ackInSospeso()`, ...) durante la stessa esecuzione
+        in cui il messaggio è scaricato dalla radio. I messaggi consegnati a una
+        funzione sono considerati letti: `nuovoMessaggio()` non li segnala e
+        non bisogna chiamare `leggi()`.
+
+        La funzione può inviare messaggi e chiamare `controlla()`: riceve una
+        copia del messaggio, che un nuovo messaggio scaricato nel frattempo non
+        sovrascrive. I messaggi arrivati durante la chiamata vanno in coda.
+
+        Collegare una nuova funzione a un titolo che ne ha già una la sostituisce.
+
+        @param titolo    titolo dei messaggi da gestire (0 - 62)
+        @param funzione  funzione da chiamare
+        @return `false` se il titolo non è valido, se la ricezione tramite
+                funzioni non è attiva o se sono già collegate
+                `maxFunzioniRicezione` funzioni
+    */
+    bool collegaFunzioneRicezione(uint8_t titolo, FunzioneRicezione funzione);
+
+    //! Scollega la funzione collegata a un titolo
+    void scollegaFunzioneRicezione(uint8_t titolo);
+
+    //! Collega una funzione ai messaggi con un titolo senza una funzione propria
+    /*! Se nessuna funzione è collegata (`nullptr`, il default) i messaggi sono
+        segnalati da `nuovoMessaggio()` e letti con `leggi()` come al solito.
+        @return `false` se la ricezione tramite funzioni non è attiva
+    */
+    bool collegaFunzioneRicezioneDefault(FunzioneRicezione funzione);
+
+
+    //!@}
+    /*! @name Lettura senza copia
+    Alternativa a `leggi()` che evita di copiare il messaggio in un'array
+    dell'utente
+    */
+    //!@{
+
+    //! Accede al prossimo messaggio in coda direttamente nella memoria della classe
+    /*! Il messaggio resta in coda, e i suoi dati non sono sovrascritti dai
+        messaggi che arrivano nel frattempo, fino alla chiamata a
+        `rilasciaMessaggio()`. Chiamando di nuovo questa funzione prima del
+        rilascio si ottiene lo stesso messaggio.
+
+        @note Come per `leggi()`, se la coda è piena la radio resta in standby
+        fino al rilascio del messaggio (cfr. `scartaMessaggio()`).
+
+        @param messaggio [out] vista del messaggio (cfr. RFM69::Messaggio)
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int prestaMessaggio(Messaggio& messaggio);
+
+    //! Rilascia il messaggio ottenuto con `prestaMessaggio()`
+    /*! Il messaggio è tolto dalla coda e la sua posizione può essere usata per
+        un nuovo messaggio: i dati restituiti da `prestaMessaggio()` non vanno più
+        usati.
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int rilasciaMessaggio();
+
+
+    //!@}
+    /*! @name Filtro dei messaggi in entrata
+    Permette di scartare i messaggi non interessanti leggendo dalla radio solo
+    lunghezza e intestazione
+    */
+    //!@{
+
+    //! Sceglie i titoli dei messaggi da ricevere
+    /*! I messaggi con un titolo escluso sono scartati appena ne è letta
+        l'intestazione: il contenuto non è trasferito dalla radio (la FIFO è
+        svuotata), il messaggio non entra in coda e non è passato alle funzioni
+        di gestione. Se il mittente lo ha richiesto l'ACK è comunque inviato.
+        Gli ACK e i messaggi di servizio non sono mai filtrati.
+
+        @note Con la FEC attiva l'intestazione di un messaggio arrivato con
+        degli errori non è affidabile prima della correzione: in questo caso il
+        messaggio è scaricato per intero e filtrato dopo.
+
+        @param maschera  il bit `n` (`1ULL << n`) corrisponde al titolo `n`: i
+            messaggi sono ricevuti se vale 1. Il default è `~0ULL` (tutti i titoli).
+    */
+    void impostaFiltroTitoli(uint64_t maschera) {titoliAccettati = maschera;}
+
+    //! Include o esclude un solo titolo (cfr. `impostaFiltroTitoli()`)
+    void accettaTitolo(uint8_t titolo, bool accetta);
+
+
     //!@}
     /*! @name Funzioni di impostazione
     Impostazioni nel file di impostazione che possono essere modificate anche nel
@@ -415,8 +613,8 @@ public:
     */
     //! Imposta la frequenza di comunicazione
     /*! Imposta la frequenza della trasmissione radio.
-        @note La funzione non impone limiti al valore ricevuto. Esistono però due
-              limiti:
+        @note La funzione rifiuta solo i valori fuori dalla banda del chip
+              (290 - 1020 MHz). Esistono però altri due limiti:
 
               - Il limite del modulo, che esiste in 4 varianti diverse con ciascuna
                 una banda di frequenze possibili diversa;
@@ -424,6 +622,9 @@ public:
                 lasciando alcune bande ben definite a moduli a bassa potenza come
                 questo.
 
+        @note Con il salto di frequenza attivo (cfr. `attivaFHSS()`) la
+              frequenza è cambiata di nuovo al prossimo salto.
+
         @param freq La frequenza di trasmissione in Hertz
 
         @return Errore secondo l'`enum` `Errore::ListaErrori` (1 se c'è un errore
@@ -432,6 +633,1150 @@ public:
     int impostaFrequenzaMHz(uint32_t freq);
 
 
+    //!@}
+    /*! @name Profili radio
+    Un profilo è un'immagine compatta dei registri di modulazione, bit rate,
+    Frequency Deviation, channel filter, preambolo e sync word. Passare da un
+    profilo all'altro richiede la scrittura in sequenza (una sola comunicazione
+    per gruppo di registri adiacenti) dei soli registri che cambiano, invece di
+    una nuova inizializzazione.
+    */
+    //!@{
+
+    //! Numero di registri in un profilo
+    static constexpr uint8_t nrRegistriProfilo = 18;
+
+    //! Impostazioni della radio da applicare tutte insieme
+    struct ProfiloRadio {
+        //! Nome del profilo (solo per l'utente)
+        const char* nome;
+        //! DataModul, BitRate, Fdev (0x02 - 0x06), RxBw, AfcBw (0x19 - 0x1A),
+        //! Preamble, SyncConfig, SyncValue (0x2C - 0x36)
+        uint8_t registri[nrRegistriProfilo];
+    };
+
+    //! Banda necessaria per ricevere un segnale FSK
+    /*! Banda occupata dal segnale (Carson, `2*freqDev + bitRate`) più lo
+        scarto tra le portanti di due radio: ciascun quarzo può sbagliare di
+        `tolleranzaPpm`, in senso opposto all'altro, e lo scarto può cadere su
+        entrambi i lati. È la formula di `RX_BW` nel file di impostazione.
+
+        @return la banda (su due lati) in Hz
+    */
+    static constexpr uint32_t bandaNecessariaFSK(uint32_t bitRate, uint32_t freqDev,
+                                                 uint32_t frequenza, uint8_t tolleranzaPpm = 70) {
+        return 2 * freqDev + bitRate + 4 * (frequenza / 1000000) * tolleranzaPpm;
+    }
+
+    //! Configurazione FSK verificata in fase di compilazione
+    /*! Calcola i valori dei registri di bit rate, Frequency Deviation e
+        channel filter (il più stretto che contiene il segnale e l'errore dei
+        quarzi di entrambe le radio) e interrompe la compilazione se i valori
+        non rispettano i vincoli del datasheet. Ad esempio:
+
+            radio.creaProfilo(profilo, "lento", RFM69::Configurazione<4800, 5000, 434000000>());
+
+        @tparam bitRate        bit rate in bit al secondo (1'200 - 300'000)
+        @tparam freqDev        Frequency Deviation in Hz (almeno 600, con
+                               `freqDev + bitRate/2 <= 500 kHz` e indice di
+                               modulazione `2*freqDev/bitRate` tra 0.5 e 10)
+        @tparam frequenza      frequenza della portante in Hz
+        @tparam tolleranzaPpm  errore massimo di ciascun quarzo in ppm
+    */
+    template<uint32_t bitRate, uint32_t freqDev, uint32_t frequenza, uint8_t tolleranzaPpm = 70>
+    class Configurazione;
+
+    //! Crea un profilo FSK da una configurazione verificata in fase di compilazione
+    /*! Modulazione, DCC e sync word sono quelle del file di impostazione.
+        @param profilo        profilo da riempire
+        @param nome           nome del profilo
+        @param configurazione cfr. `Configurazione`
+        @param preambolo      lunghezza del preambolo in bytes (0: quella del
+                              file di impostazione)
+    */
+    template<uint32_t br, uint32_t fd, uint32_t f, uint8_t t>
+    void creaProfilo(ProfiloRadio& profilo, const char* nome,
+                     Configurazione<br, fd, f, t> configurazione, uint16_t preambolo = 0) {
+        (void)configurazione;
+        riempiProfilo(profilo, nome, Configurazione<br, fd, f, t>::valBitRate,
+                      Configurazione<br, fd, f, t>::valFreqDev,
+                      Configurazione<br, fd, f, t>::valRxBw, preambolo);
+    }
+
+    //! Crea un profilo FSK con valori noti solo durante l'esecuzione
+    /*! Come sopra, con la frequenza del file di impostazione, ma i vincoli
+        sono verificati solo ora.
+        @param bitRate   bit rate in bit al secondo (1'200 - 300'000)
+        @param freqDev   Frequency Deviation in Hz
+        @param preambolo lunghezza del preambolo in bytes (0: quella del file di impostazione)
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int creaProfilo(ProfiloRadio& profilo, const char* nome, uint32_t bitRate,
+                    uint32_t freqDev, uint16_t preambolo = 0);
+
+    //! Salva le impostazioni attuali della radio in un profilo
+    void salvaProfilo(ProfiloRadio& profilo, const char* nome);
+
+    //! Applica un profilo
+    /*! Scrive solo i registri diversi da quelli del profilo applicato per
+        ultimo (tutti se le impostazioni sono state cambiate in altro modo, ad
+        es. con `impostaBitRate()` o dalla bit rate adattiva). La radio passa
+        per lo standby e torna poi nella modalità default.
+        @warning Il profilo non deve essere modificato finché è attivo, e deve
+                 essere lo stesso su entrambe le radio.
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int applicaProfilo(const ProfiloRadio& profilo);
+
+    //! Restituisce il nome del profilo attivo (nullptr se non è noto)
+    const char* nomeProfiloAttivo() {return profiloRadioAttivo ? profiloRadioAttivo->nome : nullptr;}
+
+    //! Restituisce la durata dell'ultimo `applicaProfilo()` in us (scrittura e standby)
+    uint16_t durataUltimoCambioProfiloUs() {return durataCambioProfiloUs;}
+
+
+    //!@}
+    /*! @name Adattamento del collegamento
+    Permettono alle radio di adattare da sole le impostazioni di trasmissione
+    alla qualità del collegamento
+    */
+    //!@{
+
+    //! Attiva l'adattamento automatico della bit rate
+    /*! La bit rate, con la Frequency Deviation e la bandwidth del channel
+        filter adatte, è scelta da una tabella di profili che va da 4.8 kbps
+        (il profilo di "rendezvous") a 250 kbps.
+
+        La radio che invia messaggi con ACK valuta a gruppi di alcuni messaggi
+        quanti ACK sono arrivati e con che RSSI medio. Se il collegamento lo
+        permette (o lo richiede) propone all'altra radio di passare al profilo
+        successivo (o precedente); il cambio avviene solo se la proposta è
+        confermata da un ACK. Ogni tentativo di `inviaFinoAck()` conta, quindi
+        anche le ritrasmissioni abbassano la bit rate.
+
+        Se qualcosa va storto (troppi ACK persi di seguito, oppure nessun
+        messaggio ricevuto per `timeoutRendezvous` ms) la radio torna al
+        profilo di rendezvous, dove prima o poi la raggiungerà anche l'altra.
+
+        @warning Deve essere attivato su entrambe le radio, che devono essere
+        solo due (collegamento punto-punto). I profili sono pensati per la
+        modulazione FSK.
+
+        @note La proposta di cambio è un messaggio con ACK inviato da
+        `controlla()`: la chiamata durante la quale avviene dura qualche
+        millisecondo in più del solito. Lo stato dell'ultimo ACK dell'utente
+        non è modificato.
+
+        @param timeoutRendezvous tempo in millisecondi senza messaggi ricevuti
+               dopo il quale la radio torna al profilo di rendezvous
+    */
+    void attivaBitRateAdattiva(uint16_t timeoutRendezvous = 10000);
+
+    //! Disattiva l'adattamento della bit rate
+    /*! La radio continua a usare il profilo attuale.
+    */
+    void disattivaBitRateAdattiva();
+
+    //! Restituisce la bit rate attualmente in uso (bit al secondo)
+    uint32_t bitRateAttuale() {return bitRateCorrente;}
+
+    //! Attiva il controllo automatico della potenza di trasmissione
+    /*! Ogni ACK contiene l'RSSI con cui l'altra radio ha ricevuto il messaggio
+        confermato. Con questo dato la radio abbassa la propria potenza fino a
+        mantenere l'RSSI dell'altra radio `margine` dB sopra la sensibilità
+        stimata per la bit rate in uso, e la rialza subito se l'RSSI scende o
+        se un ACK si perde. Le variazioni di pochi dB sono ignorate.
+
+        La potenza non supera mai l'ultimo valore passato a `impostaPotenzaTx()`
+        (o POTENZA_TX del file di impostazione) e non scende sotto -2 dBm.
+
+        @note Se è attiva anche la bit rate adattiva questa valuta il
+        collegamento come se la radio trasmettesse alla potenza massima.
+
+        @param margine margine in dB sopra la sensibilità
+    */
+    void attivaControlloPotenza(uint8_t margine = 10);
+
+    //! Disattiva il controllo della potenza e torna alla potenza massima
+    void disattivaControlloPotenza();
+
+    //! Restituisce la potenza di trasmissione attuale in dBm
+    int8_t potenzaTxAttuale() {return potenzaTx;}
+
+    //! Restituisce l'RSSI con cui l'altra radio ha ricevuto l'ultimo messaggio confermato
+    /*! @return il valore RSSI riportato nell'ultimo ACK ricevuto
+    */
+    int8_t rssiAltraRadio() {return rssiRiportato;}
+
+    //! Calcola la durata della trasmissione di un messaggio
+    /*! Comprende preambolo, sync word, lunghezza, intestazione, parità FEC e
+        CRC alla bit rate attuale.
+        @param lunghezza lunghezza del messaggio (come per `invia()`)
+        @return la durata in microsecondi
+    */
+    uint32_t tempoInAria(uint8_t lunghezza);
+
+    //! Restituisce l'energia di trasmissione spesa per ogni byte consegnato
+    /*! Stima basata sulla corrente assorbita in trasmissione alle varie potenze
+        (datasheet di RFM69HCW, alimentazione a 3.3V) e sulla durata delle
+        trasmissioni. Comprende messaggi, ritrasmissioni e ACK inviati, ma
+        contano come consegnati solo i bytes dei messaggi confermati da un ACK.
+        @return energia in microjoule per byte consegnato
+    */
+    uint32_t energiaPerByte() {return byteConsegnati ? energiaTx / byteConsegnati : 0;}
+
+
+    //!@}
+    /*! @name Stima dei collegamenti
+    Stima della qualità del collegamento con ogni corrispondente, a
+    disposizione dell'applicazione (scelta di una rotta, della bit rate, della
+    potenza...). Un messaggio ricevuto e l'esito di un invio sono attribuiti
+    al corrispondente attuale, come per la correzione della frequenza (cfr.
+    `selezionaCorrispondente()`; sul coordinatore TDMA il nodo dello slot).
+    Ogni aggiornamento costa un accesso alla tabella, in `controlla()`.
+
+    Con il mesh attivo la tabella dei vicini del mesh contiene le stesse stime
+    per indirizzo (cfr. `stimaVicinoMesh()`) e questa non è aggiornata.
+    */
+    //!@{
+
+    //! Stima del collegamento con un corrispondente
+    struct StimaCollegamento {
+        //! RSSI medio in sedicesimi di dBm (media mobile esponenziale, peso 1/8)
+        int16_t rssi16;
+        //! Frazione degli invii confermati da un ACK (PRR), in 255-esimi
+        //! (media mobile esponenziale, peso 1/8; vale 192 prima del primo invio)
+        uint8_t prr;
+        //! Numero atteso di trasmissioni per consegnare un messaggio (ETX =
+        //! 1 / PRR), in sedicesimi. Comprende la perdita degli ACK.
+        uint16_t etx16;
+        //! Invii con richiesta di ACK
+        uint16_t inviati;
+        //! Invii rimasti senza ACK, cioè ritrasmissioni necessarie
+        uint16_t ritrasmissioni;
+        //! Messaggi ricevuti
+        uint16_t ricevuti;
+        //! `millis()` alla ricezione dell'ultimo messaggio
+        uint32_t ultimoContatto;
+    };
+
+    //! Attiva la stima dei collegamenti
+    /*! @param tabella          tabella delle stime, un elemento per
+                                corrispondente. Deve esistere finché la stima
+                                è attiva.
+        @param nrCorrispondenti numero di elementi della tabella
+    */
+    void attivaStimaCollegamenti(StimaCollegamento tabella[], uint8_t nrCorrispondenti);
+
+    //! Disattiva la stima dei collegamenti
+    void disattivaStimaCollegamenti();
+
+    //! Restituisce la stima per un corrispondente (nullptr se non c'è)
+    const StimaCollegamento* stimaCollegamento(uint8_t corrispondente) {
+        return corrispondente < nrCorrispondentiCollegamenti ? tabellaCollegamenti + corrispondente : nullptr;
+    }
+
+
+    //!@}
+    /*! @name Controllo della congestione
+    Quando molte radio inviano a una sola (un gateway) le ritrasmissioni dopo
+    le collisioni aumentano il traffico proprio quando il canale è saturo, e
+    la frazione di messaggi consegnati crolla (cfr. Esempi/Test_collisioni).
+    Con il controllo attivo ogni radio limita la frequenza dei propri invii
+    con ACK (AIMD): ogni ACK ricevuto la aumenta di 1/16 di messaggio al
+    secondo, ogni ACK perso la dimezza. Così le radio si dividono il canale
+    e il traffico totale resta vicino alla sua capacità.
+
+    Il gateway può inoltre riportare in ogni ACK il carico del canale che
+    misura (cfr. `attivaSegnalazioneCarico()`): sopra il carico obiettivo un
+    ACK ricevuto riduce la frequenza di 1/8 invece di aumentarla, prima che
+    le collisioni comincino. Gli ACK senza questa informazione (radio che non
+    la segnalano) valgono come carico nullo.
+    */
+    //!@{
+
+    //! Attiva il controllo della congestione
+    /*! Da questo momento `inviaConAck()` restituisce `Errore::inviaCongestione`
+        se è troppo presto per un nuovo invio (cfr. `invioConsentito()`),
+        `inviaFinoAck()` aspetta (chiamando `controlla()`) prima di ogni
+        tentativo, e anche i messaggi mesh rispettano lo stesso limite. Ogni
+        attesa varia a caso tra 3/4 e 5/4 dell'intervallo, perché radio che
+        hanno perso lo stesso ACK non ritrasmettano di nuovo insieme.
+
+        La frequenza parte da quella dell'intervallo massimo moltiplicata per
+        otto (o da quella massima, se più bassa).
+
+        @note Con il TDMA gli invii dei nodi non sono limitati: gli slot sono
+        già esclusivi.
+
+        @param intervalloMinimo   intervallo minimo in ms tra due invii (frequenza massima)
+        @param intervalloMassimo  intervallo massimo in ms tra due invii, anche
+                                  dopo molte perdite di seguito
+        @param caricoObiettivo    carico riportato dal gateway (in 255-esimi del
+                                  tempo) oltre il quale la frequenza scende.
+                                  Senza ascolto del canale prima di trasmettere
+                                  le collisioni cominciano presto: il massimo
+                                  teorico (ALOHA) è circa il 18% (46).
+    */
+    void attivaControlloCongestione(uint16_t intervalloMinimo = 50, uint16_t intervalloMassimo = 10000,
+                                    uint8_t caricoObiettivo = 32);
+
+    //! Disattiva il controllo della congestione (gli invii non sono più limitati)
+    void disattivaControlloCongestione();
+
+    //! Indica se un invio con ACK è permesso dal controllo della congestione
+    /*! @return `true` se il controllo non è attivo o se l'attesa è finita
+    */
+    bool invioConsentito();
+
+    //! Restituisce l'intervallo medio attuale tra due invii in ms (0 se il controllo non è attivo)
+    uint32_t intervalloInvio();
+
+    //! Riporta il carico del canale negli ACK inviati (da attivare sul gateway)
+    /*! Il carico è la frazione del tempo in cui il canale è occupato da
+        messaggi ricevuti correttamente e dai loro ACK, misurata a finestre di
+        un secondo. Non comprende le collisioni, che non si possono ricevere.
+        Gli ACK diventano lunghi un byte in più.
+    */
+    void attivaSegnalazioneCarico();
+
+    //! Torna agli ACK normali
+    void disattivaSegnalazioneCarico();
+
+    //! Restituisce il carico del canale in 255-esimi del tempo
+    /*! @return con la segnalazione attiva il carico misurato, altrimenti
+        l'ultimo carico riportato in un ACK
+    */
+    uint8_t caricoCanale();
+
+
+    //!@}
+    /*! @name Sincronizzazione del tempo
+    Un orologio comune a tutte le radio, con una precisione di alcune decine di
+    microsecondi, basato sui tempi di invio e ricezione misurati nell'ISR (cfr.
+    `tempoRicezioneUs()`)
+    */
+    //!@{
+
+    //! Stato della sincronizzazione: tabella dei beacon e stime (contenuto
+    //! privato, circa 110 bytes)
+    class StatoSincronizzazione;
+
+    //! Attiva la sincronizzazione del tempo
+    /*! Una sola radio (la radice) fornisce il tempo di riferimento: il suo
+        orologio globale coincide con `micros()`. La radice invia
+        periodicamente dei beacon (messaggi di servizio senza ACK), ognuno dei
+        quali contiene l'"ora" esatta di invio del beacon precedente. Le altre
+        radio confrontano questa "ora" con quella in cui avevano ricevuto il
+        beacon precedente e stimano con una regressione lineare sugli ultimi
+        `nrPuntiSincronizzazione` beacon lo scarto e la deriva del proprio
+        orologio rispetto a quello della radice.
+
+        @param radice              `true` sulla radio che fornisce il tempo
+        @param stato               stato della sincronizzazione. Deve esistere
+            finché la sincronizzazione è attiva.
+        @param intervalloBeacon    (solo radice) intervallo tra due beacon in ms;
+            0 per inviarli solo con `inviaBeaconSincronizzazione()`
+    */
+    void attivaSincronizzazione(bool radice, StatoSincronizzazione& stato,
+                                uint16_t intervalloBeacon = 10000);
+
+    //! Disattiva la sincronizzazione del tempo (le stime sono cancellate)
+    void disattivaSincronizzazione();
+
+    //! Invia subito un beacon di sincronizzazione (solo sulla radice)
+    /*! La funzione aspetta la fine della trasmissione per registrarne l'"ora",
+        che sarà inviata con il beacon successivo.
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int inviaBeaconSincronizzazione();
+
+    //! Restituisce `true` se l'orologio globale è disponibile
+    /*! Sulla radice sempre, sulle altre radio dopo aver ricevuto almeno tre
+        beacon consecutivi.
+    */
+    bool sincronizzato();
+
+    //! Restituisce l'"ora" dell'orologio globale in microsecondi
+    /*! Se la radio non è sincronizzata restituisce `micros()`.
+    */
+    uint32_t tempoGlobaleUs();
+
+    //! Converte un'"ora" locale (`micros()`) nell'"ora" globale corrispondente
+    uint32_t localeInGlobale(uint32_t localeUs);
+
+    //! Converte un'"ora" globale nell'"ora" locale (`micros()`) corrispondente
+    /*! Serve ad es. per sapere quando svegliarsi per un appuntamento fissato
+        nel tempo globale.
+    */
+    uint32_t globaleInLocale(uint32_t globaleUs);
+
+    //! Restituisce la deriva stimata dell'orologio locale rispetto a quello globale
+    /*! @return la deriva in parti per milione (positiva se l'orologio locale
+                è più lento di quello della radice)
+    */
+    float derivaPpm();
+
+    //! Numero di beacon usati nella stima di scarto e deriva
+    static constexpr uint8_t nrPuntiSincronizzazione = 8;
+
+
+    //!@}
+    /*! @name TDMA
+    Accesso al canale a divisione di tempo per reti a stella: un coordinatore
+    (il gateway) divide il tempo in superframe composti da uno slot per il suo
+    beacon e uno per ogni nodo, e ogni nodo trasmette solo nel proprio slot.
+    Così i messaggi dei nodi non collidono mai e la capacità del canale è nota
+    in anticipo.
+    */
+    //!@{
+
+    //! Memoria statica per la coda dei messaggi da inviare di un nodo TDMA
+    /*! @tparam lunghezzaMaxMessaggio  lunghezza massima dei messaggi in coda
+        @tparam nrMessaggi             numero di messaggi che la coda può contenere
+    */
+    template<uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggi>
+    class MemoriaInvio;
+
+    //! Attiva il TDMA su un nodo
+    /*! Da questo momento `invia()`, `inviaConAck()` e `inviaFinoAck()` non
+        trasmettono subito: mettono il messaggio in coda e restituiscono
+        `Errore::inviaCodaPiena` se non c'è posto. La coda è svuotata da
+        `controlla()` nello slot del nodo, un messaggio per superframe (finché
+        un messaggio con richiesta di ACK non riceve l'ACK è inviato di nuovo
+        nei superframe successivi, al massimo `maxTentativiTDMA` volte).
+
+        Il nodo conosce il suo slot dal beacon del coordinatore, che elenca
+        l'identificativo del nodo di ogni slot. Se non riceve beacon per
+        `maxSuperframeSenzaBeacon` superframe smette di trasmettere.
+
+        @note La radio deve essere in ricezione per sentire i beacon, e
+        `controlla()` deve essere chiamata spesso: un messaggio può partire
+        solo nei primi `guardia` us dello slot (di più se è più corto della
+        lunghezza massima).
+
+        @param idNodo   identificativo del nodo (1 - 255), come elencato dal coordinatore
+        @param memoria  memoria per la coda (cfr. `MemoriaInvio`)
+    */
+    template<uint8_t lung, uint8_t nr>
+    void attivaTDMA(uint8_t idNodo, MemoriaInvio<lung, nr>& memoria) {
+        attivaTDMA(idNodo, memoria.dati, memoria.lunghezze, memoria.intestazioni, lung, nr);
+    }
+
+    //! Attiva il TDMA sul coordinatore
+    /*! Il coordinatore invia un beacon all'inizio di ogni superframe da
+        `controlla()`. La durata degli slot è calcolata in modo che ci stia un
+        messaggio lungo `lunghezzaMaxMessaggio` con il suo ACK, più un tempo di
+        guardia all'inizio e alla fine che assorbe l'errore di sincronizzazione
+        (timestamp degli interrupt e deriva degli oscillatori).
+
+        @param nodi                  identificativi dei nodi, nell'ordine dei
+            loro slot. L'array deve esistere finché il TDMA è attivo.
+        @param nrNodi                numero di nodi (cioè di slot oltre a quello
+            del beacon)
+        @param lunghezzaMaxMessaggio lunghezza massima dei messaggi dei nodi
+        @param tempoRispostaAckUs    tempo massimo tra la fine di un messaggio e
+            l'inizio della trasmissione dell'ACK, che dipende dalla frequenza con
+            cui il coordinatore chiama `controlla()`
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int attivaTDMACoordinatore(const uint8_t nodi[], uint8_t nrNodi,
+                               uint8_t lunghezzaMaxMessaggio, uint16_t tempoRispostaAckUs = 2000);
+
+    //! Disattiva il TDMA (i messaggi in coda sono scartati)
+    void disattivaTDMA();
+
+    //! Restituisce `true` se il nodo conosce il suo slot e può trasmettere
+    bool sincronizzatoTDMA();
+
+    //! Restituisce il numero di messaggi in attesa del proprio slot
+    uint8_t nrMessaggiDaInviare() {return codaInvio.nrMessaggi();}
+
+    //! Restituisce il numero di messaggi scartati dopo `maxTentativiTDMA` invii senza ACK
+    uint16_t nrMessaggiPersiTDMA() {return messaggiPersiTDMA;}
+
+    //! Restituisce la durata di uno slot in us (0 se non è nota)
+    uint32_t durataSlotTDMA() {return durataSlotUs;}
+
+    //! Numero massimo di invii di un messaggio con richiesta di ACK
+    static constexpr uint8_t maxTentativiTDMA = 3;
+    //! Numero di superframe senza beacon dopo i quali un nodo smette di trasmettere
+    static constexpr uint8_t maxSuperframeSenzaBeacon = 3;
+
+
+    //!@}
+    /*! @name Salto di frequenza
+    Nel salto di frequenza (FHSS) tutte le radio della rete cambiano canale
+    insieme seguendo la stessa sequenza pseudocasuale, così il traffico è
+    distribuito su molti canali e un disturbo a banda stretta ne rovina solo
+    uno. Il cambio di canale è scandito dal superframe se il TDMA è attivo,
+    altrimenti dall'orologio globale (cfr. `attivaSincronizzazione()`).
+    */
+    //!@{
+
+    //! Memoria statica per la tabella dei canali
+    /*! @tparam nrCanali numero di canali (2 - 64)
+    */
+    template<uint8_t nrCanali>
+    class MemoriaFHSS;
+
+    //! Attiva il salto di frequenza
+    /*! I valori dei registri di frequenza di tutti i canali sono calcolati una
+        volta sola qui, così un salto è una sola scrittura di tre registri. La
+        sequenza dei canali è una permutazione ricavata da `seme`: deve essere
+        uguale su tutte le radio della rete, come gli altri parametri.
+
+        Il canale cambia ogni `durataCanaleMs` ms di tempo globale o, se il TDMA
+        è attivo, a ogni superframe (il beacon del coordinatore contiene la
+        posizione nella sequenza e `durataCanaleMs` non è usato). Una radio che
+        non conosce l'orologio (nodo non sincronizzato o che ha perso i beacon
+        TDMA) resta sul primo canale della sequenza, dove la radice invia i
+        beacon di sincronizzazione e il coordinatore un beacon TDMA a ogni
+        giro della sequenza.
+
+        @note Il salto avviene in `controlla()`, solo quando la radio è libera:
+        un messaggio e il suo ACK sono sempre sullo stesso canale. I messaggi
+        devono essere molto più corti di un canale.
+
+        @param memoria          memoria per la tabella (cfr. `MemoriaFHSS`)
+        @param frequenzaBase    frequenza del canale 0 in Hz
+        @param spaziatura       distanza tra due canali in Hz (almeno la banda
+                                del channel filter)
+        @param durataCanaleMs   tempo passato su ogni canale (senza TDMA)
+        @param seme             seme della sequenza dei canali
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    template<uint8_t nr>
+    int attivaFHSS(MemoriaFHSS<nr>& memoria, uint32_t frequenzaBase, uint32_t spaziatura,
+                   uint16_t durataCanaleMs, uint8_t seme = 1) {
+        return attivaFHSS(memoria.frf, memoria.sequenza, nr, frequenzaBase, spaziatura, durataCanaleMs, seme);
+    }
+
+    //! Disattiva il salto di frequenza
+    /*! Se la radio è libera torna subito al primo canale della sequenza,
+        altrimenti resta sul canale attuale.
+    */
+    void disattivaFHSS();
+
+    //! Restituisce il canale attuale (indice nella tabella, non nella
+    //! sequenza; 0xFF prima del primo salto)
+    uint8_t canaleFHSS() {return canaleAttualeFHSS;}
+
+    //! Restituisce il numero di salti eseguiti dall'attivazione
+    uint32_t nrSaltiFHSS() {return saltiFHSS;}
+
+
+    //!@}
+    /*! @name Analisi dello spettro
+    Misura del rumore su una serie di canali equidistanti, per scegliere il
+    canale (o la frequenza base del salto di frequenza) meno disturbato. Per
+    ogni misura la radio scrive i registri di frequenza del canale, entra in
+    ricezione e legge l'RSSI: nessun messaggio può essere ricevuto nel
+    frattempo, ma ogni misura dura meno di un millisecondo.
+    */
+    //!@{
+
+    //! Rumore misurato su un canale
+    struct CanaleSpettro {
+        //! RSSI minimo misurato in dBm
+        int8_t minimo;
+        //! RSSI massimo misurato in dBm
+        int8_t massimo;
+        //! Somma degli RSSI misurati (per la media)
+        int32_t somma;
+        //! Numero di misure
+        uint16_t nrMisure;
+        //! RSSI medio in dBm
+        int8_t media() const {return nrMisure ? somma / nrMisure : 0;}
+    };
+
+    //! Misura il rumore su tutti i canali
+    /*! La funzione è bloccante: dura circa `nrCanali * nrPassate` ms. Le
+        misure precedenti nella tabella sono cancellate.
+
+        @param canali           tabella dei risultati, un elemento per canale
+        @param nrCanali         numero di canali
+        @param frequenzaBase    frequenza del canale 0 in Hz
+        @param spaziatura       distanza tra due canali in Hz
+        @param nrPassate        numero di misure per canale
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int analizzaSpettro(CanaleSpettro canali[], uint8_t nrCanali, uint32_t frequenzaBase,
+                        uint32_t spaziatura, uint8_t nrPassate = 4);
+
+    //! Misura il rumore in sottofondo
+    /*! Da questo momento `controlla()` misura un canale ogni `intervalloMs`
+        ms, quando la radio è libera, passando ciclicamente da un canale al
+        successivo. La tabella è aggiornata continuamente e deve esistere
+        finché l'analisi non è fermata.
+
+        @param canali           tabella dei risultati (cancellata all'avvio)
+        @param nrCanali         numero di canali
+        @param frequenzaBase    frequenza del canale 0 in Hz
+        @param spaziatura       distanza tra due canali in Hz
+        @param intervalloMs     tempo tra due misure
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int avviaAnalisiSpettro(CanaleSpettro canali[], uint8_t nrCanali, uint32_t frequenzaBase,
+                            uint32_t spaziatura, uint16_t intervalloMs);
+
+    //! Ferma l'analisi in sottofondo (la tabella mantiene le misure)
+    void fermaAnalisiSpettro() {nrCanaliSpettro = 0;}
+
+    //! Restituisce il canale con l'RSSI medio più basso
+    /*! A parità di media è scelto quello con il massimo più basso, cioè con
+        meno disturbi occasionali. I canali senza misure sono ignorati.
+        @return l'indice del canale, 0xFF se nessun canale è stato misurato
+    */
+    static uint8_t canaleMenoDisturbato(const CanaleSpettro canali[], uint8_t nrCanali);
+
+
+    //!@}
+    /*! @name Correzione della frequenza
+    I quarzi di due radio differiscono di qualche decina di ppm, cioè di
+    decine di kHz a 434 MHz: senza correzione il channel filter (`RX_BW`)
+    deve essere abbastanza largo da contenere il segnale anche spostato di
+    tanto, e un filtro più largo fa entrare più rumore. Con la correzione la
+    radio misura l'errore di frequenza (AFC) di ogni messaggio ricevuto,
+    tiene una stima per ogni corrispondente e sposta la propria frequenza
+    prima di comunicare con esso, in ricezione e in trasmissione. Il filtro
+    deve allora contenere solo l'errore residuo (cfr.
+    `guadagnoCorrezioneFrequenzaDb()`), ma durante l'avvio, finché le stime
+    non sono pronte, è necessario un filtro più largo (ad es. un profilo
+    radio).
+    */
+    //!@{
+
+    //! Attiva la misura e la correzione della frequenza
+    /*! Attiva l'AFC automatico della radio (eseguito all'inizio di ogni
+        ricezione) e legge il suo risultato alla fine di ogni messaggio.
+
+        Il corrispondente a cui è attribuito un messaggio ricevuto, e la cui
+        correzione è applicata, è quello scelto con `selezionaCorrispondente()`
+        (il primo se non è stato scelto); sul coordinatore TDMA è il nodo dello
+        slot attuale (nell'ordine dell'array passato a
+        `attivaTDMACoordinatore()`), e nello slot del beacon nessuno.
+
+        Se entrambe le radio di una coppia correggono la frequenza si
+        incontrano a metà strada; se una radio comunica con molte altre (ad es.
+        un gateway) può invece fare da riferimento, cioè misurare senza mai
+        spostarsi, così tutte le altre si allineano alla sua frequenza e
+        ricevono anche i suoi messaggi a tutti (beacon).
+
+        @param correzioni       tabella delle stime, un elemento per corrispondente
+        @param nrCorrispondenti numero di elementi della tabella
+        @param riferimento      se `true` la radio misura ma non corregge
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int attivaCorrezioneFrequenza(int16_t correzioni[], uint8_t nrCorrispondenti, bool riferimento = false);
+
+    //! Disattiva la correzione e torna alla frequenza nominale (se la radio è libera)
+    void disattivaCorrezioneFrequenza();
+
+    //! Sceglie il corrispondente dei prossimi messaggi
+    /*! Se la radio è libera la frequenza è corretta subito, altrimenti alla
+        prossima chiamata a `controlla()` in cui lo è.
+        @param corrispondente   indice nella tabella delle stime
+    */
+    void selezionaCorrispondente(uint8_t corrispondente);
+
+    //! Restituisce l'errore di frequenza stimato di un corrispondente in Hz
+    /*! @return la differenza tra la frequenza del corrispondente e quella
+                nominale di questa radio (0 se la correzione non è attiva)
+    */
+    int32_t erroreFrequenzaHz(uint8_t corrispondente);
+
+    //! Restituisce l'errore di frequenza dell'ultimo messaggio ricevuto in Hz
+    int32_t erroreFrequenzaUltimoMessaggioHz() {return hzDaFstep(ultimoErroreFrequenza);}
+
+    //! Stima il guadagno di sensibilità permesso dalla correzione
+    /*! Confronta il channel filter più stretto che contiene il segnale con
+        l'errore dei quarzi `tolleranzaPpm` con quello che basta con l'errore
+        residuo `residuoPpm` dopo la correzione (quantizzazione, errore della
+        misura e deriva tra due messaggi). Il rumore in ingresso, e quindi la
+        sensibilità, è proporzionale alla banda del filtro.
+
+        @param bitRate, freqDev, frequenza  parametri della modulazione
+        @param tolleranzaPpm    errore dei quarzi senza correzione
+        @param residuoPpm       errore rimasto dopo la correzione
+        @return il guadagno in dB (0 se i filtri sono uguali, negativo se
+                nessun filtro basta senza correzione)
+    */
+    static float guadagnoCorrezioneFrequenzaDb(uint32_t bitRate, uint32_t freqDev, uint32_t frequenza,
+                                               uint8_t tolleranzaPpm, uint8_t residuoPpm = 2);
+
+
+    //!@}
+    /*! @name Temperatura
+    La radio contiene un sensore di temperatura, utilizzabile solo in standby
+    (o FS), con una risoluzione di 1 °C e un errore assoluto che va corretto
+    con una calibrazione. La frequenza del quarzo cambia con la temperatura
+    (di solito secondo una parabola con il vertice a circa 25 °C): la
+    compensazione sposta la frequenza della radio in base a una tabella
+    dell'errore del quarzo.
+    */
+    //!@{
+
+    //! Avvia una misura della temperatura
+    /*! La radio passa in standby e ci resta fino alla lettura con
+        `temperatura()`. La misura dura circa 100 us.
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int avviaMisuraTemperatura();
+
+    //! Restituisce `true` se la misura avviata con `avviaMisuraTemperatura()` è conclusa
+    bool temperaturaPronta();
+
+    //! Legge il risultato della misura e riporta la radio nella modalità default
+    /*! @return la temperatura in °C (corretta con `calibraTemperatura()`)
+    */
+    int8_t temperatura();
+
+    //! Calibra il sensore con la temperatura reale dell'ultima misura
+    void calibraTemperatura(int8_t gradiReali);
+
+    //! Un punto della tabella dell'errore del quarzo
+    struct PuntoTemperatura {
+        //! temperatura in °C
+        int8_t gradi;
+        //! errore di frequenza del quarzo in decimi di ppm (positivo se il
+        //! quarzo è troppo veloce)
+        int16_t erroreDecimiPpm;
+    };
+
+    //! Attiva la compensazione della deriva del quarzo con la temperatura
+    /*! Ogni `intervalloS` secondi `controlla()`, quando la radio è libera,
+        misura la temperatura (circa 100 us in standby), calcola l'errore del
+        quarzo interpolando la tabella e corregge la frequenza. Fuori dalla
+        tabella è usato il punto più vicino.
+
+        @param tabella      punti ordinati per temperatura crescente. L'array
+                            deve esistere finché la compensazione è attiva.
+        @param nrPunti      numero di punti
+        @param intervalloS  tempo tra due misure
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int attivaCompensazioneTemperatura(const PuntoTemperatura tabella[], uint8_t nrPunti,
+                                       uint16_t intervalloS = 60);
+
+    //! Disattiva la compensazione e torna alla frequenza non compensata (se la radio è libera)
+    void disattivaCompensazioneTemperatura();
+
+    //! Restituisce la correzione di frequenza applicata per la temperatura in Hz
+    int32_t correzioneTemperaturaHz() {return hzDaFstep(correzioneTemperatura);}
+
+
+    //!@}
+    /*! @name Cattura del segnale
+    Nella modalità continua la radio non cerca pacchetti: demodula tutto
+    quello che riceve e lo presenta bit per bit su DIO2, con il clock del bit
+    synchronizer (DCLK) su DIO1. Collegando i due pin al microcontrollore è
+    possibile registrare il segnale presente sul canale, ad es. per
+    riconoscere disturbi o trasmettitori estranei senza altri strumenti.
+
+    I bit sono raccolti da un interrupt sul fronte di salita di DCLK, quindi
+    la bit rate massima dipende dal microcontrollore: `bitRateMassimaCattura`,
+    cioè 50 kbps su un AVR a 16 MHz.
+    */
+    //!@{
+
+    //! Avvia la cattura del segnale
+    /*! La radio passa in ricezione continua e non riceve né invia messaggi
+        fino a `fermaCattura()`. I bytes catturati (il primo bit ricevuto è il
+        più significativo) entrano in una coda circolare da cui vanno tolti
+        con `leggiCattura()` o `esportaCattura()` abbastanza spesso: se la coda
+        è piena i nuovi bytes sono persi (cfr. `byteCatturaPersi()`).
+
+        La bit rate attuale non deve superare `bitRateMassimaCattura`: oltre,
+        l'interrupt perderebbe dei fronti di DCLK senza poterlo rilevare.
+
+        @param memoria      memoria per la coda circolare
+        @param dimensione   dimensione della memoria in bytes (almeno 2)
+        @param pinDclk      pin collegato a DIO1 (deve poter generare interrupt)
+        @param pinDati      pin collegato a DIO2
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int avviaCattura(uint8_t memoria[], uint16_t dimensione, uint8_t pinDclk, uint8_t pinDati);
+
+    //! Ferma la cattura e torna alla modalità a pacchetti
+    void fermaCattura();
+
+    //! Restituisce `true` se la cattura è in corso
+    bool catturaAttiva() {return stato == Stato::cattura;}
+
+    //! Restituisce il numero di bytes catturati in attesa di essere letti
+    uint16_t byteCatturati();
+
+    //! Restituisce il numero di bytes persi perché la coda era piena
+    /*! È riportato anche da `stampaStatoSerial()` durante la cattura.
+    */
+    uint32_t byteCatturaPersi();
+
+    //! Bit rate massima a cui l'interrupt di DCLK riesce a leggere ogni bit
+    /*! Circa 320 cicli di clock per bit: l'ISR con `attachInterrupt()` ne
+        richiede più di 100, e il resto serve al programma per svuotare la coda.
+    */
+    static constexpr uint32_t bitRateMassimaCattura = F_CPU / 320;
+
+    //! Toglie dalla coda i bytes catturati
+    /*! @param destinazione array in cui copiare i bytes
+        @param max          dimensione dell'array
+        @return il numero di bytes copiati
+    */
+    uint16_t leggiCattura(uint8_t destinazione[], uint16_t max);
+
+    //! Scrive l'intestazione di un file di cattura
+    /*! Il file è composto da un'intestazione di 16 bytes seguita dai bytes
+        catturati, così come li scrive `esportaCattura()`:
+        `"RFBS"`, versione (1), ordine dei bit (0: il primo è il più
+        significativo), 2 bytes a 0, bit rate in bps e frequenza in Hz (4
+        bytes little endian ciascuna).
+    */
+    void scriviIntestazioneCattura(HardwareSerial& uscita);
+
+    //! Scrive sulla porta seriale tutti i bytes catturati in attesa
+    /*! @return il numero di bytes scritti
+    */
+    uint16_t esportaCattura(HardwareSerial& uscita);
+
+
+    //!@}
+    /*! @name Sniffer
+    In modalità sniffer la radio riceve tutti i pacchetti sul suo canale,
+    anche quelli con il CRC errato, e li scrive su una porta seriale nel
+    formato pcap, leggibile ad es. da Wireshark (cfr.
+    Strumenti/sniffer_pcap.py per salvare il flusso in un file). Nessun
+    messaggio è consegnato all'applicazione e nessun ACK è inviato.
+
+    Il flusso comincia con l'intestazione globale pcap (tipo di collegamento
+    `LINKTYPE_USER0` = 147); ogni record contiene un'intestazione di 12 bytes
+    seguita dal pacchetto così come è stato trasmesso, senza il byte di
+    lunghezza:
+
+        [0]     versione (1)
+        [1]     flag: bit 0 CRC corretto
+        [2]     RSSI in dBm (int8)
+        [3]     numero di byte di parità FEC alla fine del pacchetto
+        [4-7]   errore di frequenza (AFC) in Hz (int32 little endian)
+        [8-11]  frequenza in Hz (uint32 little endian)
+        [12]    intestazione (bit 0 ack, bit 1 richiesta ACK, bit 2-7 titolo)
+        [13-]   messaggio e byte di parità
+
+    Un pacchetto più lungo della coda dei messaggi è troncato (la lunghezza
+    originale è nel record pcap). Il tempo è quello globale se la radio è
+    sincronizzata (cfr. `attivaSincronizzazione()`), altrimenti `micros()`.
+    */
+    //!@{
+
+    //! Attiva la modalità sniffer
+    /*! Scrive subito l'intestazione pcap, poi un record per ogni pacchetto
+        ricevuto (nelle chiamate a `controlla()`). La porta seriale deve
+        essere abbastanza veloce per il traffico sul canale.
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int attivaSniffer(HardwareSerial& uscita);
+
+    //! Disattiva la modalità sniffer
+    void disattivaSniffer();
+
+    //! Restituisce il numero di pacchetti registrati dallo sniffer
+    uint32_t nrPacchettiSniffer() {return pacchettiSniffer;}
+
+    //! Restituisce il numero di pacchetti con CRC errato registrati dallo sniffer
+    uint32_t nrPacchettiErratiSniffer() {return pacchettiErratiSniffer;}
+
+
+    //!@}
+    /*! @name Instradamento (mesh)
+    Rete a più salti: un messaggio raggiunge una radio fuori portata passando
+    da quelle intermedie, che lo inoltrano una all'altra con un ACK per ogni
+    salto. Ogni radio ha un indirizzo (1 - 254) e due tabelle:
+    - i vicini, cioè le radio sentite direttamente, con la stima del
+      collegamento (RSSI medio, PRR ed ETX, cfr. `StimaCollegamento`);
+    - le rotte, cioè per ogni destinazione il vicino a cui passare i messaggi
+      e il costo del percorso.
+
+    Le rotte sono scoperte con un protocollo distance-vector: ogni radio
+    annuncia le sue rotte ai vicini ogni `intervalloAnnunci` ms (e poco dopo
+    ogni cambiamento), e un vicino adotta una rotta se passare da lei costa
+    meno. Il costo di un collegamento è il numero atteso di trasmissioni
+    (ETX) in quarti, più 1 per ogni dB di RSSI sotto
+    `rssiMinimoMesh`. Un annuncio contiene 3 bytes per rotta.
+
+    Un messaggio mesh ha `byteIntestazioneMesh` bytes di intestazione in più
+    (mittente e destinatario del salto, numero di sequenza, origine,
+    destinazione, salti e titolo), che devono entrare nella lunghezza massima
+    passata a `inizializza()`: tutte le radio della rete devono avere la
+    stessa. A destinazione è consegnato come un messaggio normale (coda o
+    funzione di gestione, con il suo titolo) il cui primo byte è l'indirizzo
+    della radio di origine, seguito dal messaggio.
+
+    I messaggi propri e quelli da inoltrare sono in due code separate, servite
+    a turno: il traffico inoltrato non può bloccare quello locale (e
+    viceversa). Se la coda di inoltro è piena un messaggio non riceve l'ACK e
+    il vicino lo ritrasmetterà.
+
+    @note L'invio avviene in `controlla()`, che durante l'attesa di un ACK
+    dura qualche millisecondo in più del solito. Il mesh non è compatibile con
+    il TDMA.
+    */
+    //!@{
+
+    //! Memoria statica per le tabelle, le code, gli annunci e lo stato del mesh
+    /*! @tparam nrNodi                  numero massimo di vicini e di rotte
+        @tparam lunghezzaMaxMessaggio   lunghezza massima dei messaggi dell'utente
+        @tparam nrMessaggi              capacità di ognuna delle due code
+    */
+    template<uint8_t nrNodi, uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggi>
+    class MemoriaMesh;
+
+    //! Attiva l'instradamento mesh
+    /*! Deve essere chiamata dopo `inizializza()`. La radio deve restare in
+        ricezione per sentire gli annunci dei vicini e i messaggi da inoltrare.
+        @param indirizzo         indirizzo della radio (1 - 254), unico nella rete
+        @param memoria           memoria per tabelle e code (cfr. `MemoriaMesh`)
+        @param intervalloAnnunci intervallo tra due annunci periodici delle rotte
+                                 in ms; vicini e rotte non confermati per tre
+                                 intervalli sono dimenticati
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    template<uint8_t nrNodi, uint8_t lung, uint8_t nr>
+    int attivaMesh(uint8_t indirizzo, MemoriaMesh<nrNodi, lung, nr>& memoria,
+                   uint16_t intervalloAnnunci = 10000) {
+        return attivaMesh(indirizzo, memoria.stato, memoria.vicini, memoria.rotte, nrNodi,
+                          memoria.datiLocali, memoria.lunghezzeLocali, memoria.intestazioniLocali,
+                          memoria.datiInoltro, memoria.lunghezzeInoltro, memoria.intestazioniInoltro,
+                          memoria.annuncio, lung, nr, intervalloAnnunci);
+    }
+
+    //! Disattiva il mesh (i messaggi in coda sono scartati)
+    void disattivaMesh();
+
+    //! Mette in coda un messaggio per una radio della rete mesh
+    /*! Il messaggio parte da `controlla()` verso il vicino indicato dalla
+        tabella delle rotte, fino a `maxTentativiMesh` volte se l'ACK non
+        arriva. L'ACK di ogni salto non conferma la consegna alla destinazione.
+        @param destinazione indirizzo della radio di destinazione
+        @param messaggio    messaggio da inviare
+        @param lunghezza    lunghezza del messaggio
+        @param titolo       titolo del messaggio (come per `invia()`)
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int inviaMesh(uint8_t destinazione, const uint8_t messaggio[], uint8_t lunghezza, uint8_t titolo = 0);
+
+    //! Cerca la rotta per una destinazione
+    /*! @param destinazione indirizzo della radio
+        @param prossimoSalto [out] vicino a cui sono inoltrati i messaggi
+        @param costo         [out] costo del percorso (cfr. sopra)
+        @return `true` se la destinazione è raggiungibile
+    */
+    bool rottaMesh(uint8_t destinazione, uint8_t& prossimoSalto, uint8_t& costo);
+
+    //! Stampa le tabelle dei vicini e delle rotte sul monitor seriale
+    void stampaTabelleMesh(HardwareSerial& serial);
+
+    //! Restituisce la stima del collegamento con un vicino (nullptr se
+    //! l'indirizzo non è nella tabella dei vicini)
+    const StimaCollegamento* stimaVicinoMesh(uint8_t indirizzo);
+
+    //! Restituisce il numero di messaggi arrivati a destinazione (questa radio)
+    uint16_t nrMessaggiRicevutiMesh() {return mesh ? mesh->messaggiRicevuti : 0;}
+    //! Restituisce il numero di messaggi inoltrati (con l'ACK del vicino)
+    uint16_t nrMessaggiInoltratiMesh() {return mesh ? mesh->messaggiInoltrati : 0;}
+    //! Restituisce il numero di messaggi scartati: senza rotta, troppi salti
+    //! o `maxTentativiMesh` invii senza ACK
+    uint16_t nrMessaggiPersiMesh() {return mesh ? mesh->messaggiPersi : 0;}
+    //! Restituisce la percentuale di invii (tentativi compresi) confermati
+    //! dal vicino
+    uint8_t consegnaSaltoMesh() {
+        return mesh && mesh->tentativiSalto ? 100UL * mesh->ackSalto / mesh->tentativiSalto : 0;}
+    //! Restituisce il tempo medio in us tra il primo tentativo di invio di un
+    //! messaggio al vicino e il suo ACK (ritrasmissioni comprese)
+    uint32_t latenzaMediaSaltoUs() {
+        return mesh && mesh->saltiMisurati ? mesh->sommaLatenzeSaltoUs / mesh->saltiMisurati : 0;}
+
+    //! Bytes aggiunti dal mesh a ogni messaggio (ogni salto trasmette anche un ACK)
+    static constexpr uint8_t byteIntestazioneMesh = 8;
+    //! Numero massimo di invii di un messaggio allo stesso vicino
+    static constexpr uint8_t maxTentativiMesh = 3;
+    //! Numero massimo di salti di un messaggio
+    static constexpr uint8_t maxSaltiMesh = 15;
+    //! RSSI sotto il quale il costo di un collegamento aumenta
+    static constexpr int8_t rssiMinimoMesh = -85;
+
+
+    //!@}
+    /*! @name Broadcast e multicast
+    Un messaggio inviato con `inviaConAck()` può avere un solo destinatario:
+    se lo ricevono più radio rispondono tutte insieme e gli ACK collidono.
+    Queste funzioni inviano invece un messaggio a tutte le radio (broadcast) o
+    alle radio di un gruppo (multicast, gruppi 0 - 7) con una sola
+    trasmissione e senza alcun ACK: ad es. una configurazione arriva a 50 nodi
+    con un messaggio invece che con 50 scambi messaggio-ACK.
+
+    Il broadcast non ha bisogno di nulla, né per inviare né per ricevere, e
+    non è affidabile. Il multicast va attivato con `attivaMulticast()`, che
+    riceve lo stato dei gruppi (numerazione, NACK, statistiche): una radio che
+    non lo usa non ne paga la memoria. È affidabile se il mittente ha anche una
+    memoria per i messaggi inviati (cfr. `MemoriaMulticast`): i messaggi di
+    un gruppo sono numerati e una radio che si accorge di un buco nella
+    numerazione lo segnala con un NACK. Il NACK parte dopo un ritardo casuale
+    (fino a `finestraNack` ms), ed è soppresso se nel frattempo la radio ne
+    sente uno di un'altra radio che chiede gli stessi messaggi: il mittente
+    ritrasmette i messaggi una volta per tutte. Dopo l'ultimo messaggio il
+    mittente ne annuncia due volte il numero, così anche la perdita
+    dell'ultimo è scoperta.
+
+    Un messaggio multicast o broadcast ha 4 bytes di intestazione in più ed è
+    consegnato come un messaggio normale (coda o funzione di gestione, con il
+    suo titolo). I messaggi possono arrivare fuori ordine (le ritrasmissioni
+    dopo i successivi), mai due volte. Un messaggio che non entra nella coda
+    di ricezione piena è considerato perso e richiesto di nuovo.
+
+    @note Ogni gruppo deve avere un solo mittente.
+    */
+    //!@{
+
+    //! Stato dei gruppi multicast (contenuto privato, circa 150 bytes)
+    class StatoMulticast;
+
+    //! Stato dei gruppi e memoria statica per i messaggi multicast inviati
+    //! (ritrasmissioni)
+    /*! @tparam lunghezzaMaxMessaggio   lunghezza massima dei messaggi
+        @tparam nrMessaggi              numero di messaggi conservati (1 - 32):
+                                        un messaggio più vecchio non può essere
+                                        ritrasmesso
+    */
+    template<uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggi>
+    class MemoriaMulticast;
+
+    //! Attiva il multicast (riceventi e mittenti senza ritrasmissioni)
+    /*! @param stato        stato dei gruppi. Deve esistere finché il multicast
+                            è attivo.
+        @param finestraNack come per `entraGruppo()`: deve essere uguale su tutte
+                            le radio del gruppo
+    */
+    void attivaMulticast(StatoMulticast& stato, uint16_t finestraNack = 100);
+
+    //! Attiva il multicast con le ritrasmissioni dei messaggi inviati (mittente)
+    /*! @param memoria      stato dei gruppi e memoria per i messaggi inviati
+                            (cfr. `MemoriaMulticast`)
+        @param finestraNack come sopra
+    */
+    template<uint8_t lung, uint8_t nr>
+    void attivaMulticast(MemoriaMulticast<lung, nr>& memoria, uint16_t finestraNack = 100) {
+        attivaMulticast(memoria.stato, finestraNack);
+        impostaMemoriaMulticast(memoria.dati, memoria.lunghezze, memoria.gruppi, memoria.sequenze,
+                                memoria.titoli, memoria.ultimaRitrasmissione, lung, nr);
+    }
+
+    //! Disattiva il multicast (i broadcast continuano a funzionare)
+    void disattivaMulticast();
+
+    //! Riceve i messaggi multicast di un gruppo (multicast attivo)
+    /*! @param gruppo       gruppo (0 - 7)
+        @param finestraNack ritardo massimo di un NACK in ms. Deve bastare a
+                            sentire il NACK di un'altra radio (qualche volta
+                            il tempo in aria di un messaggio di 7 bytes), ed è
+                            meglio allungarlo se le radio del gruppo sono molte
+    */
+    void entraGruppo(uint8_t gruppo, uint16_t finestraNack = 100);
+
+    //! Smette di ricevere i messaggi multicast di un gruppo
+    void esciGruppo(uint8_t gruppo);
+
+    //! Invia un messaggio a tutte le radio del gruppo (multicast attivo)
+    /*! Il messaggio è inviato subito, come con `invia()`.
+        @param gruppo    gruppo (0 - 7)
+        @param messaggio messaggio da inviare
+        @param lunghezza lunghezza del messaggio (al massimo la lunghezza
+                         massima dei messaggi meno 4)
+        @param titolo    titolo del messaggio (come per `invia()`)
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int inviaMulticast(uint8_t gruppo, const uint8_t messaggio[], uint8_t lunghezza, uint8_t titolo = 0);
+
+    //! Invia un messaggio a tutte le radio, senza ACK né ritrasmissioni
+    /*! @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int inviaBroadcast(const uint8_t messaggio[], uint8_t lunghezza, uint8_t titolo = 0);
+
+    //! Restituisce il numero di NACK inviati
+    uint16_t nrNackInviati();
+    //! Restituisce il numero di NACK non inviati perché un'altra radio
+    //! aveva già chiesto gli stessi messaggi
+    uint16_t nrNackSoppressi();
+    //! Restituisce il numero di messaggi multicast ritrasmessi (mittente)
+    uint16_t nrRitrasmissioniMulticast();
+    //! Restituisce il numero di messaggi multicast persi dopo
+    //! `maxTentativiNack` NACK (o troppo vecchi per essere richiesti)
+    uint16_t nrMessaggiPersiMulticast();
+
+    //! Numero di gruppi multicast
+    static constexpr uint8_t nrGruppiMulticast = 8;
+    //! Numero massimo di NACK per gli stessi messaggi
+    static constexpr uint8_t maxTentativiNack = 4;
+
+
+    //!@}
+    /*! @name Ascolto a basso consumo
+    Nella modalità `listen` (cfr. `modalitaListen()`) la radio alterna da sola
+    brevi finestre di ricezione a lunghe pause, e resta raggiungibile
+    consumando una piccola frazione della corrente di ricezione. Per
+    svegliarla il mittente invia una raffica di brevi messaggi di risveglio
+    lunga almeno una pausa (`risveglia()`), poi i messaggi veri. Una radio
+    svegliata resta in ricezione finché non passano `finestraRisveglio` ms
+    senza messaggi, poi torna in `listen`.
+    */
+    //!@{
+
+    //! Imposta la durata delle finestre di ricezione e delle pause di `listen`
+    /*! Le durate sono arrotondate alla risoluzione della radio (64 us, 4.1 ms o
+        262 ms, con coefficienti da 1 a 255). Il mittente di una raffica di
+        risveglio deve avere le stesse impostazioni dei destinatari.
+
+        La finestra di ricezione deve coprire l'intervallo tra due messaggi di
+        risveglio consecutivi (almeno `durataMinimaRxListenUs`). Ad esempio con
+        1 s di pausa e 2 ms di ricezione la radio riceve per lo 0.2% del tempo,
+        e un messaggio la raggiunge al più tardi dopo circa un secondo.
+
+        @param durataIdleUs durata delle pause in us
+        @param durataRxUs   durata delle finestre di ricezione in us
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int impostaListen(uint32_t durataIdleUs, uint32_t durataRxUs);
+
+    //! Imposta per quanti ms senza messaggi una radio svegliata resta in ricezione
+    void impostaFinestraRisveglio(uint16_t ms) {finestraRisveglio = ms;}
+
+    //! Sveglia le radio in modalità `listen` nel raggio di trasmissione
+    /*! Invia messaggi di risveglio uno dopo l'altro per la durata di una pausa
+        e di una finestra di ricezione, e ritorna quando le altre radio sono in
+        ricezione. Blocca il programma per tutta la raffica.
+        Se anche questa radio è in `listen` resta in ricezione per la finestra
+        di risveglio, in modo da sentire le risposte.
+        @return Codice di errore definito nell'enum RFM69::Errore::ListaErrori
+    */
+    int risveglia();
+
+    //! Restituisce `true` se la radio è stata svegliata e non è ancora tornata in `listen`
+    bool svegliata() {return risveglioAttivo;}
+
+    //! Restituisce la frazione del tempo in ricezione in `listen`, in decimillesimi
+    uint16_t cicloAttivitaListen();
+
+    //! Restituisce l'energia di ricezione spesa per ogni messaggio ricevuto
+    /*! Stima basata sulla corrente assorbita in ricezione (16 mA) e nelle pause
+        di `listen` (1.2 uA) (datasheet di RFM69HCW, alimentazione a 3.3V) e sul
+        tempo passato in `rx` e in `listen` dall'inizializzazione.
+        @return energia in microjoule per messaggio ricevuto
+    */
+    uint32_t energiaPerMessaggioRicevuto();
+
+    //! Durata minima di una finestra di ricezione di `listen`
+    static constexpr uint16_t durataMinimaRxListenUs = 1000;
+
+
     //!@}
     /*! @name Funzioni ausiliarie
     Utili ma non indispensabili
@@ -468,7 +1813,8 @@ public:
     //! Mette la radio in modalità `listen`
     /*! `listen` è una modalità particolare che consiste in realtà nella continua
         alternanza tra due modalità: `rx` (ricezione) e `idle` (una specie di
-        sleep adattato alla modalità listen).
+        sleep adattato alla modalità listen). Le durate si impostano con
+        `impostaListen()`.
         @note vedi nota per @ref `ricevi()`
         @param aspetta Blocca il programma fino a che la radioella modalità
             desiderata. Pue utile se per qualche ragione la funz eccezionaleione
@@ -484,6 +1830,26 @@ public:
     */
     void sleep(bool aspetta = false);
 
+    //! Prepara la radio a una trasmissione imminente
+    /*! Mette la radio in modalità FS (frequency synthesizer): il sintetizzatore
+        si aggancia alla frequenza ora e la prossima trasmissione può iniziare
+        prima, senza passare dallo standby. Utile se si sa che un messaggio
+        sarà inviato a breve (ad es. mentre si prepara il suo contenuto).
+
+        Non fa nulla se la radio è occupata o in modalità ricezione. La radio
+        resta in FS (circa 9 mA) fino al prossimo invio o cambio di modalità.
+    */
+    void preparaTrasmissione();
+
+    //! Usa la modalità FS invece dello standby tra una trasmissione e l'altra
+    /*! Se la modalità default è `standby()` la radio attende in FS, pronta a
+        trasmettere, invece che in standby. Consuma più corrente (circa 9 mA
+        invece di 1.25 mA) ma riduce il ritardo tra `invia()` e l'inizio della
+        trasmissione.
+        @param attiva `true` per attendere in FS, `false` per tornare allo standby
+    */
+    void impostaPreriscaldamentoFS(bool attiva);
+
     //! Imposta il tempo d'attesa massimo per un ACK
     /*! @param tempoMs Tempo di attesa in millisecondi per la funzione `ackInSospeso()`.
                Dopo aver atteso per questo tempo la funzione terminerà senza
@@ -504,6 +1870,21 @@ public:
                 attivata l'`isr()` che segna la finem della ricezione del messaggio.
     */
     uint32_t tempoRicezione();
+    //! Restituisce l'"ora" della ricezione dell'ultimo messaggio in microsecondi
+    /*! Il tempo (`micros()`) è letto all'inizio dell'`isr()` e corretto per
+        riferirsi alla fine della sync word: ne sono sottratte la durata del
+        resto del pacchetto e la latenza stimata dell'interrupt. Si riferisce
+        quindi allo stesso istante di `tempoUltimoInvioUs()` sulla radio che ha
+        inviato il messaggio.
+        @return Il tempo in microsecondi dall'inizio del programma (come
+                `micros()`, torna a zero dopo circa 70 minuti)
+    */
+    uint32_t tempoRicezioneUs();
+    //! Restituisce l'"ora" dell'ultimo pacchetto inviato in microsecondi
+    /*! Vale per i messaggi e per gli ACK; come per `tempoRicezioneUs()` si
+        riferisce alla fine della sync word.
+    */
+    uint32_t tempoUltimoInvioUs() {return tempoInvioUs;}
 
     //! Imposta la potenza di trasmissione
     /*! Imposta la potenza di trasmissione della radio. Sono validi i valori interi
@@ -514,6 +1895,9 @@ public:
         @note Alla potenza massima, +20dBm, il segnale può in realtà rivelarsi
               meno forte o più disturbato che con una potenza di +19.
 
+        @note Con il controllo automatico della potenza questo valore diventa
+              la potenza massima (cfr. `attivaControlloPotenza()`).
+
         @param Valore di potenza assoluta di trasmissione desiderato in dBm [-2; +20]
 
         @param Codice di errore definito nell'enum RFM69::Errore::ListaErrori
@@ -580,6 +1964,12 @@ public:
     */
     uint16_t ottieniAttesaMediaAck() {return (sommaAtteseAck/nrAckRicevuti);}
 
+    //! Restituisce la durata dell'ultima attesa di un ACK in microsecondi
+    /*! Come `ottieniAttesaAck()`, ma misurata dalla fine della sync word del
+        messaggio a quella dell'ACK (cfr. `tempoRicezioneUs()`).
+    */
+    uint32_t ottieniAttesaAckUs() {return durataUltimaAttesaAckUs;}
+
     //! Restituisce il numero di messaggi inviati dopo l'ultima inizializzazione
     /*! @return Il numero di messaggi inviati dopo l'ultima inizializzazione
     */
@@ -588,6 +1978,29 @@ public:
     /*! @return Il numero di messaggi ricevuti dopo l'ultima inizializzazione
     */
     uint16_t nrMessaggiRicevuti() {return messaggiRicevuti;}
+    //! Restituisce il numero di messaggi riparati dalla FEC
+    /*! Conta i messaggi arrivati con degli errori (CRC errato) che la Forward
+        Error Correction ha potuto correggere. Senza FEC questi messaggi sarebbero
+        stati scartati e, se richiedevano un ACK, ritrasmessi.
+        @return Il numero di messaggi corretti dopo l'ultima inizializzazione
+    */
+    uint16_t nrMessaggiCorretti() {return messaggiCorretti;}
+    //! Restituisce il numero di messaggi che la FEC non ha potuto riparare
+    /*! @return Il numero di messaggi scartati perché contenevano più errori di
+                quanti la FEC ne possa correggere (FEC_BYTE_PARITA/2 bytes)
+    */
+    uint16_t nrMessaggiIrrecuperabili() {return messaggiIrrecuperabili;}
+    //! Restituisce il numero di messaggi scartati perché la coda era piena
+    /*! @return Il numero di messaggi arrivati mentre la coda di ricezione era
+                piena dopo l'ultima inizializzazione (per questi messaggi l'ACK
+                non è stato inviato)
+    */
+    uint16_t nrMessaggiScartatiCodaPiena() {return messaggiScartatiCodaPiena;}
+    //! Restituisce il numero di messaggi scartati dal filtro dei titoli
+    /*! cfr. `impostaFiltroTitoli()`
+        @return Il numero di messaggi filtrati dopo l'ultima inizializzazione
+    */
+    uint16_t nrMessaggiFiltrati() {return messaggiFiltrati;}
 
 
     //! Stampa la descrizione di un errore sul monitor seriale
@@ -651,6 +2064,41 @@ public:
     */
    void stampaStatoSerial(HardwareSerial& Serial);
 
+    //! Restituisce il numero di trasmissioni con una certa latenza di avvio
+    /*! La latenza di avvio è il tempo tra la chiamata a `invia()` e la fine
+        della trasmissione (PacketSent), meno la durata della trasmissione
+        stessa (cfr. `tempoInAria()`). Le trasmissioni iniziate dalla modalità
+        FS sono contate separatamente.
+        @param daFS `true` per le trasmissioni iniziate in modalità FS
+        @param classe classe di latenza, da 0 a `nrClassiLatenzaTx - 1`: la
+               classe 0 comprende le latenze sotto i 250 us, ogni classe
+               successiva arriva al doppio della precedente, l'ultima comprende
+               tutte le latenze di almeno 16 ms
+    */
+    uint16_t nrTrasmissioniPerLatenza(bool daFS, uint8_t classe);
+
+    //! Stampa sul monitor seriale l'istogramma delle latenze di avvio delle trasmissioni
+    /*! cfr. `nrTrasmissioniPerLatenza()`
+    */
+    void stampaLatenzaTxSerial(HardwareSerial& Serial);
+
+    //! Restituisce la RAM occupata dalla classe (in bytes)
+    /*! Somma l'istanza, la coda di ricezione, l'interfaccia di comunicazione
+        (solo se creata da una funzione "creaInterfaccia": un'interfaccia
+        allocata dall'utente non è contata) e i membri `static`. Con `inizializza(Memoria&)` la coda è già contata
+        nella dimensione della memoria dell'utente (cfr. `Memoria::byteOccupati`)
+        e tutto il totale è noto al momento della compilazione.
+    */
+    uint16_t memoriaOccupata();
+
+    //! Stampa sul monitor seriale la RAM occupata dalla classe, voce per voce
+    /*! cfr. `memoriaOccupata()`
+    */
+    void stampaMemoriaSerial(HardwareSerial& Serial);
+
+    //! Numero di classi dell'istogramma delle latenze di trasmissione
+    static constexpr uint8_t nrClassiLatenzaTx = 8;
+
     //!@}
 
 
@@ -703,7 +2151,7 @@ public:
             */
             initErroreImpostazione      = 7,
             /*! inizializza(): %Lunghezza massima messaggi troppo grande (>64)
-             * grande
+             * oppure memoria statica troppo piccola per i byte di parità della FEC
             */
             initLunghMaxMessEccessiva   = 8,
 
@@ -752,7 +2200,57 @@ public:
             /*! inviaFinoAck(): Dopo aver provato per il numero di volte specificato
             a contattare l'altra radio non c'è stata risposta.
             */
-           inviaFinoAckNoRisposta       = 18
+           inviaFinoAckNoRisposta       = 18,
+
+            /*! invia(): TDMA attivo e coda dei messaggi da inviare piena
+            */
+            inviaCodaPiena              = 19,
+            /*! attivaTDMACoordinatore(): troppi nodi per un beacon o slot
+            troppo lunghi
+            */
+            tdmaImpostazioneNonValida   = 20,
+            /*! impostaListen(): durata non rappresentabile o finestra di
+            ricezione troppo breve
+            */
+            listenImpostazioneNonValida = 21,
+            /*! applicaProfilo(): la radio sta inviando o ricevendo
+            */
+            profiloRadioOccupata        = 22,
+            /*! attivaFHSS(): numero di canali, frequenze o durata non validi
+            */
+            fhssImpostazioneNonValida   = 23,
+            /*! analizzaSpettro(), avviaAnalisiSpettro(): parametri non validi
+            o radio occupata
+            */
+            analisiSpettroImpossibile   = 24,
+            /*! attivaCorrezioneFrequenza(): tabella vuota
+            */
+            correzioneFrequenzaNonValida = 25,
+            /*! avviaMisuraTemperatura(): radio occupata;
+            attivaCompensazioneTemperatura(): tabella vuota
+            */
+            temperaturaImpossibile      = 26,
+            /*! avviaCattura(): radio occupata, memoria troppo piccola o bit
+            rate oltre `bitRateMassimaCattura`
+            */
+            catturaImpossibile          = 27,
+            /*! attivaSniffer(): radio occupata
+            */
+            snifferRadioOccupata        = 28,
+            /*! attivaMesh(): indirizzo non valido o lunghezza massima dei
+            messaggi troppo piccola per l'intestazione mesh
+            */
+            meshImpostazioneNonValida   = 29,
+            /*! inviaMesh(): mesh non attivo o destinazione sconosciuta
+            */
+            meshNessunaRotta            = 30,
+            /*! inviaMulticast(): gruppo non valido o multicast non attivo
+            */
+            multicastGruppoNonValido    = 31,
+            /*! inviaConAck(): controllo della congestione attivo e intervallo
+            dall'ultimo invio non ancora trascorso
+            */
+            inviaCongestione            = 32
         };
     };
 
@@ -795,14 +2293,52 @@ private:
 
         Intestazione() : byte(0) {}
     };
-    // Valore massimo nel field Intestazione::bit::titolo (dipende dalla sua dimensione)
-    const uint8_t valMaxTitolo = 64;
+    // Titolo riservato ai messaggi di servizio, che le classi scambiano tra
+    // loro e non sono annunciati all'utente
+    static constexpr uint8_t titoloServizio = (1 << nrBitPerTitolo) - 1;
+    // Valore massimo nel field Intestazione::bit::titolo utilizzabile dall'utente
+    const uint8_t valMaxTitolo = titoloServizio - 1;
+
+    // Il primo byte di un messaggio di servizio ne indica il tipo
+    enum class Servizio : uint8_t {
+        // proposta di un profilo di bit rate: [tipo][profilo]
+        cambioProfilo = 1,
+        // beacon di sincronizzazione: [tipo][numero][ora di invio del beacon
+        // precedente (4 bytes, little endian)]
+        sincronizzazione = 2,
+        // beacon TDMA: [tipo][nr slot][durata slot / 16us (2 bytes)]
+        // [guardia / 16us (2 bytes)][lunghezza max][posizione nella sequenza
+        // FHSS][id nodo di ogni slot...]
+        superframe = 3,
+        // risveglio di una radio in listen: [tipo]
+        risveglio = 4,
+        // messaggio mesh: [tipo][mittente del salto][destinatario del salto]
+        // [sequenza][origine][destinazione][salti][titolo][messaggio...]
+        meshDati = 5,
+        // annuncio delle rotte: [tipo][mittente][nr rotte]
+        // [destinazione, costo, prossimo salto...]
+        meshVettore = 6,
+        // messaggio multicast (gruppo 0 - 7) o broadcast (gruppo 255):
+        // [tipo][gruppo][sequenza][titolo][messaggio...]
+        multicast = 7,
+        // ultimo messaggio multicast inviato: [tipo][gruppo][sequenza]
+        statoMulticast = 8,
+        // richiesta di ritrasmissione: [tipo][gruppo][prossima sequenza]
+        // [messaggi mancanti (4 bytes, little endian, bit i -> prossima - 1 - i)]
+        nackMulticast = 9
+    };
 
     // Struct per salvare informazioni sui messaggi ricecvuti
     struct InfoMessaggio {
         uint8_t dimensione;
         Intestazione intestazione;
         uint32_t tempoRicezione;
+        // fine della sync word (us)
+        uint32_t tempoRicezioneUs;
+        // false se il messaggio è arrivato danneggiato e non è stato possibile
+        // ripararlo: in questo caso va ignorato (anche l'intestazione)
+        bool valido;
+        int8_t rssi;
     };
 
 
@@ -811,6 +2347,8 @@ private:
     // [privata] Funzione di invio dei messaggi
     /* Questa funzione è alla base di tutte le funzioni di invio messaggi, che
         si limitano a scrivere l'intestazione del messaggio prima di chiamarla.
+        Il `prefisso` (ad es. l'intestazione di un servizio) è scritto nella
+        FIFO prima del messaggio, così i due non vanno copiati in un solo array.
         Le funzioni pubbliche di invio sono:
         - `inviaConAck()`
         - `inviaFinoAck()`
@@ -819,23 +2357,86 @@ private:
         funzione a disposizione dell'utente la usa ed è quindi sempre `true`
     */
     int inviaMessaggio(const uint8_t messaggio[], uint8_t lunghezza,
-                    uint8_t intestazione, bool insisti = true);
-
-    // Segna l'ultimo messaggio come letto (usato in leggi() e scartaMessaggio())
+                    uint8_t intestazione, bool insisti = true,
+                    const uint8_t prefisso[] = nullptr, uint8_t lunghezzaPrefisso = 0);
+
+    // Inizializzazione vera e propria, chiamata da tutte le versioni pubbliche.
+    // Se `dati` e `info` sono nullptr la coda è allocata dinamicamente,
+    // altrimenti usa la memoria indicata, che ha spazio per `byteParitaMemoria`
+    // byte di parità per messaggio.
+    int inizializza(uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda,
+                    uint8_t* dati, InfoMessaggio* info, uint8_t byteParitaMemoria);
+    // Come sopra, stampando il risultato sul monitor seriale
+    int inizializza(uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda,
+                    uint8_t* dati, InfoMessaggio* info, uint8_t byteParitaMemoria,
+                    HardwareSerial& serial);
+
+    // Segna il primo messaggio della coda come letto (usato in leggi(),
+    // scartaMessaggio() e rilasciaMessaggio())
     void segnaMessaggioComeLetto();
 
+    // Scarica dalla FIFO un messaggio protetto dalla FEC e, se necessario, lo ripara
+    void scaricaMessaggioFEC();
+
+    // Invia un messaggio di servizio (cfr. `Servizio`)
+    int inviaServizio(const uint8_t messaggio[], uint8_t lunghezza, bool ack);
+    // Come sopra, con l'intestazione del servizio separata dai dati
+    int inviaServizio(const uint8_t prefisso[], uint8_t lunghezzaPrefisso,
+                      const uint8_t dati[], uint8_t lunghezza, bool ack);
+    // Esegue un messaggio di servizio appena ricevuto
+    void gestisciServizio();
+
+    // Passa l'ultimo messaggio alla funzione di gestione corrispondente al suo
+    // titolo; restituisce false se non esiste
+    bool consegnaMessaggio();
+    // Funzione di gestione per un titolo (quella di default se non ne ha una)
+    FunzioneRicezione trovaFunzioneRicezione(uint8_t titolo);
+    // Il messaggio appena scaricato è destinato alla coda dell'utente (non è
+    // un ACK, un messaggio di servizio o un messaggio per una funzione)
+    bool destinatoAllaCoda();
+
+    // Funzioni di gestione collegate ai titoli
+    struct CollegamentoRicezione {
+        uint8_t titolo;
+        FunzioneRicezione funzione;
+    };
+    // Tabella fornita dall'utente (nullptr: nessuna funzione di gestione)
+    TabellaRicezione* funzioniRicezione = nullptr;
+    // Il messaggio appena scaricato deve essere consegnato alla fine di controlla()
+    bool consegnaInSospeso = false;
+    // Una funzione di gestione è in esecuzione (le chiamate annidate a
+    // controlla() non devono consegnare altri messaggi)
+    bool consegnaInCorso = false;
+
+    // Titoli dei messaggi da ricevere (bit n -> titolo n)
+    uint64_t titoliAccettati = ~0ULL;
+    // L'ultimo messaggio è stato scartato dal filtro dopo la lettura
+    // dell'intestazione: il suo contenuto non è nel buffer
+    bool messaggioFiltrato = false;
+    // L'ultimo messaggio è un messaggio mesh per questa radio, già convertito
+    // in un messaggio normale (l'ACK ha il titolo di servizio)
+    bool messaggioMeshConsegnato = false;
+    // Restituisce `true` se un messaggio con questa intestazione va scartato
+    bool daFiltrare(Intestazione intestazione);
+
     // Imposta la modalità di funzionamento
     /* Cambia la modalità della radio. Questa funzione è chiamata per ogni
         cambiamento di modalità, richiesto dall'utente direttamente
         (`ricevi();`, `standby();`, ...), indirettamente (`invia()`;, ...)
-        o dall'`isr()`. Se richiesta dall'utente può bloccare il programma per
-        qualche millisecondo, soprattutto in caso di cambiamento verso la modalità
-        listen, o da o verso la modalità trasmissione, mentre è molto rapida se
-        chiamata nell'`isr()`.
+        o dall'`isr()`. Con `aspetta == true` la funzione termina quando la
+        radio è pronta nella nuova modalità (di solito qualche decina di us,
+        al massimo circa 1 ms), altrimenti termina subito e il cambiamento è
+        concluso dalle successive chiamate a `controlla()`.
     */
     int cambiaModalita(Modalita, bool aspetta = true);
 
-    // Aspetta che la 
+    // Conclude il cambiamento di modalità in corso se la radio è pronta
+    int completaCambioModalita();
+    // un cambiamento di modalità è stato richiesto e la radio non è ancora pronta
+    bool cambioModalitaInCorso = false;
+    uint32_t inizioCambioModalitaUs;
+    // tempo massimo per un cambiamento di modalità
+    static constexpr uint16_t timeoutCambioModalitaUs = 3000;
 
     enum class AMEnterCond : uint8_t {
         //none = 0x0 non può essere usata (bisogna impostare sia enter sia exit)
@@ -911,6 +2512,8 @@ private:
     // Modalità usata quando non ne è specificata un'altra per eseguire un'azione
     // particolare
     Modalita modalitaDefault;
+    // Attendi in FS invece che in standby quando modalitaDefault == standby
+    bool preriscaldamentoFS = false;
 
     // Invece di rimanere in RX, passa automaticamente a standby non appena arriva
     // un messaggio. Questo impedisce a messaggi seguenti di sovrascriverlo prima
@@ -945,6 +2548,15 @@ private:
 
     // controllo ISR (serve sia per debug che per le statistiche sugli ACK qui sotto)
     uint32_t tempoUltimaEsecuzioneIsr; // in ms
+    volatile uint32_t tempoUltimaEsecuzioneIsrUs;
+    // Ritardo stimato tra il fronte di DIO0 e la lettura di micros() nell'ISR
+    // (ingresso nell'interrupt, isrCaller() e chiamata a isr())
+    static constexpr uint8_t latenzaInterruptUs = 8;
+    // Fine della sync word dell'ultimo pacchetto inviato (us), calcolata
+    // dall'ISR a PacketSent
+    volatile uint32_t tempoInvioUs = 0;
+    // Durata della parte del pacchetto inviato che segue la sync word
+    uint32_t durataDopoSincUltimoInvio;
 
     // # Timeout #
     // Tempo massimo di attesa dell'ACK (deve essere scelto in base alla frequenza
@@ -966,6 +2578,8 @@ private:
     // ALLA FUNZIONE leggi()] + [trasmissione ACK]
     // Questa variabile ha un 'getter' pubblico
     uint16_t durataUltimaAttesaAck;
+    // La stessa in us, tra le sync word di messaggio e ACK
+    uint32_t durataUltimaAttesaAckUs;
     // Durata massima dell'attesa di un ACK dall'ultima inizializzazione ad ora
     // Questa variabile ha un 'getter' pubblico perché può essere usata per impostare
     // `timeoutAck`
@@ -1054,13 +2668,16 @@ private:
         // trasmissione di un ack
         invioAck,
         // radio in standby, in attesa che l'utente legga un messagio
-        standbyAttendendoLettura
+        standbyAttendendoLettura,
+        // radio in rx su un altro canale per misurare il rumore (l'ISR
+        // ignora i messaggi)
+        misuraRssi,
+        // radio in rx continua per la cattura del segnale (l'ISR ignora
+        // gli interrupt su DIO0)
+        cattura
 
     };
     volatile Stato stato = Stato::passivo;
-    // NuovoMessaggio è una flag separata da 'stato' perché mentre c'è un nuovo
-    // messaggio (già estratto dalla FIFO) si può usare la radio
-    bool messaggioRicevuto = false;
 
 
     // l'ISR imposta queste variabili, la funzione controlla() esegue le azioni
@@ -1097,38 +2714,756 @@ private:
     inline void set(volatile bool& x) { x = true; }
     inline void clear(volatile bool& x) { x = false; }
 
+    // Coda circolare dei messaggi ricevuti. Ha una posizione in più del numero
+    // di messaggi che può contenere: quella dopo l'ultimo messaggio è sempre
+    // libera e riceve i dati scaricati dalla FIFO (messaggi, ACK, messaggi di
+    // servizio). Un messaggio entra in coda solo con aggiungi(), quindi i
+    // messaggi in attesa di lettura non sono mai sovrascritti.
+    // Gli operatori di accesso si riferiscono alla posizione libera.
     class Buffer {
         typedef uint8_t data_type;
         data_type * dataptr = nullptr;
+        InfoMessaggio * info = nullptr;
+        // false se la memoria è dell'utente (cfr. Memoria)
+        bool allocata = false;
         uint8_t len = 0;
+        uint8_t nrPosizioni = 0;
+        // posizione del messaggio più vecchio e numero di messaggi in coda
+        uint8_t primo = 0;
+        uint8_t occupate = 0;
+        uint8_t posizione(uint8_t n) { return (primo + n) % nrPosizioni; }
     public:
         // la dimensione non è nota al momento dela costruzione di RFM69
         Buffer() = default;
-        void init(uint8_t dimensione) {
-            if(dataptr != nullptr) delete[] dataptr;
-            dataptr = new data_type[dimensione];
-            len = dimensione; }
-        ~Buffer() { delete[] dataptr; }
+        // se `memoriaDati` e `memoriaInfo` sono nullptr la memoria è allocata
+        // dinamicamente
+        void init(uint8_t dimensione, uint8_t nrMessaggi,
+                  data_type* memoriaDati = nullptr, InfoMessaggio* memoriaInfo = nullptr) {
+            liberaMemoria();
+            nrPosizioni = nrMessaggi + 1;
+            allocata = memoriaDati == nullptr || memoriaInfo == nullptr;
+            dataptr = allocata ? new data_type[dimensione * nrPosizioni] : memoriaDati;
+            info = allocata ? new InfoMessaggio[nrPosizioni] : memoriaInfo;
+            len = dimensione;
+            primo = 0;
+            occupate = 0; }
+        ~Buffer() { liberaMemoria(); }
+        void liberaMemoria() {
+            if(allocata) { delete[] dataptr; delete[] info; }
+            dataptr = nullptr;
+            info = nullptr;
+            allocata = false; }
+        // bytes occupati dalla coda (nello heap o nella memoria dell'utente)
+        uint16_t dimensioneMemoria() {
+            return nrPosizioni * (len + sizeof(InfoMessaggio)); }
         // non copiabile (come RFM69)
         Buffer(const Buffer&) = delete;
         Buffer& operator = (const Buffer&) = delete;
-        // operatori di accesso
+        // operatori di accesso alla posizione libera
         data_type operator [] (unsigned int i) {
-            return i < len ? *(dataptr + i) : 0; }
-        operator data_type*() { return dataptr; }
+            return i < len ? *(libera() + i) : 0; }
+        operator data_type*() { return libera(); }
+        data_type* libera() { return dataptr + posizione(occupate) * len; }
+        uint8_t lunghezzaPosizione() { return len; }
+        // mette in coda il messaggio nella posizione libera
+        void aggiungi(const InfoMessaggio& i) { info[posizione(occupate)] = i; ++occupate; }
+        // messaggio più vecchio, il prossimo da leggere
+        const data_type* primoMessaggio() { return dataptr + primo * len; }
+        const InfoMessaggio& infoPrimo() { return info[primo]; }
+        void rimuoviPrimo() { if(occupate) { primo = posizione(1); --occupate; } }
+        uint8_t nrMessaggi() { return occupate; }
+        uint8_t capacita() { return nrPosizioni - 1; }
+        bool vuoto() { return occupate == 0; }
+        bool pieno() { return occupate == nrPosizioni - 1; }
     } buffer;
 
 
+    // ### Forward Error Correction ###
+
+    // Codice Reed-Solomon su GF(2^8) che protegge intestazione e contenuto dei
+    // messaggi (cfr. FEC in RFM69_impostazioni.h). La parola di codice è
+    // sistematica: [intestazione][contenuto][parità]
+    class FEC {
+    public:
+        // Numero massimo di byte di parità (permette di correggere 8 byte)
+        static constexpr uint8_t maxByteParita = 16;
+
+        // Prepara il polinomio generatore per `byteParita` byte di parità
+        FEC(uint8_t byteParita);
+        // Aggiungi un byte della parola di codice al calcolo della parità
+        void codifica(uint8_t byte);
+        // Byte di parità dei dati passati finora a codifica()
+        const uint8_t* parita() const { return registro; }
+
+        // Corregge sul posto una parola di codice ricevuta (parità compresa).
+        // Restituisce il numero di byte corretti oppure -1 se gli errori sono
+        // troppi; in questo caso la parola non è modificata.
+        static int8_t decodifica(uint8_t* parola, uint8_t lunghezza, uint8_t byteParita);
+
+    private:
+        const uint8_t nrParita;
+        uint8_t generatore[maxByteParita + 1];
+        uint8_t registro[maxByteParita];
+    };
+
+    // Numero di byte di parità FEC aggiunti a ogni messaggio (0: FEC disattivata)
+    const uint8_t byteParitaFEC;
+
+
+    // ### Bit rate adattiva ###
+
+    // Numero di profili (bit rate, fdev, RxBw) nella tabella in
+    // RFM69_inizializzazione.cpp, dal più lento al più veloce
+    static constexpr uint8_t nrProfiliModem = 7;
+    // Profilo usato da entrambe le radio quando il collegamento si perde
+    static constexpr uint8_t profiloRendezvous = 0;
+    // Nessun profilo (impostazioni del file di impostazione o di impostaBitRate())
+    static constexpr uint8_t nessunProfilo = 0xFF;
+    // Numero di ACK attesi su cui si valuta il collegamento
+    static constexpr uint8_t finestraAdattamento = 8;
+    // ACK persi in una finestra oltre i quali si passa al profilo più lento
+    static constexpr uint8_t maxPerditeFinestra = 2;
+    // ACK persi di seguito dopo i quali si torna al profilo di rendezvous
+    static constexpr uint8_t maxPerditeConsecutive = 4;
+    // Margine (dB) sopra la sensibilità di un profilo richiesto per usarlo
+    static constexpr uint8_t margineRssi = 10;
+
+    // Scrive nei registri un profilo della tabella (la radio deve essere in standby)
+    void applicaProfiloModem(uint8_t profilo);
+    // RSSI minimo (sensibilità stimata) di un profilo
+    int8_t rssiMinimoProfilo(uint8_t profilo);
+    // Aggiorna le statistiche della finestra con l'esito di un ACK atteso
+    void registraEsitoAck(bool ricevuto);
+    // Propone all'altra radio `profiloDaProporre` e aspetta la risposta
+    void negoziaProfilo();
+    // Torna al profilo di rendezvous se l'altra radio tace da troppo tempo
+    void controllaRendezvous();
+    void azzeraFinestraAdattamento();
+
+    bool bitRateAdattiva = false;
+    uint32_t bitRateCorrente;
+    // profilo in uso
+    uint8_t profiloModem = nessunProfilo;
+    // profilo da scrivere nei registri al prossimo ritorno in modalità default
+    uint8_t profiloDaApplicare = nessunProfilo;
+    // profilo da proporre all'altra radio appena la radio è libera
+    uint8_t profiloDaProporre = nessunProfilo;
+    // impedisce che controlla(), chiamata durante la proposta, ne inizi un'altra
+    bool negoziazioneInCorso = false;
+    // statistiche della finestra corrente
+    uint8_t esitiFinestra;
+    uint8_t perditeFinestra;
+    int16_t sommaRssiFinestra;
+    uint8_t perditeConsecutive;
+    // rendezvous
+    uint16_t timeoutRendezvous;
+    uint32_t tempoUltimoMessaggio;
+
+
+    // ### Controllo della potenza di trasmissione ###
+
+    // Potenza minima usata dal controllo automatico: la minima di PA1 (RFM69HCW
+    // non trasmette con PA0, usato sotto -2 dBm)
+    static constexpr int8_t potenzaMinimaTx = -2;
+    // Variazioni dell'RSSI riportato (dB) che non cambiano la potenza
+    static constexpr uint8_t isteresiPotenza = 3;
+    // Aumento della potenza (dB) dopo un ACK perso
+    static constexpr uint8_t aumentoPotenzaPerdita = 3;
+
+    // Scrive la potenza nel registro PaLevel senza cambiare `potenzaMassimaTx`
+    bool scriviPotenzaTx(int dBm);
+    // Valore del registro PaLevel per una potenza tra -18 e +20 dBm: PA0 sotto
+    // -2 dBm, PA1 fino a +13, PA1 e PA2 oltre (cfr. datasheet, RegPaLevel)
+    static constexpr uint8_t valorePaLevel(int dBm) {
+        return dBm < -2 ? 0x80 | (dBm + 18)
+            : dBm <= 13 ? 0x40 | (dBm + 18)
+            : dBm <= 17 ? 0x60 | (dBm + 14)
+            : 0x60 | (dBm + 11);
+    }
+    // Adatta la potenza all'RSSI riportato nell'ultimo ACK
+    void regolaPotenza();
+    // Sensibilità stimata della radio alla bit rate attuale (dBm)
+    int8_t sensibilitaStimata();
+    // Energia (uJ) spesa per trasmettere un pacchetto con `lunghezza` bytes di contenuto
+    uint32_t energiaTrasmissione(uint8_t lunghezza);
+    // Durata (us) della parte di un pacchetto che segue la sync word, cioè
+    // del ritardo tra la sincronizzazione e PacketSent o PayloadReady
+    uint32_t durataDopoSincronizzazione(uint8_t lunghezza);
+
+    bool controlloPotenza = false;
+    uint8_t marginePotenza;
+    int8_t potenzaTx;
+    int8_t potenzaMassimaTx;
+    // RSSI riportato nell'ultimo ACK
+    int8_t rssiRiportato;
+
+    // Riempie un profilo con i valori dati e il resto dal file di impostazione
+    void riempiProfilo(ProfiloRadio& profilo, const char* nome, uint16_t valBitRate,
+                       uint16_t valFreqDev, uint8_t valRxBw, uint16_t preambolo);
+    // bandaNecessariaFSK() con la frequenza del file di impostazione
+    uint32_t bandaNecessaria(uint32_t bitRate, uint32_t freqDev);
+
+    // Formule dei registri e vincoli del datasheet per la modulazione FSK,
+    // usate sia da Configurazione (in compilazione) che da creaProfilo()
+    static constexpr bool vincoliFSK(uint32_t bitRate, uint32_t freqDev) {
+        return bitRate >= 1200 && bitRate <= 300000 && freqDev >= 600
+            && freqDev + bitRate / 2 <= 500000
+            && 4 * freqDev >= bitRate && freqDev <= 5 * bitRate;
+    }
+    static constexpr uint16_t valoreBitRate(uint32_t bitRate) {
+        return (32000000UL + bitRate / 2) / bitRate;
+    }
+    // [valore = Fdev / Fstep], con Fstep = 32 MHz / 2^19
+    static constexpr uint16_t valoreFreqDev(uint32_t freqDev) {
+        return ((uint64_t)freqDev * 524288 + 16000000) / 32000000;
+    }
+    // Stessa formula per la frequenza portante (registri Frf, 24 bits)
+    static constexpr uint32_t valoreFrequenza(uint32_t frequenza) {
+        return ((uint64_t)frequenza * 524288 + 16000000) / 32000000;
+    }
+    // Bandwidth del channel filter (FSK) per i 24 valori possibili, dal più
+    // stretto (mantissa 24, esponente 7) al più largo (16, 0): cfr. datasheet,
+    // [RxBw = Fxosc / (RxBwMant * 2^(RxBwExp + 2))]. RxBw è la banda su un
+    // solo lato: è raddoppiata per il confronto con la banda del segnale
+    static constexpr uint32_t bandaRxBw(uint8_t i) {
+        return 2 * (32000000UL / ((24 - 4 * (i % 3)) * (4UL << (7 - i / 3))));
+    }
+    // Indice (cfr. bandaRxBw()) del filtro più stretto che contiene `banda`
+    // (24 se nessuno basta)
+    static constexpr uint8_t indiceRxBw(uint32_t banda, uint8_t i = 0) {
+        return i >= 24 || banda <= bandaRxBw(i) ? i : indiceRxBw(banda, i + 1);
+    }
+    // Bandwidth (come bandaRxBw()) del filtro con il valore `valore` di
+    // RxBwMant e RxBwExp, dalla formula del datasheet
+    static constexpr uint32_t bandaValoreRxBw(uint8_t valore) {
+        return 2 * (32000000UL / ((16 + 4 * ((valore >> 3) & 0x03)) * (4UL << (valore & 0x07))));
+    }
+    // Valore di RxBwMant e RxBwExp del filtro più stretto che contiene
+    // `banda` (0xFF se nessuno basta)
+    static constexpr uint8_t valoreRxBw(uint32_t banda, uint8_t i = 0) {
+        return i >= 24 ? 0xFF
+            : banda <= bandaRxBw(i) ? (uint8_t)(((2 - i % 3) << 3) | (7 - i / 3))
+            : valoreRxBw(banda, i + 1);
+    }
+
+    // Profilo radio scritto per ultimo (nullptr se i registri sono stati
+    // cambiati in altro modo)
+    const ProfiloRadio* profiloRadioAttivo = nullptr;
+    uint16_t durataCambioProfiloUs = 0;
+    // statistiche per `energiaPerByte()`
+    uint32_t energiaTx;
+    uint32_t byteConsegnati;
+    uint8_t lunghezzaUltimoInvio;
+
+
+    // ### Sincronizzazione del tempo ###
+
+    // Ruolo della radio nella sincronizzazione
+    enum class RuoloSincronizzazione : uint8_t {nessuno, radice, nodo};
+    // Stato fornito dall'utente (nullptr: sincronizzazione non attiva)
+    StatoSincronizzazione* sincronizzazione = nullptr;
+
+    // Chiamata da gestisciServizio() alla ricezione di un beacon
+    void riceviBeaconSincronizzazione();
+    // Aggiunge un punto alla tabella e ricalcola scarto e deriva
+    void aggiungiPuntoSincronizzazione(uint32_t locale, int32_t scarto);
+    // Chiamata da controlla(): invia i beacon periodici sulla radice
+    void controllaBeaconSincronizzazione();
+
+    // Un punto della regressione: "ora" locale di ricezione di un beacon e
+    // differenza tra l'"ora" globale di invio e quella locale
+    struct PuntoSincronizzazione {
+        uint32_t locale;
+        int32_t scarto;
+    };
+    // Un nuovo punto che si discosta dalla stima più di così indica che la
+    // radice è cambiata o si è riavviata: la tabella è cancellata
+    static constexpr uint16_t massimoErroreSincronizzazioneUs = 2000;
+
+
+    // ### TDMA ###
+
+    enum class RuoloTDMA : uint8_t {nessuno, coordinatore, nodo};
+    RuoloTDMA ruoloTDMA = RuoloTDMA::nessuno;
+
+    // Versione non template di attivaTDMA()
+    void attivaTDMA(uint8_t idNodo, uint8_t* dati, uint8_t* lunghezze,
+                    uint8_t* intestazioni, uint8_t lunghezzaMax, uint8_t nrMessaggi);
+    // Mette in coda un messaggio (chiamata dalle funzioni di invio pubbliche)
+    int accodaInvio(const uint8_t messaggio[], uint8_t lunghezza, uint8_t intestazione);
+    // Chiamata da gestisciServizio() alla ricezione di un beacon TDMA
+    void riceviBeaconTDMA();
+    // Chiamata da controlla(): beacon sul coordinatore, invio dalla coda sui nodi
+    void controllaTDMA();
+    // Invia il primo messaggio della coda se il nodo è nel suo slot
+    void inviaDaCodaTDMA();
+
+    // Coda circolare dei messaggi da inviare, in una memoria dell'utente
+    // (cfr. MemoriaInvio)
+    class CodaInvio {
+        uint8_t* dati = nullptr;
+        uint8_t* lunghezze = nullptr;
+        uint8_t* intestazioni = nullptr;
+        uint8_t len = 0;
+        uint8_t capacita = 0;
+        uint8_t primo = 0;
+        uint8_t occupate = 0;
+    public:
+        void init(uint8_t* d, uint8_t* l, uint8_t* i, uint8_t lunghezza, uint8_t nr) {
+            dati = d; lunghezze = l; intestazioni = i;
+            len = lunghezza; capacita = nr; primo = 0; occupate = 0; }
+        // il prefisso (se c'è) è messo nella voce prima del messaggio
+        bool aggiungi(const uint8_t* messaggio, uint8_t lunghezza, uint8_t intestazione,
+                      const uint8_t* prefisso = nullptr, uint8_t lunghezzaPrefisso = 0) {
+            if(occupate == capacita || lunghezzaPrefisso + lunghezza > len) return false;
+            uint8_t p = (primo + occupate) % capacita;
+            uint8_t* voce = dati + p * len;
+            for(uint8_t i = 0; i < lunghezzaPrefisso; i++) voce[i] = prefisso[i];
+            for(uint8_t i = 0; i < lunghezza; i++) voce[lunghezzaPrefisso + i] = messaggio[i];
+            lunghezze[p] = lunghezzaPrefisso + lunghezza;
+            intestazioni[p] = intestazione;
+            ++occupate;
+            return true; }
+        const uint8_t* primoMessaggio() { return dati + primo * len; }
+        uint8_t lunghezzaPrimo() { return lunghezze[primo]; }
+        uint8_t intestazionePrimo() { return intestazioni[primo]; }
+        void rimuoviPrimo() { if(occupate) { primo = (primo + 1) % capacita; --occupate; } }
+        void svuota() { primo = 0; occupate = 0; }
+        uint8_t nrMessaggi() { return occupate; }
+        bool vuota() { return occupate == 0; }
+    } codaInvio;
+
+    // Stime usate per calcolare il tempo di guardia sul coordinatore:
+    // incertezza dei timestamp (latenza degli interrupt, avvio della
+    // trasmissione) e deriva relativa massima di due oscillatori (+-50 ppm)
+    static constexpr uint16_t erroreTempoTDMAUs = 200;
+    static constexpr uint8_t derivaMassimaPpm = 100;
+    // Tempo tra la chiamata a inviaMessaggio() e l'inizio del preambolo
+    static constexpr uint16_t latenzaAvvioTxUs = 500;
+
+    // Parametri del superframe (calcolati dal coordinatore, ricevuti dai nodi)
+    uint32_t durataSlotUs = 0;
+    uint32_t guardiaUs = 0;
+    uint8_t nrSlotTDMA = 0;
+    uint8_t lunghezzaMaxTDMA = 0;
+    // Fine della sync word dell'ultimo beacon (ora locale): inizio del superframe
+    uint32_t inizioSuperframe = 0;
+    bool superframeValido = false;
+
+    // Coordinatore
+    const uint8_t* nodiTDMA = nullptr;
+
+    // Nodo
+    uint8_t idNodoTDMA = 0;
+    // slot del nodo (0: nessuno, lo slot 0 è quello del beacon)
+    uint8_t slotTDMA = 0;
+    // superframe (contati da inizioSuperframe) in cui il nodo ha già trasmesso
+    uint8_t ultimoSuperframeUsato = 0xFF;
+    uint8_t tentativiTDMA = 0;
+    uint16_t messaggiPersiTDMA = 0;
+    // Coordinatore: superframe inviati; nodo: valore ricevuto con l'ultimo
+    // beacon. Modulo il numero di canali è la posizione nella sequenza FHSS.
+    uint8_t indiceSuperframe = 0;
+
+
+    // ### Salto di frequenza ###
+
+    // Versione non template di attivaFHSS()
+    int attivaFHSS(uint8_t* frf, uint8_t* sequenza, uint8_t nrCanali, uint32_t frequenzaBase,
+                   uint32_t spaziatura, uint16_t durataCanaleMs, uint8_t seme);
+    // Posizione nella sequenza in cui dovrebbe essere la radio in questo momento
+    uint8_t posizioneFHSS();
+    // Chiamata da controlla(): passa al canale della posizione attuale
+    void controllaFHSS();
+    // Scrive la frequenza di un canale della tabella (la radio deve essere libera)
+    void cambiaCanaleFHSS(uint8_t canale);
+
+    // Tabella dei canali, in una memoria dell'utente (cfr. MemoriaFHSS):
+    // tre bytes (FRF MSB, MID, LSB) per canale e la sequenza degli indici
+    uint8_t* tabellaFHSS = nullptr;
+    uint8_t* sequenzaFHSS = nullptr;
+    // 0: salto di frequenza disattivato
+    uint8_t nrCanaliFHSS = 0;
+    uint32_t durataCanaleFHSSUs = 0;
+    uint8_t canaleAttualeFHSS = 0;
+    uint32_t saltiFHSS = 0;
+
+
+    // ### Analisi dello spettro ###
+
+    // Misura il rumore su un canale e torna alla frequenza precedente
+    int8_t misuraRssiCanale(uint32_t frequenza);
+    // Aggiunge una misura alla tabella
+    static void registraMisuraSpettro(CanaleSpettro& canale, int8_t rssi);
+    // Chiamata da controlla(): una misura ogni intervalloSpettro ms
+    void controllaAnalisiSpettro();
+
+    // Tempo massimo per una misura dell'RSSI (cfr. RssiDone)
+    static constexpr uint16_t timeoutMisuraRssiUs = 2000;
+
+    // Analisi in sottofondo (0 canali: ferma)
+    CanaleSpettro* canaliSpettro = nullptr;
+    uint8_t nrCanaliSpettro = 0;
+    uint32_t frequenzaBaseSpettro = 0;
+    uint32_t spaziaturaSpettro = 0;
+    uint16_t intervalloSpettro = 0;
+    uint32_t tempoUltimaMisuraSpettro = 0;
+    uint8_t prossimoCanaleSpettro = 0;
+
+
+    // ### Correzione della frequenza ###
+
+    // Corrispondente dei messaggi in questo momento (0xFF: nessuno)
+    uint8_t corrispondenteAttuale();
+    // Correzione da applicare per il corrispondente attuale (unità di Fstep)
+    int16_t correzioneDesiderata();
+    // Chiamata dopo lo scaricamento di un messaggio: legge l'AFC e aggiorna la stima
+    void registraErroreFrequenza();
+    // Chiamata da controlla(): corregge la frequenza se la stima è cambiata abbastanza
+    void controllaCorrezioneFrequenza();
+    // Scrive frequenza nominale + correzione (la radio deve essere libera) e,
+    // se richiesto, riporta la radio alla modalità default
+    void scriviFrequenza(bool tornaAModalitaDefault = true);
+    // [Fstep = 32 MHz / 2^19 = 15625 / 256 Hz]
+    static int32_t hzDaFstep(int32_t valore) {return valore * 15625 / 256;}
+
+    // Frequenza senza correzione (valore dei registri Frf): quella del file
+    // di impostazione, di impostaFrequenzaMHz() o del canale FHSS attuale
+    uint32_t frfNominale = 0;
+    int16_t correzioneApplicata = 0;
+    // Stime per corrispondente, in una memoria dell'utente (unità di Fstep)
+    int16_t* tabellaAFC = nullptr;
+    uint8_t nrCorrispondentiAFC = 0;
+    bool riferimentoAFC = false;
+    uint8_t corrispondenteAFC = 0;
+    int16_t ultimoErroreFrequenza = 0;
+    // Registro AfcFei prima dell'attivazione (cfr. file di impostazione)
+    uint8_t regAfcFeiPrecedente = 0;
+    // Differenza tra stima e correzione applicata che giustifica un cambio
+    // di frequenza (4 Fstep = 244 Hz)
+    static constexpr uint8_t sogliaCorrezioneAFC = 4;
+
+
+    // ### Temperatura ###
+
+    // Chiamata da controlla(): misura la temperatura e corregge la frequenza
+    void controllaCompensazioneTemperatura();
+    // Errore del quarzo (decimi di ppm) interpolato dalla tabella
+    int16_t erroreQuarzo(int8_t gradi);
+
+    // Correzione per la temperatura (unità di Fstep), sommata a quella per il
+    // corrispondente in scriviFrequenza()
+    int16_t correzioneTemperatura = 0;
+    const PuntoTemperatura* tabellaTemperatura = nullptr;
+    uint8_t nrPuntiTemperatura = 0;
+    uint16_t intervalloTemperatura = 0;
+    uint32_t tempoUltimaTemperatura = 0;
+    // ultimo valore del registro Temp2 e calibrazione
+    uint8_t temperaturaGrezza = 0;
+    int8_t calibrazioneTemperatura = 0;
+    // Tempo massimo per una misura (il datasheet indica 100 us)
+    static constexpr uint16_t timeoutTemperaturaUs = 500;
+
+
+    // ### Cattura del segnale ###
+
+    // ISR collegata al pin di DCLK, chiama isrCattura()
+    static void isrCatturaCaller();
+    // Legge un bit da DIO2 e lo aggiunge alla coda
+    void isrCattura();
+
+    uint8_t* memoriaCattura = nullptr;
+    uint16_t dimensioneCattura = 0;
+    // indici della coda circolare: scrittura (ISR) e lettura
+    volatile uint16_t scritturaCattura = 0;
+    volatile uint16_t letturaCattura = 0;
+    // byte in costruzione e numero dei suoi bit già ricevuti
+    uint8_t byteInCattura = 0;
+    uint8_t bitInCattura = 0;
+    volatile uint32_t catturaPersi = 0;
+    // registro di ingresso e bit del pin di DIO2, letti direttamente nell'ISR
+    volatile uint8_t* registroDatiCattura = nullptr;
+    uint8_t mascheraDatiCattura = 0;
+    int8_t interruptCattura = -1;
+    // registro DataModul della modalità a pacchetti, ripristinato alla fine
+    uint8_t regDataModulPacchetto = 0;
+
+
+    // ### Sniffer ###
+
+    // Chiamata da controlla() al posto dello scaricamento normale
+    void scaricaMessaggioSniffer();
+    // Scrive il record pcap dell'ultimo pacchetto (dopo la lettura dell'RSSI)
+    void registraPacchettoSniffer();
+
+    bool snifferAttivo = false;
+    HardwareSerial* uscitaSniffer = nullptr;
+    // registri modificati dallo sniffer, ripristinati alla fine
+    uint8_t regPacketConfig1Sniffer = 0;
+    uint8_t regAfcFeiSniffer = 0;
+    // ultimo pacchetto: esito del CRC, lunghezza originale e bytes scaricati
+    bool crcOkSniffer = false;
+    uint8_t lunghezzaSniffer = 0;
+    uint8_t scaricatiSniffer = 0;
+    // tempo dei record in us su 64 bit (micros() si azzera ogni 71 minuti)
+    uint64_t tempoSnifferUs = 0;
+    uint32_t ultimoTempoSniffer = 0;
+    uint32_t pacchettiSniffer = 0;
+    uint32_t pacchettiErratiSniffer = 0;
+    // [LINKTYPE_USER0]
+    static constexpr uint32_t tipoCollegamentoPcap = 147;
+
+
+    // ### Instradamento (mesh) ###
+
+    // Un vicino (indirizzo 0: posizione libera)
+    struct VicinoMesh {
+        uint8_t indirizzo;
+        // numero di sequenza dell'ultimo messaggio ricevuto (ritrasmissioni)
+        uint8_t ultimaSequenza;
+        bool sequenzaValida;
+        StimaCollegamento stima;
+    };
+    // Una rotta (destinazione 0: posizione libera)
+    struct RottaMesh {
+        uint8_t destinazione;
+        uint8_t prossimoSalto;
+        uint8_t costo;
+        uint32_t aggiornata;
+    };
+
+    // Stato del mesh, nella memoria dell'utente (cfr. MemoriaMesh)
+    struct StatoMesh {
+        uint8_t indirizzo = 0;
+        VicinoMesh* vicini = nullptr;
+        RottaMesh* rotte = nullptr;
+        uint8_t nrNodi = 0;
+        uint8_t lunghezzaMax = 0;
+        // code dei messaggi propri e di quelli da inoltrare, servite a turno
+        // (ma non durante le ritrasmissioni, cfr. inviaDaCodaMesh());
+        // ogni voce è [origine][destinazione][salti][titolo][messaggio...]
+        CodaInvio codaLocale;
+        CodaInvio codaInoltro;
+        bool turnoInoltro = false;
+        // per ogni coda: tentativi, numero di sequenza e inizio (us) dell'invio
+        // del primo messaggio
+        uint8_t tentativi[2] = {0, 0};
+        uint8_t sequenzaInvio[2] = {0, 0};
+        uint32_t inizioSalto[2] = {0, 0};
+        uint8_t prossimaSequenza = 0;
+        uint32_t prossimoTentativo = 0;
+        // evita che le chiamate a controlla() durante l'attesa dell'ACK inviino altro
+        bool invioInCorso = false;
+
+        uint16_t intervalloAnnunci = 0;
+        uint32_t ultimoAnnuncio = 0;
+        uint32_t prossimoAnnuncio = 0;
+        uint32_t ultimoControlloScadenze = 0;
+        // prima rotta del prossimo annuncio, se non entrano tutte in un pacchetto
+        uint8_t primaRottaAnnuncio = 0;
+        // pacchetto dell'annuncio, lungo al massimo quanto un messaggio mesh
+        uint8_t* annuncio = nullptr;
+
+        // statistiche
+        uint16_t messaggiRicevuti = 0;
+        uint16_t messaggiInoltrati = 0;
+        uint16_t messaggiPersi = 0;
+        uint32_t tentativiSalto = 0;
+        uint32_t ackSalto = 0;
+        uint32_t sommaLatenzeSaltoUs = 0;
+        uint16_t saltiMisurati = 0;
+    };
+
+    // Versione non template di attivaMesh()
+    int attivaMesh(uint8_t indirizzo, StatoMesh& stato,
+                   VicinoMesh* vicini, RottaMesh* rotte, uint8_t nrNodi,
+                   uint8_t* datiLocali, uint8_t* lunghezzeLocali, uint8_t* intestazioniLocali,
+                   uint8_t* datiInoltro, uint8_t* lunghezzeInoltro, uint8_t* intestazioniInoltro,
+                   uint8_t* annuncio, uint8_t lunghezzaMax, uint8_t nrMessaggi, uint16_t intervalloAnnunci);
+    // Chiamata da controlla() dopo lo scaricamento: aggiorna la tabella dei
+    // vicini e decide cosa fare di un messaggio mesh (consegna, inoltro, ACK)
+    void esaminaMessaggioMesh();
+    // Chiamata da gestisciServizio() alla ricezione di un annuncio
+    void riceviVettoreMesh();
+    // Chiamata da controlla(): scadenze, annunci e invio dalle code
+    void controllaMesh();
+    // Invia le rotte (una parte, se non entrano in un pacchetto)
+    void inviaVettoreMesh();
+    // Invia il primo messaggio di una delle due code
+    void inviaDaCodaMesh();
+    // Dimentica vicini e rotte scaduti
+    void controllaScadenzeMesh();
+    VicinoMesh* trovaVicinoMesh(uint8_t indirizzo);
+    RottaMesh* trovaRottaMesh(uint8_t destinazione);
+    VicinoMesh* aggiornaVicinoMesh(uint8_t indirizzo, int8_t rssi);
+    void aggiornaRottaMesh(uint8_t destinazione, uint8_t prossimoSalto, uint8_t costo);
+    // Rende irraggiungibili le destinazioni raggiunte tramite un vicino
+    void invalidaRotteMesh(uint8_t prossimoSalto);
+    // Costo di un collegamento: ETX in quarti più la penalità per l'RSSI
+    uint8_t costoCollegamentoMesh(const VicinoMesh& vicino);
+    // Anticipa il prossimo annuncio (dopo un cambiamento delle rotte)
+    void anticipaAnnuncioMesh();
+
+    // nullptr: mesh non attivo
+    StatoMesh* mesh = nullptr;
+    // Ritardo casuale degli annunci dopo un cambiamento: quelli dei vicini, che
+    // hanno sentito lo stesso annuncio, non devono partire insieme
+    static constexpr uint16_t ritardoMinimoAnnuncioMs = 100;
+    static constexpr uint16_t ritardoMassimoAnnuncioMs = 600;
+    // Cambiamenti del costo più piccoli non anticipano l'annuncio, e una
+    // rotta nuova deve costare almeno così meno di quella attuale
+    static constexpr uint8_t isteresiCostoMesh = 4;
+    static constexpr uint8_t costoInfinitoMesh = 255;
+
+
+    // ### Stima dei collegamenti ###
+
+    // Aggiornamenti di una stima (usati anche dal mesh)
+    static void azzeraStima(StimaCollegamento& stima);
+    static void registraRicezioneStima(StimaCollegamento& stima, int8_t rssi);
+    static void registraInvioStima(StimaCollegamento& stima, bool ack);
+    // Chiamate da controlla(): attribuiscono al corrispondente attuale un
+    // messaggio ricevuto e l'esito di un invio con ACK
+    void registraRicezioneCollegamento();
+    void registraInvioCollegamento(bool ack);
+
+    StimaCollegamento* tabellaCollegamenti = nullptr;
+    uint8_t nrCorrispondentiCollegamenti = 0;
+    // PRR di un collegamento nuovo: ottimista, ma non quanto uno provato
+    static constexpr uint8_t prrIniziale = 192;
+
+
+    // ### Controllo della congestione ###
+
+    // Aumento della frequenza per ogni ACK ricevuto (256-esimi di messaggio al secondo)
+    static constexpr uint16_t aumentoTassoInvio = 16;
+    // Durata delle finestre in cui il gateway misura il carico (ms)
+    static constexpr uint16_t finestraCarico = 1000;
+
+    // Chiamata da registraEsitoAck(): AIMD e prossimo istante di invio
+    void aggiornaCongestione(bool ricevuto);
+    // Chiamata da controlla() sul gateway: aggiunge il tempo in aria
+    // dell'ultimo messaggio (e del suo ACK) alla finestra corrente
+    void registraCarico();
+    // Chiude la finestra del carico se è trascorsa
+    void aggiornaCarico();
+
+    bool controlloCongestione = false;
+    // frequenza degli invii in 256-esimi di messaggio al secondo
+    uint32_t tassoInvio;
+    uint32_t tassoInvioMinimo;
+    uint32_t tassoInvioMassimo;
+    uint8_t caricoObiettivo;
+    uint32_t prossimoInvioConsentito;
+    // carico riportato nell'ultimo ACK (0 se l'ACK non lo conteneva)
+    uint8_t caricoRiportato = 0;
+    // gateway
+    bool segnalazioneCarico = false;
+    uint8_t caricoMisurato;
+    uint32_t tempoOccupatoUs;
+    uint32_t inizioFinestraCarico;
+
+
+    // ### Broadcast e multicast ###
+
+    // Collega allo stato la memoria dei messaggi inviati (cfr. MemoriaMulticast)
+    void impostaMemoriaMulticast(uint8_t* dati, uint8_t* lunghezze, uint8_t* gruppi, uint8_t* sequenze,
+                                 uint8_t* titoli, uint32_t* ultimaRitrasmissione,
+                                 uint8_t lunghezzaMax, uint8_t nrMessaggi);
+    // Chiamata da controlla() dopo lo scaricamento: converte un messaggio
+    // multicast o broadcast in un messaggio normale (o lo scarta)
+    void esaminaMessaggioMulticast();
+    // Chiamate da gestisciServizio()
+    void riceviStatoMulticast();
+    void riceviNackMulticast();
+    // Chiamata da controlla(): NACK, ritrasmissioni e annunci dell'ultimo messaggio
+    void controllaMulticast();
+    // Multicast attivo e radio nel gruppo
+    bool inGruppo(uint8_t gruppo);
+    // Segna come mancanti i messaggi da prossimaSequenza a `nuovaProssima` escluso
+    void avanzaSequenzaMulticast(uint8_t gruppo, uint8_t nuovaProssima);
+    // Invia l'intestazione multicast seguita da un messaggio
+    int inviaMessaggioMulticast(uint8_t gruppo, uint8_t sequenza, uint8_t titolo,
+                                const uint8_t messaggio[], uint8_t lunghezza);
+
+    // Ricevente: stato della numerazione di ogni gruppo
+    struct GruppoMulticast {
+        // numero successivo all'ultimo messaggio noto
+        uint8_t prossimaSequenza;
+        // bit i: manca il messaggio prossimaSequenza - 1 - i
+        uint32_t mancanti;
+        uint32_t prossimoNack;
+        uint8_t tentativiNack;
+        bool sequenzaNota;
+    };
+    // Stato fornito dall'utente (nullptr: multicast non attivo, cfr. StatoMulticast)
+    StatoMulticast* multicast = nullptr;
+
+    static constexpr uint8_t gruppoBroadcast = 255;
+    static constexpr uint8_t byteIntestazioneMulticast = 4;
+
+
+    // ### Ascolto a basso consumo ###
+
+    // Chiamata da gestisciServizio() alla ricezione di un messaggio di risveglio
+    void riceviRisveglio();
+    // Imposta il timeout di ricezione usato in listen dopo un segnale
+    void impostaTimeoutListen();
+    // Coefficiente e risoluzione dei registri di listen per una durata
+    static bool coefficienteListen(uint32_t durataUs, uint8_t& coefficiente, uint8_t& risoluzione);
+    static uint32_t risoluzioneListenUs(uint8_t risoluzione);
+
+    uint32_t durataIdleListenUs;
+    uint32_t durataRxListenUs;
+    uint16_t finestraRisveglio = 200;
+    bool risveglioAttivo = false;
+    // ultimo risveglio ricevuto o inviato (millis)
+    uint32_t tempoRisveglio = 0;
+
+    // statistiche per energiaPerMessaggioRicevuto() (ms)
+    uint32_t tempoInRx;
+    uint32_t tempoInListen;
+    uint32_t inizioModalitaAttuale;
+
+    // Bytes trasmessi prima della lunghezza (preambolo e sync word) e CRC,
+    // dal file di impostazione (cfr. `tempoInAria()`). I primi cambiano con
+    // i profili radio.
+    uint16_t byteSincronizzazione;
+    const uint8_t byteCrc;
+    // la codifica Manchester raddoppia i bit trasmessi dopo la sync word
+    const bool codificaManchester;
+
+
     // totale di messaggi inviati dall'ultima inizializzazione
     uint16_t messaggiInviati;
     // totale di messaggi ricevuti dall'ultima inizializzazione
     uint16_t messaggiRicevuti;
+    // messaggi con CRC errato riparati dalla FEC
+    uint16_t messaggiCorretti;
+    // messaggi con CRC errato che la FEC non è riuscita a riparare
+    uint16_t messaggiIrrecuperabili;
+    // messaggi scartati perché la coda di ricezione era piena
+    uint16_t messaggiScartatiCodaPiena;
+    // messaggi scartati dal filtro dei titoli
+    uint16_t messaggiFiltrati;
 
     // Numero di ACK ricevuti mentre `attesaAck == false`
     uint16_t ackInattesi = 0;
     // Numero di trasmissioni fallite per timeout
     uint16_t trasmissioniFalliteTimeout = 0;
 
+    // # Latenza di avvio delle trasmissioni #
+    // "ora" (us) della chiamata a inviaMessaggio() e durata prevista della
+    // trasmissione; l'ISR registra la latenza in corrispondenza di PacketSent
+    uint32_t inizioInvioUs;
+    uint32_t tempoInAriaUltimoInvio;
+    // la trasmissione in corso è iniziata dalla modalità FS
+    bool invioDaFS;
+    // istogramma [da standby / da FS][classe]
+    volatile uint16_t latenzaTx[2][nrClassiLatenzaTx];
+    // Chiamata dall'ISR alla fine di una trasmissione
+    void registraLatenzaTx();
+
 
     // ### Comunicazione con la radio ###
 
@@ -1150,6 +3485,9 @@ private:
 
         // leggi una sequenza di len bytes a partire da addr0 e salvali in data
         virtual void leggiSequenza(uint8_t addr0, uint8_t len, uint8_t* data) = 0;
+        // scrivi len bytes in registri adiacenti a partire da addr0 (nella
+        // FIFO se addr0 è 0) con una sola comunicazione
+        virtual void scriviSequenza(uint8_t addr0, uint8_t len, const uint8_t* data) = 0;
 
     };
 
@@ -1187,6 +3525,7 @@ private:
         void scriviRegistro(uint8_t addr, uint8_t val) override;
 
         void leggiSequenza(uint8_t addr0, uint8_t len, uint8_t* data) override;
+        void scriviSequenza(uint8_t addr0, uint8_t len, const uint8_t* data) override;
 
 
     private:
@@ -1224,6 +3563,7 @@ private:
         void scriviRegistro(uint8_t addr, uint8_t val) override;
 
         void leggiSequenza(uint8_t addr0, uint8_t len, uint8_t* data) override;
+        void scriviSequenza(uint8_t addr0, uint8_t len, const uint8_t* data) override;
 
     private:
 
@@ -1233,7 +3573,7 @@ private:
         //  nrAltriByte: numero di byte da inviare oltre ai primi due.
         //  altriByte: il resto dei byte da inviare. Niente per inviare zeri.
         void sc18_inviaDati(uint8_t byte1, uint8_t byte2, uint8_t nrAltriByte,
-                            uint8_t* altriByte = nullptr);
+                            const uint8_t* altriByte = nullptr);
         void sc18_richiediDati(uint8_t dataLen, uint8_t * data);
 
         // indirizzo I2C di SC18IS602B
@@ -1244,10 +3584,281 @@ private:
     };
 
     // Istanza della classe che gestisce la comunicazione con il chip
-    // (allocata dinamicamente nel constructor)
+    // (costruita in memoriaBus da creaInterfacciaSpi() o
+    // creaInterfacciaSC18IS602B(), oppure allocata dinamicamente dall'utente)
     Bus* bus;
 
+    // Memoria statica per l'interfaccia creata dalle funzioni "creaInterfaccia".
+    // Ne basta una perché la classe può gestire una sola radio.
+    static constexpr uint8_t dimensioneMemoriaBus =
+        sizeof(Spi) > sizeof(SC18IS602B) ? sizeof(Spi) : sizeof(SC18IS602B);
+    alignas(Spi) alignas(SC18IS602B) static uint8_t memoriaBus[dimensioneMemoriaBus];
+    // Bytes di memoriaBus occupati dall'interfaccia di questa radio
+    uint8_t memoriaBusOccupata() {return (void*)bus == (void*)memoriaBus ? dimensioneMemoriaBus : 0;}
+
+
+};
+
+
+
+// Definizione della memoria statica per la coda di ricezione (dichiarata nella
+// classe, dove InfoMessaggio non è ancora definita)
+template<uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda, uint8_t byteParitaFEC>
+class RFM69::Memoria {
+
+    static_assert(nrMessaggiInCoda >= 1 && nrMessaggiInCoda <= maxMessaggiInCoda,
+                  "RFM69::Memoria: numero di messaggi in coda non valido");
+    static_assert(lunghezzaMaxMessaggio >= 1 && lunghezzaMaxMessaggio + byteParitaFEC <= 64,
+                  "RFM69::Memoria: lunghezza massima dei messaggi non valida");
+    static_assert(byteParitaFEC % 2 == 0 && byteParitaFEC <= 16,
+                  "RFM69::Memoria: numero di byte di parità non valido");
+
+    friend class RFM69;
+
+    static constexpr uint8_t nrPosizioni = nrMessaggiInCoda + 1;
+    // con la FEC ogni posizione contiene l'intera parola di codice
+    static constexpr uint8_t lunghezzaPosizione =
+        lunghezzaMaxMessaggio + (byteParitaFEC ? 1 + byteParitaFEC : 0);
+
+    uint8_t dati[nrPosizioni * lunghezzaPosizione];
+    InfoMessaggio info[nrPosizioni];
+
+public:
+    //! Bytes di RAM occupati dalla coda di ricezione
+    static constexpr uint16_t byteOccupati = sizeof(dati) + sizeof(info);
+};
+
+
+
+// Definizione della configurazione verificata in fase di compilazione
+template<uint32_t bitRate, uint32_t freqDev, uint32_t frequenza, uint8_t tolleranzaPpm>
+class RFM69::Configurazione {
+
+    static_assert(bitRate >= 1200 && bitRate <= 300000,
+                  "RFM69::Configurazione: la bit rate FSK deve essere compresa tra 1'200 e 300'000");
+    static_assert(freqDev >= 600,
+                  "RFM69::Configurazione: la Frequency Deviation deve essere almeno 600 Hz");
+    static_assert(freqDev + bitRate / 2 <= 500000,
+                  "RFM69::Configurazione: freqDev + bitRate/2 deve essere al massimo 500 kHz");
+    static_assert(4 * freqDev >= bitRate && freqDev <= 5 * bitRate,
+                  "RFM69::Configurazione: l'indice di modulazione 2*freqDev/bitRate deve essere compreso tra 0.5 e 10");
+    static_assert(frequenza >= 290000000UL && frequenza <= 1020000000UL,
+                  "RFM69::Configurazione: frequenza fuori dalla banda della radio");
+
+public:
+    //! Banda occupata dal segnale più l'errore dei quarzi delle due radio
+    //! (cfr. `bandaNecessariaFSK()`)
+    static constexpr uint32_t bandaNecessaria =
+        RFM69::bandaNecessariaFSK(bitRate, freqDev, frequenza, tolleranzaPpm);
+
+    //! Valore dei registri BitRate (0x03, 0x04)
+    static constexpr uint16_t valBitRate = RFM69::valoreBitRate(bitRate);
+    //! Valore dei registri Fdev (0x05, 0x06)
+    static constexpr uint16_t valFreqDev = RFM69::valoreFreqDev(freqDev);
+    //! RxBwMant e RxBwExp del registro RxBw (0x19), senza DCC
+    static constexpr uint8_t valRxBw = RFM69::valoreRxBw(bandaNecessaria);
+
+    static_assert(valRxBw != 0xFF,
+                  "RFM69::Configurazione: nessun channel filter è abbastanza largo per il segnale");
+
+    //! Vero se il channel filter con il valore `valore` di RxBwMant e
+    //! RxBwExp contiene `bandaNecessaria`
+    static constexpr bool filtroSufficiente(uint8_t valore) {
+        return RFM69::bandaValoreRxBw(valore) >= bandaNecessaria;
+    }
+};
 
+
+
+// Definizione della memoria statica per la coda dei messaggi da inviare (TDMA)
+template<uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggi>
+class RFM69::MemoriaInvio {
+
+    static_assert(nrMessaggi >= 1, "RFM69::MemoriaInvio: la coda deve contenere almeno un messaggio");
+    static_assert(lunghezzaMaxMessaggio >= 1 && lunghezzaMaxMessaggio <= 64,
+                  "RFM69::MemoriaInvio: lunghezza massima dei messaggi non valida");
+
+    friend class RFM69;
+
+    uint8_t dati[nrMessaggi * lunghezzaMaxMessaggio];
+    uint8_t lunghezze[nrMessaggi];
+    uint8_t intestazioni[nrMessaggi];
+
+public:
+    //! Bytes di RAM occupati dalla coda
+    static constexpr uint16_t byteOccupati = sizeof(dati) + sizeof(lunghezze) + sizeof(intestazioni);
+};
+
+
+
+// Definizione della memoria statica per la tabella dei canali (salto di frequenza)
+template<uint8_t nrCanali>
+class RFM69::MemoriaFHSS {
+
+    static_assert(nrCanali >= 2 && nrCanali <= 64, "RFM69::MemoriaFHSS: numero di canali non valido");
+
+    friend class RFM69;
+
+    uint8_t frf[3 * nrCanali];
+    uint8_t sequenza[nrCanali];
+
+public:
+    //! Bytes di RAM occupati dalla tabella
+    static constexpr uint16_t byteOccupati = sizeof(frf) + sizeof(sequenza);
+};
+
+
+
+
+// Definizione della memoria statica per tabelle e code del mesh
+template<uint8_t nrNodi, uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggi>
+class RFM69::MemoriaMesh {
+
+    static_assert(nrNodi >= 1 && nrNodi <= 254, "RFM69::MemoriaMesh: numero di nodi non valido");
+    static_assert(nrMessaggi >= 1, "RFM69::MemoriaMesh: le code devono contenere almeno un messaggio");
+    static_assert(lunghezzaMaxMessaggio >= 1 && lunghezzaMaxMessaggio + byteIntestazioneMesh <= 64,
+                  "RFM69::MemoriaMesh: lunghezza massima dei messaggi non valida");
+
+    friend class RFM69;
+
+    // ogni voce delle code contiene anche origine, destinazione, salti e titolo
+    static constexpr uint8_t lunghezzaVoce = lunghezzaMaxMessaggio + 4;
+
+    VicinoMesh vicini[nrNodi];
+    RottaMesh rotte[nrNodi];
+    uint8_t datiLocali[nrMessaggi * lunghezzaVoce];
+    uint8_t lunghezzeLocali[nrMessaggi];
+    uint8_t intestazioniLocali[nrMessaggi];
+    uint8_t datiInoltro[nrMessaggi * lunghezzaVoce];
+    uint8_t lunghezzeInoltro[nrMessaggi];
+    uint8_t intestazioniInoltro[nrMessaggi];
+    uint8_t annuncio[lunghezzaMaxMessaggio + byteIntestazioneMesh];
+    StatoMesh stato;
+
+public:
+    //! Bytes di RAM occupati da tabelle, code, annuncio delle rotte e stato
+    static constexpr uint16_t byteOccupati = sizeof(vicini) + sizeof(rotte)
+        + 2 * (sizeof(datiLocali) + sizeof(lunghezzeLocali) + sizeof(intestazioniLocali))
+        + sizeof(annuncio) + sizeof(stato);
+};
+
+
+
+
+// Definizione della tabella delle funzioni di gestione dei messaggi
+class RFM69::TabellaRicezione {
+
+    friend class RFM69;
+
+    CollegamentoRicezione collegamenti[maxFunzioniRicezione];
+    uint8_t nrCollegamenti;
+    FunzioneRicezione funzioneDefault;
+    // copia del messaggio passato alla funzione di gestione (una posizione
+    // della coda non supera mai la FIFO della radio)
+    uint8_t copia[64];
+};
+
+
+
+
+// Definizione dello stato della sincronizzazione del tempo
+class RFM69::StatoSincronizzazione {
+
+    friend class RFM69;
+
+    RuoloSincronizzazione ruolo;
+
+    // Tabella circolare dei punti della regressione
+    PuntoSincronizzazione punti[nrPuntiSincronizzazione];
+    uint8_t nrPuntiRegistrati;
+    uint8_t prossimoPunto;
+
+    // Risultato della regressione:
+    // globale = locale + scartoRiferimento + deriva * (locale - localeRiferimento)
+    uint32_t localeRiferimento;
+    int32_t scartoRiferimento;
+    float deriva;
+
+    // Radice: numero del prossimo beacon e "ora" di invio del precedente
+    uint8_t numeroBeacon;
+    uint32_t tempoInvioBeaconPrecedente;
+    bool beaconPrecedenteInviato;
+    uint16_t intervalloBeacon;
+    uint32_t tempoUltimoBeacon;
+    // Nodo: numero e "ora" di ricezione (locale) dell'ultimo beacon ricevuto
+    uint8_t numeroUltimoBeacon;
+    uint32_t ricezioneUltimoBeacon;
+    bool ricevutoBeacon;
+};
+
+
+
+
+// Definizione dello stato dei gruppi multicast
+class RFM69::StatoMulticast {
+
+    friend class RFM69;
+
+    // Ricevente: numerazione di ogni gruppo
+    GruppoMulticast gruppi[nrGruppiMulticast];
+    // bit n: la radio fa parte del gruppo n
+    uint8_t gruppiAttivi;
+    uint16_t finestraNackMs;
+
+    // Mittente: memoria dei messaggi inviati (cfr. MemoriaMulticast, nullptr
+    // se non c'è)
+    uint8_t* dati;
+    uint8_t* lunghezze;
+    uint8_t* gruppiInviati;
+    uint8_t* sequenze;
+    uint8_t* titoli;
+    uint32_t* ultimaRitrasmissione;
+    uint8_t lunghezzaMax;
+    uint8_t nrMessaggi;
+    uint8_t prossimaPosizione;
+    // bit n: la posizione n della memoria va ritrasmessa
+    uint32_t daRitrasmettere;
+    // per ogni gruppo: prossimo numero di sequenza e annunci dell'ultimo
+    // messaggio ancora da inviare
+    uint8_t sequenzaInvio[nrGruppiMulticast];
+    uint8_t annunci[nrGruppiMulticast];
+    uint32_t prossimoAnnuncio[nrGruppiMulticast];
+    // evita che le chiamate a controlla() durante un invio ne facciano un altro
+    bool invioInCorso;
+
+    // statistiche
+    uint16_t nackInviati;
+    uint16_t nackSoppressi;
+    uint16_t ritrasmissioni;
+    uint16_t messaggiPersi;
+};
+
+
+
+
+// Definizione della memoria statica per i messaggi multicast inviati
+template<uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggi>
+class RFM69::MemoriaMulticast {
+
+    static_assert(nrMessaggi >= 1 && nrMessaggi <= 32,
+                  "RFM69::MemoriaMulticast: numero di messaggi non valido");
+    static_assert(lunghezzaMaxMessaggio >= 1 && lunghezzaMaxMessaggio <= 60,
+                  "RFM69::MemoriaMulticast: lunghezza massima dei messaggi non valida");
+
+    friend class RFM69;
+
+    uint8_t dati[nrMessaggi * lunghezzaMaxMessaggio];
+    uint8_t lunghezze[nrMessaggi];
+    uint8_t gruppi[nrMessaggi];
+    uint8_t sequenze[nrMessaggi];
+    uint8_t titoli[nrMessaggi];
+    uint32_t ultimaRitrasmissione[nrMessaggi];
+    StatoMulticast stato;
+
+public:
+    //! Bytes di RAM occupati dalla memoria
+    static constexpr uint16_t byteOccupati = sizeof(dati) + sizeof(lunghezze) + sizeof(gruppi)
+        + sizeof(sequenze) + sizeof(titoli) + sizeof(ultimaRitrasmissione) + sizeof(stato);
 };
 
 
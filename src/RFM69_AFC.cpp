@@ -0,0 +1,147 @@
+/*! @file
+
+@brief Correzione della frequenza per ogni corrispondente
+
+1. Misura
+2. Correzione
+
+Con AfcAutoOn la radio esegue l'AFC all'inizio di ogni ricezione e il
+risultato resta nei registri AfcValue fino alla ricezione successiva (con
+AfcAutoclearOn ogni AFC riparte dalla frequenza scritta nei registri Frf).
+AfcValue è quindi l'errore residuo rispetto alla frequenza attuale, cioè
+nominale (compensata per la temperatura, cfr. RFM69_temperatura.cpp) più la
+correzione applicata durante la ricezione.
+
+Tutti i valori sono in unità di Fstep (61 Hz), come nei registri Frf e
+AfcValue.
+*/
+
+#include "RFM69.h"
+#include "RFM69_registri.h"
+
+#include <Arduino.h>
+#include <math.h>
+
+
+
+int RFM69::attivaCorrezioneFrequenza(int16_t correzioni[], uint8_t nrCorrispondenti, bool riferimento) {
+
+    if(nrCorrispondenti == 0) return Errore::correzioneFrequenzaNonValida;
+
+    if(!tabellaAFC) regAfcFeiPrecedente = bus->leggiRegistro(RFM69_1E_AFC_FEI);
+    // AfcAutoclearOn, AfcAutoOn
+    bus->scriviRegistro(RFM69_1E_AFC_FEI, (1 << 3) | (1 << 2));
+
+    for(uint8_t i = 0; i < nrCorrispondenti; i++) correzioni[i] = 0;
+    tabellaAFC = correzioni;
+    nrCorrispondentiAFC = nrCorrispondenti;
+    riferimentoAFC = riferimento;
+    if(corrispondenteAFC >= nrCorrispondenti) corrispondenteAFC = 0;
+    ultimoErroreFrequenza = 0;
+
+    return Errore::ok;
+}
+
+
+void RFM69::disattivaCorrezioneFrequenza() {
+    if(!tabellaAFC) return;
+    bus->scriviRegistro(RFM69_1E_AFC_FEI, regAfcFeiPrecedente);
+    tabellaAFC = nullptr;
+    nrCorrispondentiAFC = 0;
+    if(correzioneApplicata && stato == Stato::passivo) scriviFrequenza();
+}
+
+
+void RFM69::selezionaCorrispondente(uint8_t corrispondente) {
+    corrispondenteAFC = corrispondente;
+    if(tabellaAFC && stato == Stato::passivo) controllaCorrezioneFrequenza();
+}
+
+
+int32_t RFM69::erroreFrequenzaHz(uint8_t corrispondente) {
+    if(!tabellaAFC || corrispondente >= nrCorrispondentiAFC) return 0;
+    return hzDaFstep(tabellaAFC[corrispondente]);
+}
+
+
+float RFM69::guadagnoCorrezioneFrequenzaDb(uint32_t bitRate, uint32_t freqDev, uint32_t frequenza,
+                                           uint8_t tolleranzaPpm, uint8_t residuoPpm) {
+    uint8_t senza = indiceRxBw(bandaNecessariaFSK(bitRate, freqDev, frequenza, tolleranzaPpm));
+    uint8_t con = indiceRxBw(bandaNecessariaFSK(bitRate, freqDev, frequenza, residuoPpm));
+    if(con >= 24) return 0;
+    if(senza >= 24) return -1;
+    return 10 * log10((float)bandaRxBw(senza) / bandaRxBw(con));
+}
+
+
+
+// ### 1. Misura ### //
+
+
+uint8_t RFM69::corrispondenteAttuale() {
+
+    if(ruoloTDMA == RuoloTDMA::coordinatore) {
+        // il nodo dello slot attuale; nessuno nello slot del beacon
+        if(!superframeValido) return 0xFF;
+        uint32_t slot = (micros() - inizioSuperframe) / durataSlotUs;
+        if(slot == 0 || slot > nrSlotTDMA) return 0xFF;
+        return slot - 1;
+    }
+
+    return corrispondenteAFC;
+}
+
+
+void RFM69::registraErroreFrequenza() {
+
+    int16_t residuo = (int16_t)(((uint16_t)bus->leggiRegistro(RFM69_1F_AFC_MSB) << 8)
+                                | bus->leggiRegistro(RFM69_20_AFC_LSB));
+    ultimoErroreFrequenza = correzioneApplicata + residuo;
+
+    uint8_t c = corrispondenteAttuale();
+    if(c >= nrCorrispondentiAFC) return;
+
+    // Media esponenziale con peso 1/2: se anche l'altra radio corregge, le
+    // due correzioni si avvicinano a metà di ogni differenza e convergono
+    // senza oscillare
+    tabellaAFC[c] += (ultimoErroreFrequenza - tabellaAFC[c]) / 2;
+}
+
+
+
+// ### 2. Correzione ### //
+
+
+int16_t RFM69::correzioneDesiderata() {
+    if(!tabellaAFC || riferimentoAFC) return 0;
+    uint8_t c = corrispondenteAttuale();
+    return c < nrCorrispondentiAFC ? tabellaAFC[c] : 0;
+}
+
+
+// Chiamata da controlla() quando la radio è libera, come il salto di frequenza
+//
+void RFM69::controllaCorrezioneFrequenza() {
+    int16_t differenza = correzioneDesiderata() - correzioneApplicata;
+    if(differenza >= sogliaCorrezioneAFC || differenza <= -(int16_t)sogliaCorrezioneAFC) {
+        scriviFrequenza();
+    }
+}
+
+
+void RFM69::scriviFrequenza(bool tornaAModalitaDefault) {
+
+    correzioneApplicata = correzioneDesiderata();
+    uint32_t frf = frfNominale + correzioneTemperatura + correzioneApplicata;
+    uint8_t valori[3] = {(uint8_t)(frf >> 16), (uint8_t)(frf >> 8), (uint8_t)frf};
+
+    // la frequenza si cambia in standby, così il PLL si riaggancia
+    // all'ingresso nella modalità successiva
+    disattivaAutoModes();
+    cambiaModalita(Modalita::standby, true);
+    bus->scriviSequenza(RFM69_07_FRF_MSB, 3, valori);
+
+    if(!tornaAModalitaDefault) return;
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+}
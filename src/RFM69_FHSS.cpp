@@ -0,0 +1,117 @@
+/*! @file
+
+@brief Salto di frequenza (FHSS)
+
+1. Tabella dei canali
+2. Salti
+
+Tutte le radio calcolano la posizione nella sequenza dei canali dallo stesso
+orologio: il numero del superframe se il TDMA è attivo (il coordinatore lo
+scrive nel beacon), altrimenti il tempo globale della sincronizzazione. Una
+radio che non conosce l'orologio aspetta sul primo canale della sequenza
+("canale di partenza"), dove prima o poi riceve un beacon.
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Tabella dei canali ### //
+
+
+int RFM69::attivaFHSS(uint8_t* frf, uint8_t* sequenza, uint8_t nrCanali, uint32_t frequenzaBase,
+                      uint32_t spaziatura, uint16_t durataCanaleMs, uint8_t seme) {
+
+    uint32_t ultima = frequenzaBase + (uint32_t)(nrCanali - 1) * spaziatura;
+    if(nrCanali < 2 || spaziatura == 0 || durataCanaleMs == 0
+            || frequenzaBase < 290000000UL || ultima > 1020000000UL || ultima < frequenzaBase)
+        return Errore::fhssImpostazioneNonValida;
+
+    disattivaFHSS();
+
+    // La divisione per Fstep è fatta qui una volta per canale: un salto
+    // legge i tre bytes già pronti e li scrive in una sola sequenza
+    for(uint8_t i = 0; i < nrCanali; i++) {
+        uint32_t val = valoreFrequenza(frequenzaBase + (uint32_t)i * spaziatura);
+        frf[3 * i] = val >> 16;
+        frf[3 * i + 1] = val >> 8;
+        frf[3 * i + 2] = val;
+    }
+
+    // Permutazione di Fisher-Yates con un generatore xorshift a 16 bit, uguale
+    // su tutte le piattaforme (a differenza di random())
+    uint16_t x = 0xACE1 ^ seme;
+    for(uint8_t i = 0; i < nrCanali; i++) sequenza[i] = i;
+    for(uint8_t i = nrCanali - 1; i > 0; i--) {
+        x ^= x << 7;
+        x ^= x >> 9;
+        x ^= x << 8;
+        uint8_t j = x % (i + 1);
+        uint8_t t = sequenza[i];
+        sequenza[i] = sequenza[j];
+        sequenza[j] = t;
+    }
+
+    tabellaFHSS = frf;
+    sequenzaFHSS = sequenza;
+    nrCanaliFHSS = nrCanali;
+    durataCanaleFHSSUs = (uint32_t)durataCanaleMs * 1000;
+    saltiFHSS = 0;
+    // il primo salto avviene alla prossima chiamata a controlla()
+    canaleAttualeFHSS = 0xFF;
+
+    return Errore::ok;
+}
+
+
+void RFM69::disattivaFHSS() {
+    if(nrCanaliFHSS == 0) return;
+    // disattivato prima del cambio di canale, che richiama controlla()
+    nrCanaliFHSS = 0;
+    if(stato == Stato::passivo && canaleAttualeFHSS != sequenzaFHSS[0]) cambiaCanaleFHSS(sequenzaFHSS[0]);
+}
+
+
+
+// ### 2. Salti ### //
+
+
+uint8_t RFM69::posizioneFHSS() {
+
+    if(ruoloTDMA == RuoloTDMA::coordinatore) return indiceSuperframe % nrCanaliFHSS;
+
+    if(ruoloTDMA == RuoloTDMA::nodo) {
+        if(!superframeValido) return 0;
+        uint32_t periodo = durataSlotUs * (nrSlotTDMA + 1);
+        uint32_t superframe = (micros() - inizioSuperframe) / periodo;
+        if(superframe >= maxSuperframeSenzaBeacon) return 0;
+        // modulo 256 come il contatore del coordinatore
+        return (uint8_t)(indiceSuperframe + superframe) % nrCanaliFHSS;
+    }
+
+    if(sincronizzato()) return (tempoGlobaleUs() / durataCanaleFHSSUs) % nrCanaliFHSS;
+
+    return 0;
+}
+
+
+// Chiamata da controlla() quando la radio è libera: un messaggio e il suo ACK
+// restano sullo stesso canale anche se nel frattempo è scaduto
+//
+void RFM69::controllaFHSS() {
+    uint8_t canale = sequenzaFHSS[posizioneFHSS()];
+    if(canale != canaleAttualeFHSS) cambiaCanaleFHSS(canale);
+}
+
+
+void RFM69::cambiaCanaleFHSS(uint8_t canale) {
+
+    const uint8_t* frf = tabellaFHSS + 3 * canale;
+    frfNominale = ((uint32_t)frf[0] << 16) | ((uint32_t)frf[1] << 8) | frf[2];
+    canaleAttualeFHSS = canale;
+    ++saltiFHSS;
+
+    scriviFrequenza();
+}
@@ -130,8 +130,23 @@ void RFM69::SC18IS602B::leggiSequenza(uint8_t addr0, uint8_t len, uint8_t* data)
 
 
 
+// Scrive una sequenza di bytes adiacenti
+//
+void RFM69::SC18IS602B::scriviSequenza(uint8_t addr0, uint8_t len, const uint8_t* data) {
+    // Il buffer di Wire (32 bytes su AVR) contiene anche function ID e
+    // indirizzo: le sequenze più lunghe sono divise in più trasmissioni.
+    // L'indirizzo avanza con i dati tranne che per la FIFO.
+    const uint8_t maxBytes = 30;
+    for(uint8_t i = 0; i < len; i += maxBytes) {
+        uint8_t n = len - i < maxBytes ? len - i : maxBytes;
+        sc18_inviaDati(codiceCS, (addr0 ? addr0 + i : 0) | 0x80, n, data + i);
+    }
+}
+
+
+
 void RFM69::SC18IS602B::sc18_inviaDati(uint8_t byte1, uint8_t byte2,
-                            uint8_t nrAltriByte, uint8_t* altriByte) {
+                            uint8_t nrAltriByte, const uint8_t* altriByte) {
     
     Wire.beginTransmission(indirizzo); 
     Wire.write(byte1);
@@ -129,6 +129,19 @@ void RFM69::Spi::leggiSequenza(uint8_t addr0, uint8_t len, uint8_t* data) {
 }
 
 
+// Scrive una sequenza di bytes adiacenti (la radio incrementa l'indirizzo
+// da sola, tranne che per la FIFO)
+//
+void RFM69::Spi::scriviSequenza(uint8_t addr0, uint8_t len, const uint8_t* data) {
+    apriComunicazione();
+    trasferisciByte(addr0 | 0x80);
+    for(unsigned int i = 0; i < len; i++) {
+        trasferisciByte(data[i]);
+    }
+    chiudiComunicazione();
+}
+
+
 // Esegue una transizione SPI,c ioè invia un byte e ne riceve uno contemporaneamente
 //
 uint8_t RFM69::Spi::trasferisciByte(uint8_t byte) {
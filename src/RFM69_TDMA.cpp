@@ -0,0 +1,215 @@
+/*! @file
+
+@brief Accesso al canale a divisione di tempo (TDMA) per reti a stella
+
+1. Coordinatore
+2. Nodi
+
+Il superframe comincia alla fine della sync word del beacon del coordinatore,
+un istante che il coordinatore (a PacketSent) e i nodi (a PayloadReady)
+misurano allo stesso modo (cfr. `tempoUltimoInvioUs()` e `tempoRicezioneUs()`).
+Per questo i nodi non hanno bisogno della sincronizzazione del tempo di
+RFM69_sincronizzazione.cpp: ogni beacon riallinea il loro orologio.
+
+Superframe con n nodi:
+    | beacon | nodo 1 | nodo 2 | ... | nodo n |
+Ogni slot:
+    | guardia | messaggio + ACK | guardia |
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+void RFM69::disattivaTDMA() {
+    ruoloTDMA = RuoloTDMA::nessuno;
+    codaInvio.svuota();
+    superframeValido = false;
+    durataSlotUs = 0;
+    slotTDMA = 0;
+    tentativiTDMA = 0;
+    indiceSuperframe = 0;
+}
+
+
+bool RFM69::sincronizzatoTDMA() {
+    if(ruoloTDMA == RuoloTDMA::coordinatore) return true;
+    if(ruoloTDMA != RuoloTDMA::nodo || !superframeValido || !slotTDMA) return false;
+    uint32_t periodo = durataSlotUs * (nrSlotTDMA + 1);
+    return (micros() - inizioSuperframe) / periodo < maxSuperframeSenzaBeacon;
+}
+
+
+// Chiamata alla fine di controlla() quando la radio è libera
+//
+void RFM69::controllaTDMA() {
+
+    if(ruoloTDMA == RuoloTDMA::nodo) {
+        inviaDaCodaTDMA();
+        return;
+    }
+
+    // Coordinatore: un beacon all'inizio di ogni superframe
+    uint32_t periodo = durataSlotUs * (nrSlotTDMA + 1);
+    if(superframeValido && micros() - inizioSuperframe < periodo) return;
+
+    // evita che le chiamate a controlla() durante l'invio (e il salto di
+    // frequenza) ripetano il beacon
+    inizioSuperframe = micros();
+    superframeValido = true;
+
+    // il nuovo superframe è sul canale successivo della sequenza FHSS
+    ++indiceSuperframe;
+    if(nrCanaliFHSS) controllaFHSS();
+
+    // gli id dei nodi sono inviati direttamente dalla tabella dell'utente
+    uint8_t beacon[8];
+    beacon[0] = (uint8_t)Servizio::superframe;
+    beacon[1] = nrSlotTDMA;
+    beacon[2] = durataSlotUs >> 4;
+    beacon[3] = durataSlotUs >> 12;
+    beacon[4] = guardiaUs >> 4;
+    beacon[5] = guardiaUs >> 12;
+    beacon[6] = lunghezzaMaxTDMA;
+    beacon[7] = indiceSuperframe;
+
+    if(inviaServizio(beacon, 8, nodiTDMA, nrSlotTDMA, false) != Errore::ok) return;
+    // il superframe comincia alla fine della sync word, nota solo a PacketSent
+    if(radioPronta(true)) inizioSuperframe = tempoUltimoInvioUs();
+}
+
+
+
+// ### 1. Coordinatore ### //
+
+
+int RFM69::attivaTDMACoordinatore(const uint8_t nodi[], uint8_t nrNodi,
+                                  uint8_t lunghezzaMaxMessaggio, uint16_t tempoRispostaAckUs) {
+
+    // il beacon deve entrare in un pacchetto (8 bytes di parametri e un id per nodo)
+    if(nrNodi == 0 || 8 + nrNodi > 63 - byteParitaFEC) return Errore::tdmaImpostazioneNonValida;
+
+    // Messaggio con il suo ACK. La bit rate attuale deve restare la stessa per
+    // tutta la durata del TDMA (niente bit rate adattiva).
+    uint32_t messaggio = latenzaAvvioTxUs + tempoInAria(lunghezzaMaxMessaggio);
+    uint32_t ack = tempoRispostaAckUs + latenzaAvvioTxUs + tempoInAria(1);
+    uint32_t base = messaggio + ack;
+
+    // La guardia copre l'errore dei timestamp e la deriva accumulata nel caso
+    // peggiore, cioè quando un nodo ha perso gli ultimi beacon
+    uint32_t periodo = (nrNodi + 1) * base;
+    uint32_t guardia = erroreTempoTDMAUs
+        + (periodo / 1000) * maxSuperframeSenzaBeacon * derivaMassimaPpm / 1000;
+    uint32_t durata = base + 2 * guardia;
+
+    // durata e guardia sono inviate in unità di 16 us su due bytes
+    durata = (durata + 15) & ~15UL;
+    guardia = (guardia + 15) & ~15UL;
+    if(durata >= 65536UL * 16) return Errore::tdmaImpostazioneNonValida;
+
+    disattivaTDMA();
+    nodiTDMA = nodi;
+    nrSlotTDMA = nrNodi;
+    lunghezzaMaxTDMA = lunghezzaMaxMessaggio;
+    durataSlotUs = durata;
+    guardiaUs = guardia;
+    ruoloTDMA = RuoloTDMA::coordinatore;
+
+    return Errore::ok;
+}
+
+
+
+// ### 2. Nodi ### //
+
+
+void RFM69::attivaTDMA(uint8_t idNodo, uint8_t* dati, uint8_t* lunghezze,
+                       uint8_t* intestazioni, uint8_t lunghezzaMax, uint8_t nrMessaggi) {
+    disattivaTDMA();
+    codaInvio.init(dati, lunghezze, intestazioni, lunghezzaMax, nrMessaggi);
+    idNodoTDMA = idNodo;
+    ruoloTDMA = RuoloTDMA::nodo;
+}
+
+
+int RFM69::accodaInvio(const uint8_t messaggio[], uint8_t lunghezza, uint8_t intestazione) {
+    if(lunghezza == 0) return Errore::inviaMessaggioVuoto;
+    if(!codaInvio.aggiungi(messaggio, lunghezza, intestazione)) return Errore::inviaCodaPiena;
+    return Errore::ok;
+}
+
+
+// Legge i parametri del superframe e cerca il proprio slot
+//
+void RFM69::riceviBeaconTDMA() {
+
+    if(ruoloTDMA != RuoloTDMA::nodo) return;
+    if(ultimoMessaggio.dimensione < 8) return;
+    uint8_t nrSlot = buffer[1];
+    if(nrSlot == 0 || ultimoMessaggio.dimensione < 8 + nrSlot) return;
+
+    nrSlotTDMA = nrSlot;
+    durataSlotUs = (uint32_t)(buffer[2] | buffer[3] << 8) << 4;
+    guardiaUs = (uint32_t)(buffer[4] | buffer[5] << 8) << 4;
+    lunghezzaMaxTDMA = buffer[6];
+    indiceSuperframe = buffer[7];
+
+    slotTDMA = 0;
+    for(uint8_t i = 0; i < nrSlot; i++) {
+        if(buffer[8 + i] == idNodoTDMA) {
+            slotTDMA = i + 1;
+            break;
+        }
+    }
+
+    inizioSuperframe = ultimoMessaggio.tempoRicezioneUs;
+    superframeValido = true;
+    ultimoSuperframeUsato = 0xFF;
+}
+
+
+// Un messaggio per superframe, solo se può iniziare nella finestra di guardia
+// all'inizio dello slot (allungata se il messaggio è più corto del massimo)
+//
+void RFM69::inviaDaCodaTDMA() {
+
+    if(codaInvio.vuota() || !sincronizzatoTDMA()) return;
+
+    uint32_t periodo = durataSlotUs * (nrSlotTDMA + 1);
+    uint32_t trascorso = micros() - inizioSuperframe;
+    uint8_t superframe = trascorso / periodo;
+    if(superframe == ultimoSuperframeUsato) return;
+
+    uint8_t lunghezza = codaInvio.lunghezzaPrimo();
+    // un messaggio più lungo di quanto previsto dal coordinatore non entra nello slot
+    if(lunghezza > lunghezzaMaxTDMA) {
+        codaInvio.rimuoviPrimo();
+        ++messaggiPersiTDMA;
+        return;
+    }
+
+    uint32_t nelSuperframe = trascorso - superframe * periodo;
+    uint32_t inizio = slotTDMA * durataSlotUs + guardiaUs;
+    uint32_t ritardoMassimo = guardiaUs + tempoInAria(lunghezzaMaxTDMA) - tempoInAria(lunghezza);
+    if(nelSuperframe < inizio || nelSuperframe > inizio + ritardoMassimo) return;
+
+    // segnato prima dell'invio perché l'attesa dell'ACK richiama controlla()
+    ultimoSuperframeUsato = superframe;
+
+    Intestazione intestazione;
+    intestazione.byte = codaInvio.intestazionePrimo();
+    if(inviaMessaggio(codaInvio.primoMessaggio(), lunghezza, intestazione.byte) != Errore::ok) return;
+
+    if(intestazione.bit.richiestaAck) {
+        ++tentativiTDMA;
+        while(ackInSospeso());
+        if(!ricevutoAck()) {
+            if(tentativiTDMA < maxTentativiTDMA) return;
+            ++messaggiPersiTDMA;
+        }
+    }
+    codaInvio.rimuoviPrimo();
+    tentativiTDMA = 0;
+}
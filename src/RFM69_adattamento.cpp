@@ -0,0 +1,233 @@
+/*! @file
+
+@brief Adattamento delle impostazioni di trasmissione alla qualità del collegamento
+
+1. Bit rate adattiva
+2. Controllo della potenza di trasmissione
+
+La tabella dei profili e la funzione che li scrive nei registri sono in
+RFM69_inizializzazione.cpp, l'unico file che conosce il file di impostazione.
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Bit rate adattiva ### //
+
+// Entrambe le radio partono dal profilo di rendezvous. La radio che invia
+// messaggi con ACK raccoglie l'esito di `finestraAdattamento` ACK attesi e
+// decide se proporre un profilo più veloce (nessuna perdita e RSSI medio
+// abbastanza sopra la sensibilità del profilo successivo) o più lento (troppe
+// perdite o RSSI vicino alla sensibilità del profilo attuale). La proposta è un
+// messaggio di servizio con ACK: chi la riceve cambia profilo dopo aver inviato
+// l'ACK, chi la invia dopo averlo ricevuto.
+// Se l'ACK della proposta si perde le due radio restano su profili diversi;
+// in quel caso entrambe tornano al profilo di rendezvous, la prima dopo
+// `maxPerditeConsecutive` ACK persi, l'altra dopo `timeoutRendezvous` ms senza
+// messaggi.
+
+
+void RFM69::attivaBitRateAdattiva(uint16_t timeout) {
+    bitRateAdattiva = true;
+    timeoutRendezvous = timeout;
+    azzeraFinestraAdattamento();
+    perditeConsecutive = 0;
+    tempoUltimoMessaggio = millis();
+    profiloDaProporre = nessunProfilo;
+    // comincia dal profilo di rendezvous, sul quale si trova anche l'altra radio
+    if(profiloModem != profiloRendezvous) {
+        profiloDaApplicare = profiloRendezvous;
+        richiestaModalitaDefaultAppenaPossibile = true;
+    }
+    controlla();
+}
+
+
+void RFM69::disattivaBitRateAdattiva() {
+    bitRateAdattiva = false;
+    profiloDaProporre = nessunProfilo;
+}
+
+
+void RFM69::azzeraFinestraAdattamento() {
+    esitiFinestra = 0;
+    perditeFinestra = 0;
+    sommaRssiFinestra = 0;
+}
+
+
+// Chiamata da controlla() ogni volta che un ACK atteso arriva o non arriva
+//
+void RFM69::registraEsitoAck(bool ricevuto) {
+
+    // stima del collegamento (i messaggi mesh aggiornano quella del vicino)
+    if(tabellaCollegamenti && !(mesh && mesh->invioInCorso)) registraInvioCollegamento(ricevuto);
+
+    // gli ACK delle proposte non contano: il loro esito è gestito da negoziaProfilo()
+    if(negoziazioneInCorso) return;
+
+    if(controlloCongestione) aggiornaCongestione(ricevuto);
+
+    // RSSI con cui l'altra radio avrebbe ricevuto il messaggio alla potenza
+    // massima: la scelta della bit rate non deve dipendere da quella della
+    // potenza, che a sua volta cerca la potenza minima per la bit rate in uso
+    int8_t rssiPotenzaMassima = rssiRiportato + (potenzaMassimaTx - potenzaTx);
+
+    if(controlloPotenza) {
+        if(ricevuto) regolaPotenza();
+        else if(potenzaTx < potenzaMassimaTx) {
+            int8_t nuova = potenzaTx + aumentoPotenzaPerdita;
+            scriviPotenzaTx(nuova < potenzaMassimaTx ? nuova : potenzaMassimaTx);
+        }
+    }
+
+    if(!bitRateAdattiva) return;
+
+    ++esitiFinestra;
+    if(ricevuto) {
+        perditeConsecutive = 0;
+        sommaRssiFinestra += rssiPotenzaMassima;
+    }
+    else {
+        ++perditeFinestra;
+        ++perditeConsecutive;
+    }
+
+    // Collegamento perso: torna subito al rendezvous (sarà applicato al ritorno
+    // in modalità default, che segue sempre la fine dell'attesa di un ACK)
+    if(perditeConsecutive >= maxPerditeConsecutive) {
+        perditeConsecutive = 0;
+        azzeraFinestraAdattamento();
+        profiloDaProporre = nessunProfilo;
+        if(profiloModem != profiloRendezvous) profiloDaApplicare = profiloRendezvous;
+        return;
+    }
+
+    if(esitiFinestra < finestraAdattamento) return;
+
+    uint8_t ricevuti = esitiFinestra - perditeFinestra;
+    int16_t rssiMedio = ricevuti ? sommaRssiFinestra / ricevuti : -127;
+    // con il profilo impostato dall'utente si parte dal rendezvous
+    uint8_t attuale = profiloModem == nessunProfilo ? profiloRendezvous : profiloModem;
+
+    if(perditeFinestra > maxPerditeFinestra || rssiMedio < rssiMinimoProfilo(attuale) + margineRssi / 2) {
+        if(attuale > 0) profiloDaProporre = attuale - 1;
+    }
+    else if(perditeFinestra == 0 && attuale + 1 < nrProfiliModem
+            && rssiMedio > rssiMinimoProfilo(attuale + 1) + margineRssi) {
+        profiloDaProporre = attuale + 1;
+    }
+
+    azzeraFinestraAdattamento();
+}
+
+
+// Invia la proposta e aspetta l'ACK. Chiamata da controlla() quando la radio è
+// libera; l'attesa dura al massimo `timeoutAck` ms.
+//
+void RFM69::negoziaProfilo() {
+
+    uint8_t proposta[2] = {(uint8_t)Servizio::cambioProfilo, profiloDaProporre};
+    profiloDaProporre = nessunProfilo;
+
+    negoziazioneInCorso = true;
+    // l'utente potrebbe non aver ancora controllato l'esito del suo ultimo ACK
+    StatoAck statoAckUtente = statoUltimoAck;
+
+    if(inviaServizio(proposta, 2, true) == Errore::ok) {
+        while(ackInSospeso());
+        if(ricevutoAck()) {
+            profiloDaApplicare = proposta[1];
+            richiestaModalitaDefaultAppenaPossibile = true;
+        }
+    }
+
+    statoUltimoAck = statoAckUtente;
+    negoziazioneInCorso = false;
+}
+
+
+// Senza messaggi dall'altra radio per troppo tempo il collegamento è
+// probabilmente perso (ad es. l'ACK di una proposta non è arrivato)
+//
+void RFM69::controllaRendezvous() {
+    if(profiloModem == profiloRendezvous || profiloDaApplicare != nessunProfilo) return;
+    if(millis() - tempoUltimoMessaggio > timeoutRendezvous) {
+        profiloDaApplicare = profiloRendezvous;
+        profiloDaProporre = nessunProfilo;
+        azzeraFinestraAdattamento();
+        richiestaModalitaDefaultAppenaPossibile = true;
+    }
+}
+
+
+
+// ### 2. Controllo della potenza di trasmissione ### //
+
+// La potenza segue l'RSSI riportato negli ACK: sale subito di quanto manca per
+// tornare al margine desiderato, scende invece solo della metà dell'eccesso per
+// non oscillare. Quando la potenza scende sotto i 18 dBm anche i registri high
+// power sono ripristinati (cfr. scriviPotenzaTx()).
+
+
+void RFM69::attivaControlloPotenza(uint8_t margine) {
+    controlloPotenza = true;
+    marginePotenza = margine;
+}
+
+
+void RFM69::disattivaControlloPotenza() {
+    controlloPotenza = false;
+    scriviPotenzaTx(potenzaMassimaTx);
+}
+
+
+void RFM69::regolaPotenza() {
+
+    int16_t errore = rssiRiportato - (sensibilitaStimata() + marginePotenza);
+    int16_t nuova = potenzaTx;
+
+    if(errore < -(int16_t)isteresiPotenza) nuova = potenzaTx - errore;
+    else if(errore > (int16_t)isteresiPotenza) nuova = potenzaTx - errore / 2;
+
+    if(nuova > potenzaMassimaTx) nuova = potenzaMassimaTx;
+    if(nuova < potenzaMinimaTx) nuova = potenzaMinimaTx;
+
+    if(nuova != potenzaTx) scriviPotenzaTx(nuova);
+}
+
+
+// Durata della trasmissione di un messaggio (us)
+//
+uint32_t RFM69::tempoInAria(uint8_t lunghezza) {
+    return durataDopoSincronizzazione(lunghezza)
+        + byteSincronizzazione * 8 * 1000000UL / bitRateCorrente;
+}
+
+
+uint32_t RFM69::durataDopoSincronizzazione(uint8_t lunghezza) {
+    // lunghezza, intestazione, contenuto, parità e CRC
+    uint32_t bit = (2 + lunghezza + byteParitaFEC + byteCrc) * 8;
+    if(codificaManchester) bit *= 2;
+    return bit * 1000000UL / bitRateCorrente;
+}
+
+
+// Energia spesa per trasmettere un pacchetto (uJ), dalla corrente assorbita in
+// trasmissione (datasheet di RFM69HCW: 130 mA a +20 dBm, 95 mA a +17, 45 mA a
+// +13, 33 mA a +10, circa 20 mA a 0 dBm; interpolata linearmente) con
+// un'alimentazione a 3.3V
+//
+uint32_t RFM69::energiaTrasmissione(uint8_t lunghezza) {
+    int16_t correnteMa;
+    if(potenzaTx > 17)      correnteMa = 95 + (potenzaTx - 17) * 12;
+    else if(potenzaTx > 13) correnteMa = 45 + (potenzaTx - 13) * 12;
+    else if(potenzaTx > 10) correnteMa = 33 + (potenzaTx - 10) * 4;
+    else                    correnteMa = 20 + (potenzaTx * 13) / 10;
+    if(correnteMa < 16) correnteMa = 16;
+    // mA * V * us = nJ
+    return (uint32_t)correnteMa * 33 * tempoInAria(lunghezza) / 10000;
+}
@@ -0,0 +1,159 @@
+/*! @file
+
+@brief Ascolto a basso consumo (modalità listen) e risveglio delle radio
+
+1. Impostazione
+2. Risveglio
+3. Statistiche
+
+In listen la radio si sveglia da sola all'inizio di ogni finestra di
+ricezione e, se sente un segnale sopra la soglia RSSI, resta in ricezione fino
+a PayloadReady o al timeout impostato da impostaTimeoutListen(). Dopo un
+messaggio la radio torna subito nella pausa (LISTEN_END_CONTINUE): il
+contenuto della FIFO resta disponibile solo fino alla finestra successiva.
+*/
+
+#include "RFM69.h"
+#include "RFM69_registri.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Impostazione ### //
+
+
+// Durata di un'unità per ciascun valore di ListenResol (datasheet, RegListen1)
+//
+uint32_t RFM69::risoluzioneListenUs(uint8_t risoluzione) {
+    switch(risoluzione) {
+        case 1: return 64;
+        case 2: return 4100;
+        case 3: return 262000;
+        default: return 0;
+    }
+}
+
+
+// Sceglie la risoluzione più fine con cui la durata è rappresentabile
+//
+bool RFM69::coefficienteListen(uint32_t durataUs, uint8_t& coefficiente, uint8_t& risoluzione) {
+    for(uint8_t r = 1; r <= 3; r++) {
+        uint32_t unita = risoluzioneListenUs(r);
+        uint32_t c = (durataUs + unita / 2) / unita;
+        if(c >= 1 && c <= 255) {
+            coefficiente = c;
+            risoluzione = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+int RFM69::impostaListen(uint32_t durataIdleUs, uint32_t durataRxUs) {
+
+    uint8_t coefIdle, resolIdle, coefRx, resolRx;
+    if(durataRxUs < durataMinimaRxListenUs
+            || !coefficienteListen(durataIdleUs, coefIdle, resolIdle)
+            || !coefficienteListen(durataRxUs, coefRx, resolRx)) {
+        return Errore::listenImpostazioneNonValida;
+    }
+
+    // i registri di listen si scrivono fuori dalla modalità listen
+    bool inListen = modalita == Modalita::listen;
+    if(inListen) cambiaModalita(Modalita::standby, true);
+
+    // ListenCriteria e ListenEnd (bit 3 - 1) restano quelli del file di impostazione
+    uint8_t regListen1 = bus->leggiRegistro(RFM69_0D_LISTEN_1) & 0x0F;
+    bus->scriviRegistro(RFM69_0D_LISTEN_1, regListen1 | (resolIdle << 6) | (resolRx << 4));
+    bus->scriviRegistro(RFM69_0E_LISTEN_2, coefIdle);
+    bus->scriviRegistro(RFM69_0F_LISTEN_3, coefRx);
+
+    durataIdleListenUs = coefIdle * risoluzioneListenUs(resolIdle);
+    durataRxListenUs = coefRx * risoluzioneListenUs(resolRx);
+
+    if(inListen) cambiaModalita(Modalita::listen, false);
+
+    return Errore::ok;
+}
+
+
+// Senza timeout un disturbo sopra la soglia RSSI terrebbe la radio in
+// ricezione per sempre. Il timeout copre la fine di un messaggio di risveglio
+// iniziato prima della finestra, l'intervallo prima del successivo e tutto il
+// successivo. Chiamata a ogni attivazione di listen perché dipende dalla bit rate.
+//
+void RFM69::impostaTimeoutListen() {
+    uint32_t durataUs = 2 * tempoInAria(1) + durataMinimaRxListenUs;
+    // TimeoutRssiThresh è espresso in unità di 16 bit
+    uint32_t unita = durataUs * (bitRateCorrente / 1000) / 16000 + 1;
+    bus->scriviRegistro(RFM69_2B_RX_TIMEOUT_2, unita > 255 ? 255 : unita);
+}
+
+
+
+// ### 2. Risveglio ### //
+
+
+// Una raffica lunga una pausa e una finestra di ricezione è sentita per
+// intero da almeno una finestra di ogni radio in ascolto
+//
+int RFM69::risveglia() {
+
+    const uint8_t risveglio[1] = {(uint8_t)Servizio::risveglio};
+    uint32_t durata = durataIdleListenUs + durataRxListenUs;
+    uint32_t inizio = micros();
+
+    do {
+        // accorcia l'intervallo tra due messaggi se la radio parte dallo standby
+        preparaTrasmissione();
+        int errore = inviaServizio(risveglio, 1, false);
+        if(errore) return errore;
+        if(!radioPronta(true)) return Errore::inviaTimeout;
+    } while(micros() - inizio < durata);
+
+    if(modalitaDefault == Modalita::listen) {
+        risveglioAttivo = true;
+        tempoRisveglio = millis();
+        richiestaModalitaDefaultAppenaPossibile = true;
+        controlla();
+    }
+
+    return Errore::ok;
+}
+
+
+// La radio passa a rx al ritorno in modalità default, subito dopo (cfr. il
+// blocco tornaInModalitaDefault in controlla())
+//
+void RFM69::riceviRisveglio() {
+    if(modalitaDefault != Modalita::listen) return;
+    risveglioAttivo = true;
+    tempoRisveglio = millis();
+}
+
+
+
+// ### 3. Statistiche ### //
+
+
+uint16_t RFM69::cicloAttivitaListen() {
+    uint32_t periodo = durataIdleListenUs + durataRxListenUs;
+    return periodo ? (uint64_t)durataRxListenUs * 10000 / periodo : 0;
+}
+
+
+uint32_t RFM69::energiaPerMessaggioRicevuto() {
+    if(!messaggiRicevuti) return 0;
+
+    uint32_t inCorso = millis() - inizioModalitaAttuale;
+    uint64_t rx = tempoInRx + (modalita == Modalita::rx ? inCorso : 0);
+    uint64_t listen = tempoInListen + (modalita == Modalita::listen ? inCorso : 0);
+
+    // 16 mA in ricezione e 1.2 uA in idle a 3.3V: 52.8 mW e 3.96 uW.
+    // mW * ms = uJ
+    uint64_t energia = rx * 528 / 10
+        + listen * (528 * (uint64_t)cicloAttivitaListen() + 396) / 100000;
+    return energia / messaggiRicevuti;
+}
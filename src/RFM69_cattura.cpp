@@ -0,0 +1,167 @@
+/*! @file
+
+@brief Cattura del segnale in modalità continua
+
+1. Avvio e fine
+2. Interrupt di DCLK
+3. Lettura ed esportazione
+
+In modalità continua con bit synchronizer (DataMode = 10) la radio presenta
+i dati demodulati su DIO2 e il clock su DIO1 (DioMapping1: Dio1Mapping = 00),
+con i dati validi sul fronte di salita del clock (cfr. datasheet, 5.4).
+*/
+
+#include "RFM69.h"
+#include "RFM69_registri.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Avvio e fine ### //
+
+
+int RFM69::avviaCattura(uint8_t memoria[], uint16_t dimensione, uint8_t pinDclk, uint8_t pinDati) {
+
+    if(dimensione < 2 || bitRateCorrente > bitRateMassimaCattura || !radioPronta(false))
+        return Errore::catturaImpossibile;
+
+    memoriaCattura = memoria;
+    dimensioneCattura = dimensione;
+    scritturaCattura = 0;
+    letturaCattura = 0;
+    byteInCattura = 0;
+    bitInCattura = 0;
+    catturaPersi = 0;
+    registroDatiCattura = portInputRegister(digitalPinToPort(pinDati));
+    mascheraDatiCattura = digitalPinToBitMask(pinDati);
+
+    disattivaAutoModes();
+    cambiaModalita(Modalita::standby, true);
+
+    // gli interrupt su DIO0 in modalità continua non riguardano i messaggi
+    stato = Stato::cattura;
+
+    regDataModulPacchetto = bus->leggiRegistro(RFM69_02_DATA_MODUL);
+    bus->scriviRegistro(RFM69_02_DATA_MODUL, (regDataModulPacchetto & 0x9F) | (0x2 << 5));
+
+    pinMode(pinDclk, INPUT);
+    pinMode(pinDati, INPUT);
+    interruptCattura = digitalPinToInterrupt(pinDclk);
+    attachInterrupt(interruptCattura, isrCatturaCaller, RISING);
+
+    // cambiaModalita() scrive Dio1Mapping = 00, cioè DCLK
+    cambiaModalita(Modalita::rx, true);
+
+    return Errore::ok;
+}
+
+
+void RFM69::fermaCattura() {
+
+    if(stato != Stato::cattura) return;
+
+    detachInterrupt(interruptCattura);
+    cambiaModalita(Modalita::standby, true);
+    bus->scriviRegistro(RFM69_02_DATA_MODUL, regDataModulPacchetto);
+
+    stato = Stato::passivo;
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+}
+
+
+
+// ### 2. Interrupt di DCLK ### //
+
+
+void RFM69::isrCatturaCaller() {
+    pointerRadio->isrCattura();
+}
+
+
+// Il pin è letto dal registro della porta: digitalRead() da solo richiede
+// più di 50 cicli di clock
+//
+void RFM69::isrCattura() {
+
+    byteInCattura = (byteInCattura << 1) | ((*registroDatiCattura & mascheraDatiCattura) ? 1 : 0);
+    if(++bitInCattura < 8) return;
+    bitInCattura = 0;
+
+    uint16_t prossima = scritturaCattura + 1;
+    if(prossima == dimensioneCattura) prossima = 0;
+    // un posto resta sempre libero per distinguere la coda piena da quella vuota
+    if(prossima == letturaCattura) {
+        ++catturaPersi;
+        return;
+    }
+    memoriaCattura[scritturaCattura] = byteInCattura;
+    scritturaCattura = prossima;
+}
+
+
+
+// ### 3. Lettura ed esportazione ### //
+
+
+uint16_t RFM69::byteCatturati() {
+    // l'indice di scrittura (2 bytes) cambia nell'interrupt
+    noInterrupts();
+    uint16_t scrittura = scritturaCattura;
+    interrupts();
+    return scrittura >= letturaCattura ? scrittura - letturaCattura
+                                       : dimensioneCattura - letturaCattura + scrittura;
+}
+
+
+uint32_t RFM69::byteCatturaPersi() {
+    noInterrupts();
+    uint32_t persi = catturaPersi;
+    interrupts();
+    return persi;
+}
+
+
+// L'indice di lettura è confrontato dall'interrupt con quello di scrittura:
+// va aggiornato una volta sola, alla fine, e senza interrupt (2 bytes)
+//
+uint16_t RFM69::leggiCattura(uint8_t destinazione[], uint16_t max) {
+    uint16_t n = byteCatturati();
+    if(n > max) n = max;
+    uint16_t lettura = letturaCattura;
+    for(uint16_t i = 0; i < n; i++) {
+        destinazione[i] = memoriaCattura[lettura];
+        if(++lettura == dimensioneCattura) lettura = 0;
+    }
+    noInterrupts();
+    letturaCattura = lettura;
+    interrupts();
+    return n;
+}
+
+
+void RFM69::scriviIntestazioneCattura(HardwareSerial& uscita) {
+
+    uint32_t frequenza = ((uint64_t)(frfNominale + correzioneTemperatura + correzioneApplicata) * 15625) / 256;
+    uint8_t intestazione[16] = {'R', 'F', 'B', 'S', 1, 0, 0, 0};
+    for(uint8_t i = 0; i < 4; i++) {
+        intestazione[8 + i] = bitRateCorrente >> (8 * i);
+        intestazione[12 + i] = frequenza >> (8 * i);
+    }
+    uscita.write(intestazione, 16);
+}
+
+
+uint16_t RFM69::esportaCattura(HardwareSerial& uscita) {
+    uint16_t n = byteCatturati();
+    uint16_t lettura = letturaCattura;
+    for(uint16_t i = 0; i < n; i++) {
+        uscita.write(memoriaCattura[lettura]);
+        if(++lettura == dimensioneCattura) lettura = 0;
+    }
+    noInterrupts();
+    letturaCattura = lettura;
+    interrupts();
+    return n;
+}
@@ -0,0 +1,118 @@
+/*! @file
+
+@brief Controllo della congestione per il traffico da molte radio a una
+
+1. Frequenza degli invii (AIMD)
+2. Carico del canale
+
+La frequenza è in 256-esimi di messaggio al secondo: l'intervallo tra due
+invii è 256000 / frequenza ms. Il carico è in 255-esimi del tempo, come il
+byte che lo riporta negli ACK.
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Frequenza degli invii (AIMD) ### //
+
+
+void RFM69::attivaControlloCongestione(uint16_t intervalloMinimo, uint16_t intervalloMassimo, uint8_t obiettivo) {
+    if(intervalloMinimo == 0) intervalloMinimo = 1;
+    if(intervalloMassimo < intervalloMinimo) intervalloMassimo = intervalloMinimo;
+    tassoInvioMassimo = 256000UL / intervalloMinimo;
+    tassoInvioMinimo = 256000UL / intervalloMassimo;
+    tassoInvio = tassoInvioMinimo * 8 < tassoInvioMassimo ? tassoInvioMinimo * 8 : tassoInvioMassimo;
+    caricoObiettivo = obiettivo;
+    caricoRiportato = 0;
+    prossimoInvioConsentito = millis();
+    controlloCongestione = true;
+}
+
+
+void RFM69::disattivaControlloCongestione() {
+    controlloCongestione = false;
+}
+
+
+bool RFM69::invioConsentito() {
+    return !controlloCongestione || (int32_t)(millis() - prossimoInvioConsentito) >= 0;
+}
+
+
+uint32_t RFM69::intervalloInvio() {
+    return controlloCongestione ? 256000UL / tassoInvio : 0;
+}
+
+
+// Aumento additivo per ogni ACK ricevuto, dimezzamento per ogni ACK perso.
+// Un carico riportato sopra l'obiettivo è un segnale di congestione più
+// debole di una perdita: la frequenza scende, ma solo di 1/8.
+//
+void RFM69::aggiornaCongestione(bool ricevuto) {
+
+    if(!ricevuto) tassoInvio /= 2;
+    else if(caricoRiportato > caricoObiettivo) tassoInvio -= tassoInvio / 8;
+    else tassoInvio += aumentoTassoInvio;
+
+    if(tassoInvio < tassoInvioMinimo) tassoInvio = tassoInvioMinimo;
+    if(tassoInvio > tassoInvioMassimo) tassoInvio = tassoInvioMassimo;
+
+    // l'attesa parte dall'esito: dopo una perdita il tentativo successivo
+    // aspetta già l'intervallo raddoppiato
+    uint32_t intervallo = 256000UL / tassoInvio;
+    prossimoInvioConsentito = millis() + intervallo * 3 / 4 + random(intervallo / 2 + 1);
+}
+
+
+
+// ### 2. Carico del canale ### //
+
+
+void RFM69::attivaSegnalazioneCarico() {
+    caricoMisurato = 0;
+    tempoOccupatoUs = 0;
+    inizioFinestraCarico = millis();
+    segnalazioneCarico = true;
+}
+
+
+void RFM69::disattivaSegnalazioneCarico() {
+    segnalazioneCarico = false;
+}
+
+
+uint8_t RFM69::caricoCanale() {
+    if(!segnalazioneCarico) return caricoRiportato;
+    aggiornaCarico();
+    return caricoMisurato;
+}
+
+
+void RFM69::registraCarico() {
+    aggiornaCarico();
+    if(ultimoMessaggio.intestazione.bit.ack) return;
+    tempoOccupatoUs += tempoInAria(ultimoMessaggio.dimensione);
+    // l'ACK occupa il canale quanto il messaggio, per chi deve aspettare
+    if(ultimoMessaggio.intestazione.bit.richiestaAck) tempoOccupatoUs += tempoInAria(2);
+}
+
+
+// Media mobile esponenziale (peso 1/2) delle finestre. Dopo un lungo
+// silenzio la media precedente non conta più.
+//
+void RFM69::aggiornaCarico() {
+
+    uint32_t trascorso = millis() - inizioFinestraCarico;
+    if(trascorso < finestraCarico) return;
+
+    uint32_t campione = (tempoOccupatoUs / 1000) * 255 / trascorso;
+    if(campione > 255) campione = 255;
+    if(trascorso >= 2 * (uint32_t)finestraCarico) caricoMisurato = campione;
+    else caricoMisurato = (caricoMisurato + campione) / 2;
+
+    tempoOccupatoUs = 0;
+    inizioFinestraCarico += trascorso;
+}
@@ -75,7 +75,7 @@ nel file RFM69_inizializzazioe.h
 )
 
 // (classe) HIGH_POWER, la `x` deve essere la stessa passata a `POWER_VAL(x)`
-#define IS_HIGH_POWER(x) (x <= 20 ? true : false)
+#define IS_HIGH_POWER(x) (x > 17 ? true : false)
 
 // RFM69_12_PA_RAMP
 #define PA_RAMP_3_4_MS		             0x0
@@ -195,7 +195,7 @@ nel file RFM69_inizializzazioe.h
 #define PACKET_FORMAT_VARIABLE           1
 
 #define ENCODING_NONE                    0
-#define ENCODIMNG_MANCHESTER             1
+#define ENCODING_MANCHESTER              1
 #define ENCODING_WHITENING               2
 
 #define ADDRESS_FILTERING_NONE           0
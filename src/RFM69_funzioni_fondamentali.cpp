@@ -32,31 +32,64 @@ Qui sono implementate funzioni come invia, leggi, controlla, e l'isr
 
 // [funzione privata] Invia un messaggio conoscendone già l'intestazione
 //
-int RFM69::inviaMessaggio(const uint8_t messaggio[], uint8_t lunghezza, uint8_t intestazione, bool insisti) {
+int RFM69::inviaMessaggio(const uint8_t messaggio[], uint8_t lunghezza, uint8_t intestazione, bool insisti,
+                          const uint8_t prefisso[], uint8_t lunghezzaPrefisso) {
+
+    // da qui `lunghezza` comprende il prefisso
+    uint8_t lunghezzaMessaggio = lunghezza;
+    lunghezza += lunghezzaPrefisso;
 
     // la radio non può inviare pacchetti di lunghezza 0 (solo byte "dimensione")
     if(lunghezza == 0) return Errore::inviaMessaggioVuoto;
 
+    inizioInvioUs = micros();
+
 
     // l'opzione 'insisti' permette di inviare anche quando un particolare stato
     // della classe lo impedisce, aspettando, fino a un ragionavole timeout, che
     // la condizione ostacolante sia risolta
     if(!radioPronta(insisti)) return Errore::inviaTimeout;
 
-    disattivaAutoModes();
-    cambiaModalita(Modalita::standby, true);
+    // Se la radio è in FS (cfr. preparaTrasmissione()) il sintetizzatore è già
+    // agganciato: si scrive la FIFO in FS e si passa direttamente a TX
+    invioDaFS = (modalita == Modalita::fs && !autoModesAttivo);
+    if(!invioDaFS) {
+        disattivaAutoModes();
+        cambiaModalita(Modalita::standby, true);
+    }
 
     // Il primo byte contiene la lunghezza del messaggio compresa l'intestazione
-    // ma sé stesso escluso.
+    // (ed eventualmente la parità FEC) ma sé stesso escluso.
     // Anche le radio useranno questo valore per inviare/ricevere il pacchetto.
-    bus->scriviRegistro(RFM69_00_FIFO, lunghezza + 1);
+    bus->scriviRegistro(RFM69_00_FIFO, lunghezza + 1 + byteParitaFEC);
     // Il secondo byte è l'intestazione della classe
     bus->scriviRegistro(RFM69_00_FIFO, intestazione);
     // Tutti gli altri bytes sono il messaggio dell'utente
-    for(int i = 0; i < lunghezza; i++) {
+    for(int i = 0; i < lunghezzaPrefisso; i++) {
+        bus->scriviRegistro(RFM69_00_FIFO, prefisso[i]);
+    }
+    for(int i = 0; i < lunghezzaMessaggio; i++) {
         bus->scriviRegistro(RFM69_00_FIFO, messaggio[i]);
     }
+    // Se la FEC è attiva la parità chiude il pacchetto
+    if(byteParitaFEC) {
+        FEC fec(byteParitaFEC);
+        fec.codifica(intestazione);
+        for(int i = 0; i < lunghezzaPrefisso; i++) fec.codifica(prefisso[i]);
+        for(int i = 0; i < lunghezzaMessaggio; i++) fec.codifica(messaggio[i]);
+        for(int i = 0; i < byteParitaFEC; i++) {
+            bus->scriviRegistro(RFM69_00_FIFO, fec.parita()[i]);
+        }
+    }
+
 
+    // per l'istogramma delle latenze, calcolato qui per non farlo nell'ISR:
+    // va scritto prima di avviare la trasmissione, perché con un messaggio
+    // corto l'interrupt di fine invio può arrivare prima della fine di
+    // questa funzione
+    tempoInAriaUltimoInvio = tempoInAria(lunghezza);
+    // e per tempoUltimoInvioUs(), letto dall'ISR per lo stesso motivo
+    durataDopoSincUltimoInvio = durataDopoSincronizzazione(lunghezza);
 
     // separa mesasggi con e senza richiesta di ACK
     Intestazione intest;
@@ -90,17 +123,40 @@ int RFM69::inviaMessaggio(const uint8_t messaggio[], uint8_t lunghezza, uint8_t
 
     tempoUltimaTrasmissione = millis();
 
+    // statistiche per energiaPerByte()
+    energiaTx += energiaTrasmissione(lunghezza);
+    lunghezzaUltimoInvio = lunghezza;
+
     return Errore::ok;
 
 }
 
 
+// [funzione privata] Invia un messaggio di servizio. Il primo byte del
+// messaggio deve essere uno dei valori di `Servizio`.
+//
+int RFM69::inviaServizio(const uint8_t messaggio[], uint8_t lunghezza, bool ack) {
+    Intestazione intestazione;
+    intestazione.bit.richiestaAck = ack;
+    intestazione.bit.titolo = titoloServizio;
+    return inviaMessaggio(messaggio, lunghezza, intestazione.byte);
+}
+
+int RFM69::inviaServizio(const uint8_t prefisso[], uint8_t lunghezzaPrefisso,
+                         const uint8_t dati[], uint8_t lunghezza, bool ack) {
+    Intestazione intestazione;
+    intestazione.bit.richiestaAck = ack;
+    intestazione.bit.titolo = titoloServizio;
+    return inviaMessaggio(dati, lunghezza, intestazione.byte, true, prefisso, lunghezzaPrefisso);
+}
+
+
 
 
 // ### 2. Ricezione ###
 
 
-// Leggi l'ultimo messaggio ricevuto.
+// Leggi il primo messaggio della coda.
 // l'argomento `dimensione` deve essere uguale (o minore) alla grandezza
 // dell'array `messaggio`. Dopo l'esecuzione della funzione conterrà la
 // lunghezza effettiva del messaggio.
@@ -108,25 +164,28 @@ int RFM69::inviaMessaggio(const uint8_t messaggio[], uint8_t lunghezza, uint8_t
 int RFM69::leggi(uint8_t messaggio[], uint8_t &lunghezza) {
 
     // Nessun messaggio in entrata
-    if(!messaggioRicevuto) {
+    if(buffer.vuoto()) {
         return Errore::leggiNessunMessaggio;
     }
 
+    const InfoMessaggio& info = buffer.infoPrimo();
+
     // Messaggio troppo lungo per questa radio
-    if(lungMaxMessEntrata < ultimoMessaggio.dimensione) {
+    if(lungMaxMessEntrata < info.dimensione) {
         segnaMessaggioComeLetto();
         return Errore::messaggioTroppoLungo;
     }
     // Messaggio troppo lungo per l'array dell'utente
-    if(lunghezza < ultimoMessaggio.dimensione) {
+    if(lunghezza < info.dimensione) {
         segnaMessaggioComeLetto();
         return Errore::leggiArrayTroppoCorta;
     }
 
     // Trascrivi messaggio
-    lunghezza = ultimoMessaggio.dimensione;
+    lunghezza = info.dimensione;
+    const uint8_t* dati = buffer.primoMessaggio();
     for(unsigned int i = 0; i < lunghezza; i++) {
-        messaggio[i] = buffer[i];
+        messaggio[i] = dati[i];
     }
 
     segnaMessaggioComeLetto();
@@ -135,13 +194,44 @@ int RFM69::leggi(uint8_t messaggio[], uint8_t &lunghezza) {
 }
 
 
-// nota: questa funzione serve anche per scartaMessaggio()
+// Restituisce il primo messaggio della coda senza copiarlo. Il messaggio resta
+// in coda fino a rilasciaMessaggio(), e nessun messaggio successivo è scaricato
+// nella sua posizione.
+//
+int RFM69::prestaMessaggio(Messaggio& messaggio) {
+
+    if(buffer.vuoto()) return Errore::leggiNessunMessaggio;
+
+    const InfoMessaggio& info = buffer.infoPrimo();
+    messaggio.dati = buffer.primoMessaggio();
+    messaggio.lunghezza = info.dimensione;
+    messaggio.titolo = info.intestazione.bit.titolo;
+    messaggio.richiestaAck = info.intestazione.bit.richiestaAck;
+    messaggio.rssi = info.rssi;
+    messaggio.tempoRicezione = info.tempoRicezione;
+    messaggio.tempoRicezioneUs = info.tempoRicezioneUs;
+
+    return Errore::ok;
+}
+
+
+int RFM69::rilasciaMessaggio() {
+
+    if(buffer.vuoto()) return Errore::leggiNessunMessaggio;
+
+    segnaMessaggioComeLetto();
+
+    return Errore::ok;
+}
+
+
+// nota: questa funzione serve anche per scartaMessaggio() e rilasciaMessaggio()
 void RFM69::segnaMessaggioComeLetto() {
 
-    clear(messaggioRicevuto);
+    buffer.rimuoviPrimo();
 
     // Questa chiamata a 'controlla' serve principalmente a uscire dallo standby
-    // imposto mentre si aspettava la lettura del messaggio.
+    // imposto mentre la coda era piena.
     // Se l'ISR ha piazzato la radio in stato 'standbyAttendendoLettura',
     // concludi la sequenza AutoModes tx -> standby usata per inviare il
     // messaggio e torna in modalità default. Fare questo passo separatamente (e
@@ -152,6 +242,246 @@ void RFM69::segnaMessaggioComeLetto() {
 }
 
 
+// Scarica dalla FIFO un messaggio protetto dalla FEC.
+// Il pacchetto contiene [intestazione][messaggio][parità]: viene letto per intero
+// nel buffer e, se la radio ha segnalato un CRC errato, riparato. Alla fine il
+// buffer contiene solo il messaggio, come senza FEC.
+//
+void RFM69::scaricaMessaggioFEC() {
+
+    // Il flag CrcOk resta valido fino a quando la FIFO non è vuota
+    bool crcOk = bus->leggiRegistro(RFM69_28_IRQ_FLAGS_2) & RFM69_FLAGS_2_CRC_OK;
+
+    uint8_t lung = bus->leggiRegistro(RFM69_00_FIFO);
+
+    // Un pacchetto troppo corto o troppo lungo non può essere una parola di
+    // codice valida (o la lunghezza stessa è stata danneggiata)
+    if(lung < 1 + byteParitaFEC || lung > lungMaxMessEntrata + 1 + byteParitaFEC) {
+        // svuota la FIFO (scrivere il flag FifoOverrun la cancella)
+        bus->scriviRegistro(RFM69_28_IRQ_FLAGS_2, RFM69_FLAGS_2_FIFO_OVERRUN);
+        ultimoMessaggio.valido = false;
+        ++messaggiIrrecuperabili;
+        return;
+    }
+
+    // Con il CRC corretto l'intestazione è affidabile e si può decidere se
+    // scaricare il resto del messaggio
+    if(crcOk) {
+        uint8_t* dati = buffer;
+        dati[0] = bus->leggiRegistro(RFM69_00_FIFO);
+        ultimoMessaggio.intestazione.byte = dati[0];
+        if(daFiltrare(ultimoMessaggio.intestazione)) {
+            bus->scriviRegistro(RFM69_28_IRQ_FLAGS_2, RFM69_FLAGS_2_FIFO_OVERRUN);
+            ultimoMessaggio.dimensione = lung - 1 - byteParitaFEC;
+            messaggioFiltrato = true;
+            return;
+        }
+        bus->leggiSequenza(RFM69_00_FIFO, lung - 1, dati + 1);
+    }
+    else {
+        bus->leggiSequenza(RFM69_00_FIFO, lung, buffer);
+    }
+
+    if(!crcOk) {
+        if(FEC::decodifica(buffer, lung, byteParitaFEC) < 0) {
+            ultimoMessaggio.valido = false;
+            ++messaggiIrrecuperabili;
+            return;
+        }
+        ++messaggiCorretti;
+    }
+
+    ultimoMessaggio.intestazione.byte = buffer[0];
+    ultimoMessaggio.dimensione = lung - 1 - byteParitaFEC;
+    // messaggio riparato: solo ora si conosce la sua vera intestazione
+    if(daFiltrare(ultimoMessaggio.intestazione)) {
+        messaggioFiltrato = true;
+        return;
+    }
+    uint8_t* dati = buffer;
+    for(uint8_t i = 0; i < ultimoMessaggio.dimensione; i++) {
+        dati[i] = dati[i + 1];
+    }
+}
+
+
+void RFM69::attivaFunzioniRicezione(TabellaRicezione& tabella) {
+    tabella.nrCollegamenti = 0;
+    tabella.funzioneDefault = nullptr;
+    funzioniRicezione = &tabella;
+}
+
+void RFM69::disattivaFunzioniRicezione() {
+    funzioniRicezione = nullptr;
+}
+
+
+// Collega una funzione di gestione ai messaggi con il titolo `titolo`
+//
+bool RFM69::collegaFunzioneRicezione(uint8_t titolo, FunzioneRicezione funzione) {
+    if(!funzioniRicezione || titolo > valMaxTitolo || funzione == nullptr) return false;
+    TabellaRicezione& t = *funzioniRicezione;
+    for(uint8_t i = 0; i < t.nrCollegamenti; i++) {
+        if(t.collegamenti[i].titolo == titolo) {
+            t.collegamenti[i].funzione = funzione;
+            return true;
+        }
+    }
+    if(t.nrCollegamenti >= maxFunzioniRicezione) return false;
+    t.collegamenti[t.nrCollegamenti].titolo = titolo;
+    t.collegamenti[t.nrCollegamenti].funzione = funzione;
+    ++t.nrCollegamenti;
+    return true;
+}
+
+void RFM69::scollegaFunzioneRicezione(uint8_t titolo) {
+    if(!funzioniRicezione) return;
+    TabellaRicezione& t = *funzioniRicezione;
+    for(uint8_t i = 0; i < t.nrCollegamenti; i++) {
+        if(t.collegamenti[i].titolo == titolo) {
+            // sposta l'ultimo collegamento al posto di quello eliminato
+            t.collegamenti[i] = t.collegamenti[t.nrCollegamenti - 1];
+            --t.nrCollegamenti;
+            return;
+        }
+    }
+}
+
+bool RFM69::collegaFunzioneRicezioneDefault(FunzioneRicezione funzione) {
+    if(!funzioniRicezione) return false;
+    funzioniRicezione->funzioneDefault = funzione;
+    return true;
+}
+
+
+// Restituisce la funzione di gestione per un titolo (nullptr se non c'è)
+//
+RFM69::FunzioneRicezione RFM69::trovaFunzioneRicezione(uint8_t titolo) {
+    if(!funzioniRicezione) return nullptr;
+    TabellaRicezione& t = *funzioniRicezione;
+    for(uint8_t i = 0; i < t.nrCollegamenti; i++) {
+        if(t.collegamenti[i].titolo == titolo) return t.collegamenti[i].funzione;
+    }
+    return t.funzioneDefault;
+}
+
+
+// Chiama la funzione di gestione con una copia del messaggio nel buffer.
+// Il messaggio non entra nella coda, quindi se la radio aspettava
+// la sua lettura (ACK inviato) sarà liberata dalla prossima chiamata a
+// controlla().
+// La copia serve perché il messaggio è nella posizione libera della coda: se
+// la funzione invia o chiama controlla() il messaggio successivo è scaricato
+// proprio lì. Sta nella tabella e non sullo stack, che durante la funzione
+// deve bastare anche per le funzioni di invio; una sola copia basta perché i
+// messaggi che arrivano durante la funzione vanno in coda.
+//
+bool RFM69::consegnaMessaggio() {
+
+    FunzioneRicezione funzione = trovaFunzioneRicezione(ultimoMessaggio.intestazione.bit.titolo);
+    if(funzione == nullptr) return false;
+
+    uint8_t* copia = funzioniRicezione->copia;
+    const uint8_t* dati = buffer;
+    for(uint8_t i = 0; i < ultimoMessaggio.dimensione; i++) copia[i] = dati[i];
+
+    Messaggio messaggio;
+    messaggio.dati = copia;
+    messaggio.lunghezza = ultimoMessaggio.dimensione;
+    messaggio.titolo = ultimoMessaggio.intestazione.bit.titolo;
+    messaggio.richiestaAck = ultimoMessaggio.intestazione.bit.richiestaAck;
+    messaggio.rssi = ultimoMessaggio.rssi;
+    messaggio.tempoRicezione = ultimoMessaggio.tempoRicezione;
+    messaggio.tempoRicezioneUs = ultimoMessaggio.tempoRicezioneUs;
+
+    consegnaInCorso = true;
+    funzione(messaggio);
+    consegnaInCorso = false;
+
+    return true;
+}
+
+
+// Filtro dei titoli. Gli ACK e i messaggi di servizio devono sempre arrivare
+// alla classe.
+//
+bool RFM69::daFiltrare(Intestazione intestazione) {
+    if(intestazione.bit.ack || intestazione.bit.titolo == titoloServizio) return false;
+    return !((titoliAccettati >> intestazione.bit.titolo) & 1);
+}
+
+
+void RFM69::accettaTitolo(uint8_t titolo, bool accetta) {
+    if(titolo > valMaxTitolo) return;
+    if(accetta) titoliAccettati |= 1ULL << titolo;
+    else titoliAccettati &= ~(1ULL << titolo);
+}
+
+
+// Restituisce `true` se il messaggio appena scaricato deve essere messo in coda
+// per l'utente. Durante l'esecuzione di una funzione di gestione anche i
+// messaggi con una funzione vanno in coda (cfr. annunciaMessaggio).
+//
+bool RFM69::destinatoAllaCoda() {
+    return ultimoMessaggio.valido && !messaggioFiltrato
+        && !ultimoMessaggio.intestazione.bit.ack
+        && ultimoMessaggio.intestazione.bit.titolo != titoloServizio
+        && (consegnaInCorso || !trovaFunzioneRicezione(ultimoMessaggio.intestazione.bit.titolo));
+}
+
+
+// Esegue il messaggio di servizio contenuto nel buffer. Questi messaggi non
+// sono annunciati all'utente; l'ACK (se richiesto) è già stato inviato.
+//
+void RFM69::gestisciServizio() {
+
+    if(ultimoMessaggio.dimensione < 1) return;
+
+    switch((Servizio)buffer[0]) {
+
+        case Servizio::cambioProfilo:
+            // il nuovo profilo sarà applicato al ritorno in modalità default,
+            // cioé dopo la trasmissione dell'ACK con il profilo attuale
+            if(bitRateAdattiva && ultimoMessaggio.dimensione >= 2 && buffer[1] < nrProfiliModem) {
+                profiloDaApplicare = buffer[1];
+                azzeraFinestraAdattamento();
+            }
+            break;
+
+        case Servizio::sincronizzazione:
+            riceviBeaconSincronizzazione();
+            break;
+
+        case Servizio::superframe:
+            riceviBeaconTDMA();
+            break;
+
+        case Servizio::risveglio:
+            riceviRisveglio();
+            break;
+
+        case Servizio::meshVettore:
+            riceviVettoreMesh();
+            break;
+
+        // già gestiti da esaminaMessaggioMesh() e esaminaMessaggioMulticast()
+        // (un messaggio multicast che arriva qui è un duplicato o di un
+        // altro gruppo)
+        case Servizio::meshDati:
+        case Servizio::multicast:
+            break;
+
+        case Servizio::statoMulticast:
+            riceviStatoMulticast();
+            break;
+
+        case Servizio::nackMulticast:
+            riceviNackMulticast();
+            break;
+    }
+}
+
+
 // ### 3. Ack ###
 
 
@@ -161,8 +491,16 @@ void RFM69::inviaAck(uint8_t titolo) {
     disattivaAutoModes();
     cambiaModalita(Modalita::standby);
 
+    // Contenuto: l'RSSI e, sul gateway, il carico del canale
+    uint8_t contenuto = segnalazioneCarico ? 2 : 1;
+    uint8_t carico = 0;
+    if(segnalazioneCarico) {
+        aggiornaCarico();
+        carico = caricoMisurato;
+    }
+
     // Lunghezza, obbligatoria perché serve alla radio
-    bus->scriviRegistro(RFM69_00_FIFO, 1);
+    bus->scriviRegistro(RFM69_00_FIFO, 1 + contenuto + byteParitaFEC);
 
     // Intestazione, segnala che il messaggio è un ACK
     Intestazione intestazione;
@@ -170,6 +508,27 @@ void RFM69::inviaAck(uint8_t titolo) {
     intestazione.bit.titolo = titolo;
     bus->scriviRegistro(RFM69_00_FIFO, intestazione.byte);
 
+    // Contenuto: l'RSSI con cui è stato ricevuto il messaggio, usato
+    // dall'altra radio per regolare la potenza di trasmissione
+    bus->scriviRegistro(RFM69_00_FIFO, (uint8_t)ultimoRssi);
+    // Il carico serve alle radio che inviano per rallentare prima delle
+    // collisioni (cfr. aggiornaCongestione())
+    if(segnalazioneCarico) bus->scriviRegistro(RFM69_00_FIFO, carico);
+
+    // Anche gli ACK sono protetti dalla FEC (se attiva)
+    if(byteParitaFEC) {
+        FEC fec(byteParitaFEC);
+        fec.codifica(intestazione.byte);
+        fec.codifica((uint8_t)ultimoRssi);
+        if(segnalazioneCarico) fec.codifica(carico);
+        for(int i = 0; i < byteParitaFEC; i++) {
+            bus->scriviRegistro(RFM69_00_FIFO, fec.parita()[i]);
+        }
+    }
+
+    // letta dall'ISR alla fine dell'invio, quindi scritta prima di iniziarlo
+    durataDopoSincUltimoInvio = durataDopoSincronizzazione(contenuto);
+
     // 'packetSentRising' non succede mai in modalità standby; "controlla()" si
     // occuperà di tornare alla modalità corretta.
     // L'uso di AutoModes qui (invece di mettere semplicemente la radio in
@@ -179,6 +538,8 @@ void RFM69::inviaAck(uint8_t titolo) {
 
     stato = Stato::invioAck;
 
+    energiaTx += energiaTrasmissione(contenuto);
+
 }
 
 
@@ -203,6 +564,7 @@ void RFM69::isrCaller() {
 void RFM69::isr() {
 
     tempoUltimaEsecuzioneIsr = millis();
+    tempoUltimaEsecuzioneIsrUs = micros();
 
     switch(stato) {
         
@@ -219,6 +581,8 @@ void RFM69::isr() {
         // fine della trasmissione
         case Stato::invioMessSenzaAck:
             ++messaggiInviati;
+            tempoInvioUs = tempoUltimaEsecuzioneIsrUs - durataDopoSincUltimoInvio - latenzaInterruptUs;
+            registraLatenzaTx();
             // concludi la sequenza tx->standby usata per inviare l'ack
             interruzioneAutoModesAutorizzata = true;
             set(richiestaAzione.tornaInModalitaDefault);
@@ -228,6 +592,8 @@ void RFM69::isr() {
         // fine della trasmissione
         case Stato::invioMessConAck:
             ++messaggiInviati;
+            tempoInvioUs = tempoUltimaEsecuzioneIsrUs - durataDopoSincUltimoInvio - latenzaInterruptUs;
+            registraLatenzaTx();
             // non è richiesta nessuna azione perché il passaggio da tx a rx
             // necessario in questo momento è gestito autonomamente dalla radio
             // grazie alla funtione AutoModes. Cambiare lo stato a 'attesaAck'
@@ -250,6 +616,7 @@ void RFM69::isr() {
             break;
 
         case Stato::invioAck:
+            tempoInvioUs = tempoUltimaEsecuzioneIsrUs - durataDopoSincUltimoInvio - latenzaInterruptUs;
             // Mantieni la radio in standby dopo la sequenza AutoModes tx ->
             // standby usata per inviare l'ACK (l'alternativa sarebbe tornare in
             // modalità default). Questo fa sì che se default=RX non si
@@ -270,6 +637,24 @@ void RFM69::isr() {
 
 
 
+// Aggiunge all'istogramma la latenza di avvio della trasmissione appena
+// conclusa. Chiamata dall'ISR, quindi solo somme e shift.
+//
+void RFM69::registraLatenzaTx() {
+    uint32_t totale = micros() - inizioInvioUs;
+    uint32_t latenza = totale > tempoInAriaUltimoInvio ? totale - tempoInAriaUltimoInvio : 0;
+    // classe 0: < 250 us, poi ogni classe raddoppia il limite
+    uint8_t classe = 0;
+    latenza /= 250;
+    while(latenza && classe < nrClassiLatenzaTx - 1) {
+        latenza >>= 1;
+        ++classe;
+    }
+    ++latenzaTx[invioDaFS][classe];
+}
+
+
+
 // funzione che esegue gli ordini dell'ISR, controlla timeout, ...
 //
 int RFM69::controlla() {
@@ -277,6 +662,11 @@ int RFM69::controlla() {
     // debug_print(":");
     int errore = Errore::ok; // returned alla fine
 
+    // # 0. Concludi un cambiamento di modalità #
+    if(cambioModalitaInCorso) {
+        errore = completaCambioModalita();
+    }
+
     // # 1. controlla timeout #
     if(stato == Stato::attesaAck) {
         debug_print("[aak]");
@@ -285,6 +675,7 @@ int RFM69::controlla() {
             debug_print("->tak");
             statoUltimoAck = StatoAck::nonRicevuto;
             impostaStatoAckPerTitolo(ultimoMessaggio.intestazione.bit.titolo, 0, 0);
+            registraEsitoAck(false);
             stato = Stato::attesaAzione;
             interruzioneAutoModesAutorizzata = true;
             set(richiestaAzione.tornaInModalitaDefault);
@@ -302,9 +693,20 @@ int RFM69::controlla() {
             set(richiestaAzione.tornaInModalitaDefault);
             statoUltimoAck = StatoAck::nonRicevuto;
             impostaStatoAckPerTitolo(ultimoMessaggio.intestazione.bit.titolo, 0, 0);
+            registraEsitoAck(false);
         }
     }
 
+    if(bitRateAdattiva) controllaRendezvous();
+
+    // una radio svegliata torna in listen dopo una finestra senza messaggi
+    if(risveglioAttivo && millis() - tempoRisveglio > finestraRisveglio
+            && millis() - tempoUltimoMessaggio > finestraRisveglio) {
+        debug_print("[fri]");
+        risveglioAttivo = false;
+        richiestaModalitaDefaultAppenaPossibile = true;
+    }
+
 
     // # 2. Gestisci richieste dall'utente #
 
@@ -325,10 +727,10 @@ int RFM69::controlla() {
 
     // # 3. Sblocca la radio dopo aver letto un messaggio e inviato l'ACK #
     
-    // se la radio aspetta la lettura di un messaggio ma non ci sono messaggi
-    // da leggere significa che il messaggio è stato letto, quindi esci
-    // dallo standby
-    if(stato == Stato::standbyAttendendoLettura && !messaggioRicevuto) {
+    // se la radio aspetta la lettura di un messaggio ma la coda non è piena
+    // significa che un messaggio è stato letto (o che quello per cui è stato
+    // inviato l'ACK non è entrato in coda), quindi esci dallo standby
+    if(stato == Stato::standbyAttendendoLettura && !buffer.pieno()) {
         debug_print("[mle]");
         interruzioneAutoModesAutorizzata = true;
         set(richiestaAzione.tornaInModalitaDefault);
@@ -350,41 +752,100 @@ int RFM69::controlla() {
             clear(richiestaAzione.scaricaMessaggio );
 
             ultimoMessaggio.tempoRicezione = tempoUltimaEsecuzioneIsr;
-            // leggi e salva localmente i primi due bytes (lunghezza e intestazione)
-            uint8_t lung = bus->leggiRegistro(RFM69_00_FIFO);
-            ultimoMessaggio.dimensione = lung - 1;
-            ultimoMessaggio.intestazione.byte = bus->leggiRegistro(RFM69_00_FIFO); 
-            // leggi tutti gli altri bytes
-            if(ultimoMessaggio.dimensione > 0) {
-                bus->leggiSequenza(RFM69_00_FIFO, ultimoMessaggio.dimensione, buffer);
+            ultimoMessaggio.valido = true;
+            messaggioFiltrato = false;
+            messaggioMeshConsegnato = false;
+            if(snifferAttivo) {
+                scaricaMessaggioSniffer();
+            }
+            else if(!byteParitaFEC) {
+                // leggi e salva localmente i primi due bytes (lunghezza e intestazione)
+                uint8_t lung = bus->leggiRegistro(RFM69_00_FIFO);
+                ultimoMessaggio.dimensione = lung - 1;
+                // un messaggio più lungo della posizione libera nella coda
+                // sovrascriverebbe quelli in attesa di lettura
+                if(lung < 1 || ultimoMessaggio.dimensione > lungMaxMessEntrata) {
+                    // svuota la FIFO (scrivere il flag FifoOverrun la cancella)
+                    bus->scriviRegistro(RFM69_28_IRQ_FLAGS_2, RFM69_FLAGS_2_FIFO_OVERRUN);
+                    ultimoMessaggio.valido = false;
+                }
+                else {
+                    ultimoMessaggio.intestazione.byte = bus->leggiRegistro(RFM69_00_FIFO);
+                    // un messaggio filtrato non è scaricato: basta svuotare la FIFO
+                    if(daFiltrare(ultimoMessaggio.intestazione)) {
+                        bus->scriviRegistro(RFM69_28_IRQ_FLAGS_2, RFM69_FLAGS_2_FIFO_OVERRUN);
+                        messaggioFiltrato = true;
+                    }
+                    // leggi tutti gli altri bytes
+                    else if(ultimoMessaggio.dimensione > 0) {
+                        bus->leggiSequenza(RFM69_00_FIFO, ultimoMessaggio.dimensione, buffer);
+                    }
+                }
+            }
+            else {
+                scaricaMessaggioFEC();
             }
 
+            // riporta l'"ora" dell'interrupt alla fine della sync word. La
+            // durata dipende dalla lunghezza in aria, quindi va calcolata prima
+            // che esaminaMessaggioMesh() o esaminaMessaggioMulticast() tolgano
+            // l'intestazione dal messaggio
+            ultimoMessaggio.tempoRicezioneUs = tempoUltimaEsecuzioneIsrUs
+                - durataDopoSincronizzazione(ultimoMessaggio.dimensione) - latenzaInterruptUs;
+
             // qualsiasi messagio (ack, messaggio, atteso o no) porta
             // l'informazione più recente sulla distanza dell'altra radio
             //[RSSI = - REG_0x24 / 2, vedi datasheet]
             ultimoRssi = -(bus->leggiRegistro(RFM69_24_RSSI_VALUE)/2);
+            ultimoMessaggio.rssi = ultimoRssi;
+            // e aggiorna la stima del collegamento con chi l'ha inviato
+            if(tabellaCollegamenti && ultimoMessaggio.valido) registraRicezioneCollegamento();
+            // e il carico del canale, che il gateway riporta negli ACK
+            if(segnalazioneCarico && ultimoMessaggio.valido) registraCarico();
+
+            // e il suo errore di frequenza
+            if(tabellaAFC && ultimoMessaggio.valido) registraErroreFrequenza();
+
+            // lo sniffer registra il pacchetto, che non va oltre
+            if(snifferAttivo) registraPacchettoSniffer();
+
+            // un messaggio mesh può essere da inoltrare, da consegnare o per
+            // un'altra radio (che deve rispondere al posto di questa)
+            if(mesh && ultimoMessaggio.valido) esaminaMessaggioMesh();
+            // un messaggio multicast non riceve mai ACK
+            if(ultimoMessaggio.valido) esaminaMessaggioMulticast();
+
+            if(ultimoMessaggio.valido) tempoUltimoMessaggio = millis();
         }
 
         if(richiestaAzione.verificaAck) {
             debug_print("[aaz-va]");
             clear(richiestaAzione.verificaAck);
 
-            if(ultimoMessaggio.intestazione.bit.ack) {
+            if(ultimoMessaggio.valido && ultimoMessaggio.intestazione.bit.ack) {
                 debug_print("->akr");
                 statoUltimoAck = StatoAck::ricevuto;
                 impostaStatoAckPerTitolo(ultimoMessaggio.intestazione.bit.titolo, 0, 1);
                 // statistiche
                 durataUltimaAttesaAck = ultimoMessaggio.tempoRicezione - tempoUltimaTrasmissione;
+                durataUltimaAttesaAckUs = ultimoMessaggio.tempoRicezioneUs - tempoInvioUs;
                 if(durataUltimaAttesaAck > durataMassimaAttesaAck) {
                     durataMassimaAttesaAck = durataUltimaAttesaAck;
                 }
                 ++nrAckRicevuti;
                 sommaAtteseAck += durataUltimaAttesaAck;
+                // l'ACK riporta l'RSSI misurato dall'altra radio
+                rssiRiportato = ultimoMessaggio.dimensione >= 1 ? (int8_t)buffer[0] : ultimoRssi;
+                // e, se l'altra radio è un gateway che lo segnala, il carico del canale
+                caricoRiportato = ultimoMessaggio.dimensione >= 2 ? buffer[1] : 0;
+                if(!negoziazioneInCorso) byteConsegnati += lunghezzaUltimoInvio;
+                registraEsitoAck(true);
             }
             else {
                 debug_print("->anr");
                 statoUltimoAck = StatoAck::nonRicevuto;
                 impostaStatoAckPerTitolo(ultimoMessaggio.intestazione.bit.titolo, 0, 0);
+                registraEsitoAck(false);
                 // se il messaggio non è un ACK l'ACK non arriverà, però il
                 // messaggio potrebbe comunque essere interessante -> converti
                 // l'evento "ack ricevuto" a "messaggio ricevuto"
@@ -399,9 +860,16 @@ int RFM69::controlla() {
             debug_print("[aaz-it]");
             clear(richiestaAzione.inviaAckOTermina);
 
-            if(ultimoMessaggio.intestazione.bit.richiestaAck) {
+            // un messaggio che non può entrare in coda sarà scartato: senza
+            // ACK il mittente lo invierà di nuovo
+            // (lo sniffer non invia mai ACK: ultimoMessaggio non è valido)
+            if(destinatoAllaCoda() && buffer.pieno()) {
+                debug_print("->cpi");
+                set(richiestaAzione.tornaInModalitaDefault);
+            }
+            else if(ultimoMessaggio.valido && ultimoMessaggio.intestazione.bit.richiestaAck) {
                 debug_print("->iak");
-                inviaAck(ultimoMessaggio.intestazione.bit.titolo);
+                inviaAck(messaggioMeshConsegnato ? titoloServizio : ultimoMessaggio.intestazione.bit.titolo);
             }
             else {
                 debug_print("->tmd");
@@ -415,12 +883,35 @@ int RFM69::controlla() {
 
             // controlla che non si tratti di un ack (inatteso, perché un ack
             // atteso non porta ad alzare la flag annunciaMessaggio)
-            if(ultimoMessaggio.intestazione.bit.ack) {
+            if(!ultimoMessaggio.valido) {
+                debug_print("->mnv");
+            }
+            else if(ultimoMessaggio.intestazione.bit.ack) {
                 debug_print("->akr");
                 ++ackInattesi;
             }
+            else if(ultimoMessaggio.intestazione.bit.titolo == titoloServizio) {
+                debug_print("->srv");
+                gestisciServizio();
+            }
+            else if(messaggioFiltrato) {
+                debug_print("->fil");
+                ++messaggiFiltrati;
+            }
+            else if(!destinatoAllaCoda()) {
+                // la funzione sarà chiamata alla fine di controlla(), quando
+                // lo stato della classe è di nuovo coerente
+                debug_print("->fun");
+                ++messaggiRicevuti;
+                consegnaInSospeso = true;
+            }
+            else if(buffer.pieno()) {
+                debug_print("->cpi");
+                ++messaggiScartatiCodaPiena;
+            }
             else {
-                set(messaggioRicevuto);
+                ++messaggiRicevuti;
+                buffer.aggiungi(ultimoMessaggio);
             }
         }
 
@@ -442,7 +933,17 @@ int RFM69::controlla() {
                 // automodes non è usato solo per le "seqenuze automatiche" escluse
                 // dall'if sopra ma anche per la modalità ricezione!
                 disattivaAutoModes(); 
-                if(usaAutoModesPerRX && modalitaDefault == Modalita::rx) {
+                // un nuovo profilo di bit rate si può scrivere solo ora, in
+                // standby e dopo la fine dello scambio in corso
+                if(profiloDaApplicare != nessunProfilo) {
+                    applicaProfiloModem(profiloDaApplicare);
+                    profiloDaApplicare = nessunProfilo;
+                }
+                // dopo un risveglio la radio resta in ricezione invece di
+                // tornare in listen (cfr. risveglia())
+                Modalita mod = modalitaDefault;
+                if(risveglioAttivo && mod == Modalita::listen) mod = Modalita::rx;
+                if(usaAutoModesPerRX && mod == Modalita::rx) {
                     debug_print(">>arx");
                     // metti la radio in modalità rx con un'impostazione autoModes tale che
                     // appena un messaggio è ricevuto correttamente (crcOk) la radio passa
@@ -450,16 +951,82 @@ int RFM69::controlla() {
                     // La condizione selezionata per uscire dallo standby non si verifica
                     // mai. Nello stesso momento in cui AutoModes cambia la modalità viene
                     // chiamata l'ISR, che segnala a `controlla()` l'arrivo di un messaggio.
-                    autoModes(Modalita::rx, AMModInter::standby, AMEnterCond::crcOkRising, AMExitCond::packetSentRising);
+                    // Con la FEC attiva (o lo sniffer) anche i messaggi con CRC
+                    // errato devono fermare la ricezione (PayloadReady arriva
+                    // comunque)
+                    autoModes(Modalita::rx, AMModInter::standby,
+                        byteParitaFEC || snifferAttivo ? AMEnterCond::payloadReadyRising : AMEnterCond::crcOkRising,
+                        AMExitCond::packetSentRising);
                     interruzioneAutoModesAutorizzata = true;
                 }
+                else if(preriscaldamentoFS && mod == Modalita::standby) {
+                    cambiaModalita(Modalita::fs, false);
+                }
                 else {
-                    cambiaModalita(modalitaDefault);
+                    cambiaModalita(mod, false);
                 }
             }
         }
 
     }
+
+    // # 5. Consegna il messaggio appena scaricato alla sua funzione di gestione #
+    if(consegnaInSospeso) {
+        debug_print("[cme]");
+        consegnaInSospeso = false;
+        consegnaMessaggio();
+    }
+
+    // (questo blocco e i successivi devono essere gli ultimi: cambiano modalità
+    // o inviano messaggi, richiedono la radio libera e possono richiamare
+    // controlla())
+
+    // # 6. Salto di frequenza: passa al canale della posizione attuale #
+    if(nrCanaliFHSS && stato == Stato::passivo) {
+        controllaFHSS();
+    }
+
+    // # 7. Correggi la frequenza per il corrispondente attuale #
+    if(tabellaAFC && stato == Stato::passivo) {
+        controllaCorrezioneFrequenza();
+    }
+
+    // # 8. Compensa la deriva del quarzo con la temperatura #
+    if(tabellaTemperatura && stato == Stato::passivo) {
+        controllaCompensazioneTemperatura();
+    }
+
+    // # 9. Misura il rumore su un canale (analisi dello spettro in sottofondo) #
+    if(nrCanaliSpettro && stato == Stato::passivo) {
+        controllaAnalisiSpettro();
+    }
+
+    // # 10. Proponi un cambio di bit rate all'altra radio #
+    if(profiloDaProporre != nessunProfilo && stato == Stato::passivo && !negoziazioneInCorso) {
+        debug_print("[npr]");
+        negoziaProfilo();
+    }
+
+    // # 11. Invia un beacon di sincronizzazione (solo radice) #
+    if(sincronizzazione && sincronizzazione->ruolo == RuoloSincronizzazione::radice
+            && stato == Stato::passivo) {
+        controllaBeaconSincronizzazione();
+    }
+
+    // # 12. TDMA: beacon del coordinatore o invio dalla coda di un nodo #
+    if(ruoloTDMA != RuoloTDMA::nessuno && stato == Stato::passivo) {
+        controllaTDMA();
+    }
+
+    // # 13. Mesh: annunci delle rotte e invio dalle code #
+    if(mesh && stato == Stato::passivo) {
+        controllaMesh();
+    }
+
+    // # 14. Multicast: ritrasmissioni, annunci e NACK #
+    if(multicast && stato == Stato::passivo) {
+        controllaMulticast();
+    }
     
     return errore;
 }
@@ -497,6 +1064,23 @@ void  RFM69::sleep(bool aspetta) {
 }
 
 
+// Aggancia il sintetizzatore in vista di una trasmissione imminente
+//
+void RFM69::preparaTrasmissione() {
+    // in ricezione il sintetizzatore è già attivo; se la radio è occupata il
+    // suo stato cambierà comunque prima del prossimo invio
+    if(stato != Stato::passivo || autoModesAttivo) return;
+    if(modalita == Modalita::rx || modalita == Modalita::listen || modalita == Modalita::fs) return;
+    cambiaModalita(Modalita::fs, false);
+}
+
+void RFM69::impostaPreriscaldamentoFS(bool attiva) {
+    preriscaldamentoFS = attiva;
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+}
+
+
 
 
 
@@ -539,16 +1123,27 @@ int RFM69::cambiaModalita(RFM69::Modalita mod, bool aspetta) {
         return Errore::modBloccataAutoModAttivo;
     }
 
-    // La modalità listen non è impostabile senza attesa
-    if(!aspetta && (mod == Modalita::listen)) return Errore::modImpossibile;
+    // Imposta l'interrupt generato sul pin DIO0 prima di cambiare modalità, in
+    // modo che sia già corretto quando la radio entra nella nuova modalità.
+    // Le modalità in cui DIO0 è usato (rx e tx) sono sempre raggiunte
+    // dallo standby o da FS, dove il segnale è ignorato.
+    uint8_t dio0 = 0;
+    switch(mod) {
+        case Modalita::sleep:                 break; // (non importa)
+        case Modalita::listen:    dio0 = 1;   break; // PayloadReady (nelle finestre rx)
+        case Modalita::standby:               break; // (non importa)
+        case Modalita::fs:                    break; // (non importa)
+        case Modalita::tx:        dio0 = 0;   break; // PacketSent
+        case Modalita::rx:        dio0 = 1;   break; // PayloadReady
+    }
+
+    bus->scriviRegistro(RFM69_25_DIO_MAPPING_1, dio0 << 6);
 
-    // Se l'ISR ha appena chiesto una disattivazione del modo Tx potrebbe darsi
-    // che la radio è ancora in fase di transizione. 2 ms di attesa riducono
-    // le probabilità di conflitto (già molto bassa, e comunque non nulla).
-    // Al momento della scrittura di questa funzione, questo può succedere solo se
-    // l'impostazione TEMPO_MINIMO_FRA_MESSAGGI è 0 in caso di più invii di seguito
-    if(aspetta) delay(2);
-    // TODO: ^^^ rimuovere o giustificare meglio
+    // statistiche per energiaPerMessaggioRicevuto()
+    uint32_t ora = millis();
+    if(modalita == Modalita::rx) tempoInRx += ora - inizioModalitaAttuale;
+    else if(modalita == Modalita::listen) tempoInListen += ora - inizioModalitaAttuale;
+    inizioModalitaAttuale = ora;
 
     // Prepara il byte da scrivere nel registro
     regOpMode &= 0xE3;
@@ -588,40 +1183,23 @@ int RFM69::cambiaModalita(RFM69::Modalita mod, bool aspetta) {
     // La radio deve uscire dalla modalità high power tx
     if (highPower && (modalita == Modalita::tx)) highPowerSettings(false);
 
-    if(aspetta) {
-        // Aspetta che la radio sia pronta (questa flag è 0 durante il cambiamento di
-        // modalità)
-        // timeout: le transizioni più lunghe sembrano durare circa 1 ms (empirico)
-        unsigned long inizioAttesa = millis();
-        while(!(bus->leggiRegistro(RFM69_27_IRQ_FLAGS_1) & RFM69_FLAGS_1_MODE_READY)) {
-            if(inizioAttesa + 3 < millis()) return Errore::modTimeout;
-        }
-    }
+    // Ricorda la modalita attuale della radio
+    modalita = mod;
 
-    // *Listen* (3/3) - Attiva
-    // Per attivare la modalita listen basta scrivere il bit 6 dopo aver
-    // messo la radio in standby
-    if(mod == Modalita::listen) {
-        regOpMode |=  1 << 6;
-        bus->scriviRegistro(RFM69_01_OP_MODE, regOpMode);
-    }
+    // La radio segnala la fine del cambiamento con la flag ModeReady. Il resto
+    // del lavoro (attivazione della modalità listen) è svolto da
+    // completaCambioModalita(), qui sotto se bisogna aspettare, altrimenti
+    // dalle prossime chiamate a controlla().
+    cambioModalitaInCorso = true;
+    inizioCambioModalitaUs = micros();
 
-    // Imposta l'interrupt generato sul pin DIO0
-    uint8_t dio0 = 0;
-    switch(mod) {
-        case Modalita::sleep:                 break; // (non importa)
-        case Modalita::listen:    dio0 = 1;   break; // PacketSent? (non sono sicuro)
-        case Modalita::standby:               break; // (non importa)
-        case Modalita::fs:                    break; // (non importa)
-        case Modalita::tx:        dio0 = 0;   break; // PacketSent
-        case Modalita::rx:        dio0 = 1;   break; // PayloadReady
+    if(aspetta) {
+        while(cambioModalitaInCorso) {
+            int errore = completaCambioModalita();
+            if(errore) return errore;
+        }
     }
 
-    bus->scriviRegistro(RFM69_25_DIO_MAPPING_1, dio0 << 6);
-
-    // Ricorda la modalita attuale della radio
-    modalita = mod;
-
     // switch(mod) {
     //     case Modalita::tx : Serial.println("_tx_"); break;
     //     case Modalita::rx : Serial.println("_rx_"); break;
@@ -635,6 +1213,36 @@ int RFM69::cambiaModalita(RFM69::Modalita mod, bool aspetta) {
 }
 
 
+// Controlla se la radio ha concluso il cambiamento di modalità iniziato da
+// cambiaModalita() (una sola lettura di registro) e in caso affermativo
+// conclude il lavoro
+//
+int RFM69::completaCambioModalita() {
+
+    // ModeReady è 0 durante il cambiamento di modalità
+    if(bus->leggiRegistro(RFM69_27_IRQ_FLAGS_1) & RFM69_FLAGS_1_MODE_READY) {
+        cambioModalitaInCorso = false;
+        // *Listen* (3/3) - Attiva
+        // Per attivare la modalita listen basta scrivere il bit 6 dopo aver
+        // messo la radio in standby
+        if(modalita == Modalita::listen) {
+            impostaTimeoutListen();
+            regOpMode |=  1 << 6;
+            bus->scriviRegistro(RFM69_01_OP_MODE, regOpMode);
+        }
+        return Errore::ok;
+    }
+
+    // le transizioni più lunghe sembrano durare circa 1 ms (empirico)
+    if(micros() - inizioCambioModalitaUs > timeoutCambioModalitaUs) {
+        cambioModalitaInCorso = false;
+        return Errore::modTimeout;
+    }
+
+    return Errore::ok;
+}
+
+
 
 
 // ### 6. Impostazioni ### //
@@ -646,8 +1254,9 @@ void RFM69::autoModes(Modalita modBase, AMModInter modInter, AMEnterCond enterCo
     // attiva automodes
     uint8_t regAutoModes = ((uint8_t)modInter) | ((uint8_t)exitCond << 2) | ((uint8_t)enterCond << 5);
     bus->scriviRegistro(RFM69_3B_AUTO_MODES, regAutoModes);
-    // imposta modalità di partenza
-    cambiaModalita(modBase);
+    // imposta modalità di partenza; la sequenza prosegue da sola, non serve
+    // aspettare che la radio sia pronta
+    cambiaModalita(modBase, false);
     // flag
     autoModesAttivo = true;
     interruzioneAutoModesAutorizzata = false;
@@ -29,6 +29,7 @@ int RFM69::invia(const uint8_t messaggio[], uint8_t lunghezza, uint8_t titolo) {
     Intestazione intestazione;
     if(titolo > valMaxTitolo) titolo = 0;
     intestazione.bit.titolo = titolo;
+    if(ruoloTDMA == RuoloTDMA::nodo) return accodaInvio(messaggio, lunghezza, intestazione.byte);
     return inviaMessaggio(messaggio, lunghezza, intestazione.byte);
 }
 
@@ -40,6 +41,8 @@ int RFM69::inviaConAck(const uint8_t messaggio[], uint8_t lunghezza, uint8_t tit
     intestazione.bit.richiestaAck = 1;
     if(titolo > valMaxTitolo) titolo = 0;
     intestazione.bit.titolo = titolo;
+    if(ruoloTDMA == RuoloTDMA::nodo) return accodaInvio(messaggio, lunghezza, intestazione.byte);
+    if(!invioConsentito()) return Errore::inviaCongestione;
     return inviaMessaggio(messaggio, lunghezza, intestazione.byte);
 }
 
@@ -53,6 +56,9 @@ int RFM69::inviaFinoAck(uint16_t& tentativi, uint16_t intervallo, const uint8_t
     if(titolo > valMaxTitolo) titolo = 0;
     intestazione.bit.titolo = titolo;
 
+    // con il TDMA i tentativi sono gestiti dalla coda (cfr. attivaTDMA())
+    if(ruoloTDMA == RuoloTDMA::nodo) return accodaInvio(messaggio, lunghezza, intestazione.byte);
+
     // calcola l'attesa addizionale per raggiungere l'intervallo richiesto dall'utente
     uint16_t intervalloReale = intervallo - timeoutAck;
     if(intervalloReale < 0) intervalloReale = 0;
@@ -60,6 +66,8 @@ int RFM69::inviaFinoAck(uint16_t& tentativi, uint16_t intervallo, const uint8_t
     int errore;
     uint16_t i = 0;
     for(; i < tentativi; i++) {
+        // con il controllo della congestione i tentativi si diradano
+        while(!invioConsentito()) controlla();
         // Invia il messaggio
         errore = inviaMessaggio(messaggio, lunghezza, intestazione.byte);
         if(errore != Errore::ok) return errore;
@@ -89,6 +97,8 @@ bool RFM69::staTrasmettendo() {
         case Stato::attesaAzione:
         case Stato::passivo:
         case Stato::standbyAttendendoLettura:
+        case Stato::misuraRssi:
+        case Stato::cattura:
             return false;
     }
     return false;
@@ -106,7 +116,7 @@ bool RFM69::staTrasmettendo() {
 //
 bool RFM69::nuovoMessaggio() {
     controlla();
-    return messaggioRicevuto;
+    return !buffer.vuoto();
 }
 
 
@@ -114,12 +124,14 @@ bool RFM69::nuovoMessaggio() {
 // Restituisce la dimensione dell'ultiomo messaggio ricevuto
 //
 uint8_t RFM69::dimensioneMessaggio() {
+    if(!buffer.vuoto()) return buffer.infoPrimo().dimensione;
     return ultimoMessaggio.dimensione;
 }
 
 // Restituisce il titolo dell'ultimo messaggio
 //
 uint8_t RFM69::titoloMessaggio() {
+    if(!buffer.vuoto()) return buffer.infoPrimo().intestazione.bit.titolo;
     return ultimoMessaggio.intestazione.bit.titolo;
 }
 
@@ -131,15 +143,21 @@ int8_t RFM69::rssi() {
 
 // Restituisce l'"ora" di ricezione dell'ultimo messaggio
 uint32_t RFM69::tempoRicezione() {
+    if(!buffer.vuoto()) return buffer.infoPrimo().tempoRicezione;
     return ultimoMessaggio.tempoRicezione;
+}
 
+// Restituisce l'"ora" di ricezione (fine della sync word) dell'ultimo messaggio in us
+uint32_t RFM69::tempoRicezioneUs() {
+    if(!buffer.vuoto()) return buffer.infoPrimo().tempoRicezioneUs;
+    return ultimoMessaggio.tempoRicezioneUs;
 }
 
 
 int RFM69::scartaMessaggio() {
 
     // Nessun messaggio in entrata
-    if(!messaggioRicevuto) return Errore::leggiNessunMessaggio;
+    if(buffer.vuoto()) return Errore::leggiNessunMessaggio;
     
     segnaMessaggioComeLetto();
 
@@ -256,6 +274,9 @@ void RFM69::stampaErroreSerial(HardwareSerial& serial, int errore, bool contesto
 
             case Errore::inviaMessaggioVuoto :
             case Errore::inviaTimeout :
+            case Errore::inviaFinoAckNoRisposta :
+            case Errore::inviaCodaPiena :
+            case Errore::inviaCongestione :
             serial.print(F("invia: ")); break;
 
             case Errore::leggiNessunMessaggio :
@@ -270,6 +291,42 @@ void RFM69::stampaErroreSerial(HardwareSerial& serial, int errore, bool contesto
             case Errore::controllaTimeoutTx:
             serial.print(F("controlla: ")); break;
 
+            case Errore::tdmaImpostazioneNonValida:
+            serial.print(F("TDMA: ")); break;
+
+            case Errore::listenImpostazioneNonValida:
+            serial.print(F("impostaListen: ")); break;
+
+            case Errore::profiloRadioOccupata:
+            serial.print(F("applicaProfilo: ")); break;
+
+            case Errore::fhssImpostazioneNonValida:
+            serial.print(F("attivaFHSS: ")); break;
+
+            case Errore::analisiSpettroImpossibile:
+            serial.print(F("analisiSpettro: ")); break;
+
+            case Errore::correzioneFrequenzaNonValida:
+            serial.print(F("correzioneFrequenza: ")); break;
+
+            case Errore::temperaturaImpossibile:
+            serial.print(F("temperatura: ")); break;
+
+            case Errore::catturaImpossibile:
+            serial.print(F("cattura: ")); break;
+
+            case Errore::snifferRadioOccupata:
+            serial.print(F("sniffer: ")); break;
+
+            case Errore::meshImpostazioneNonValida:
+            serial.print(F("attivaMesh: ")); break;
+
+            case Errore::meshNessunaRotta:
+            serial.print(F("inviaMesh: ")); break;
+
+            case Errore::multicastGruppoNonValido:
+            serial.print(F("inviaMulticast: ")); break;
+
             default:
             serial.print(F("Errore sconosciuto: "));
             serial.print(errore);
@@ -313,6 +370,32 @@ void RFM69::stampaErroreSerial(HardwareSerial& serial, int errore, bool contesto
         
         case Errore::controllaTimeoutTx:
         serial.print(F("timeout tx")); break;
+
+        case Errore::inviaFinoAckNoRisposta :
+        serial.print(F("nessuna risposta")); break;
+        case Errore::inviaCodaPiena :
+        serial.print(F("coda piena")); break;
+        case Errore::inviaCongestione :
+        serial.print(F("troppo presto (congestione)")); break;
+        case Errore::profiloRadioOccupata :
+        case Errore::snifferRadioOccupata :
+        serial.print(F("radio occupata")); break;
+        case Errore::meshImpostazioneNonValida :
+        serial.print(F("indirizzo non valido o messaggi troppo corti")); break;
+        case Errore::meshNessunaRotta :
+        serial.print(F("destinazione sconosciuta")); break;
+        case Errore::multicastGruppoNonValido :
+        serial.print(F("gruppo non valido")); break;
+        case Errore::temperaturaImpossibile :
+        serial.print(F("radio occupata o tabella vuota")); break;
+        case Errore::catturaImpossibile :
+        serial.print(F("radio occupata o memoria insufficiente")); break;
+        case Errore::tdmaImpostazioneNonValida :
+        case Errore::listenImpostazioneNonValida :
+        case Errore::fhssImpostazioneNonValida :
+        case Errore::analisiSpettroImpossibile :
+        case Errore::correzioneFrequenzaNonValida :
+        serial.print(F("impostazione non valida")); break;
     }
     serial.println();
 }
@@ -330,8 +413,19 @@ void RFM69::stampaStatoSerial(HardwareSerial& Serial) {
         case Stato::attesaAck : Serial.print("aak ");break;
         case Stato::invioAck : Serial.print("iak ");break;
         case Stato::standbyAttendendoLettura : Serial.print("sal ");break;
+        case Stato::misuraRssi : Serial.print("rss ");break;
+        case Stato::cattura : Serial.print("cat ");break;
+    }
+    if(!buffer.vuoto()) {
+        Serial.print("mr");
+        Serial.print(buffer.nrMessaggi());
+        Serial.print(" ");
+    }
+    if(stato == Stato::cattura && byteCatturaPersi()) {
+        Serial.print("cp");
+        Serial.print(byteCatturaPersi());
+        Serial.print(" ");
     }
-    if(messaggioRicevuto) Serial.print("mr ");
     Serial.print("- ");
     if(richiestaAzione.tornaInModalitaDefault ) Serial.print("tmd ");
     if(richiestaAzione.scaricaMessaggio ) Serial.print("sme ");
@@ -343,3 +437,58 @@ void RFM69::stampaStatoSerial(HardwareSerial& Serial) {
     if(richiestaModalitaDefaultAppenaPossibile) Serial.print("+rmdap");
     Serial.print("\n");
 }
+
+
+
+uint16_t RFM69::nrTrasmissioniPerLatenza(bool daFS, uint8_t classe) {
+    if(classe >= nrClassiLatenzaTx) return 0;
+    return latenzaTx[daFS][classe];
+}
+
+
+void RFM69::stampaLatenzaTxSerial(HardwareSerial& Serial) {
+    Serial.println(F("Latenza avvio tx [us]\tstandby\tFS"));
+    uint16_t limite = 250;
+    for(uint8_t i = 0; i < nrClassiLatenzaTx; i++) {
+        if(i < nrClassiLatenzaTx - 1) {
+            Serial.print(F("< "));
+            Serial.print(limite);
+        }
+        else {
+            Serial.print(F(">= "));
+            Serial.print(limite / 2);
+        }
+        Serial.print(F("\t\t"));
+        Serial.print(latenzaTx[0][i]);
+        Serial.print(F("\t"));
+        Serial.println(latenzaTx[1][i]);
+        limite *= 2;
+    }
+}
+
+
+// RAM occupata dalla classe: istanza, coda di ricezione, interfaccia (se è in
+// memoriaBus) e membri static (nrIstanze e pointerRadio)
+//
+uint16_t RFM69::memoriaOccupata() {
+    return sizeof(RFM69) + buffer.dimensioneMemoria() + memoriaBusOccupata()
+        + sizeof(nrIstanze) + sizeof(pointerRadio);
+}
+
+
+void RFM69::stampaMemoriaSerial(HardwareSerial& Serial) {
+    Serial.println(F("RAM occupata da RFM69 [bytes]"));
+    Serial.print(F("istanza\t\t"));
+    Serial.println(sizeof(RFM69));
+    Serial.print(F("coda ricezione\t"));
+    Serial.print(buffer.dimensioneMemoria());
+    Serial.print(F(" ("));
+    Serial.print(buffer.capacita());
+    Serial.println(F(" messaggi)"));
+    Serial.print(F("interfaccia\t"));
+    Serial.println(memoriaBusOccupata());
+    Serial.print(F("static\t\t"));
+    Serial.println(sizeof(nrIstanze) + sizeof(pointerRadio));
+    Serial.print(F("totale\t\t"));
+    Serial.println(memoriaOccupata());
+}
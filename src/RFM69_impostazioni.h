@@ -126,7 +126,9 @@ dell'implementazione della classe RFM69).
 #define LISTEN_CRIT                     LISTEN_CRIT_NO_ADDR
 // [0xD] Action taken after acceptance of a packet in Listen mode
 // _STOP, _GO_TO_MODE, _CONTINUE
-#define LISTEN_END                      LISTEN_END_GO_TO_MODE
+// (con _GO_TO_MODE o _STOP un timeout senza messaggi ferma listen senza
+// generare un interrupt, cfr. RFM69_ascolto.cpp)
+#define LISTEN_END                      LISTEN_END_CONTINUE
 // [0xE] Duration of the Idle phase in Listen mode
 // x ; [Idle time = LISTEN_COEF_IDLE * LISTEN_RESOL_IDLE]
 #define LISTEN_COEF_IDLE                0xF5
@@ -153,9 +155,10 @@ dell'implementazione della classe RFM69).
 
 // [0x19] Channel filter bandwidth
 // x ; 2'600 - 500'000
-// RX_BW > 2*FREQ_DEV + BIT_RATE + CryTol*RADIO_FREQ[MHz]*2, dove CryTol
-//  (crystal tolerance) è compresa tra 50 e 100 ppm (cfr. datasheet p. 31)
-#define RX_BW                           ((long)FREQ_DEV * 2) + BIT_RATE + ((RADIO_FREQ/1000000L) * 70 * 2)
+// RX_BW > 2*FREQ_DEV + BIT_RATE + CryTol*RADIO_FREQ[MHz]*4, dove CryTol
+//  (crystal tolerance) è compresa tra 50 e 100 ppm (cfr. datasheet p. 31) e
+//  vale per ciascuna delle due radio (cfr. RFM69::bandaNecessariaFSK())
+#define RX_BW                           RFM69::bandaNecessariaFSK(BIT_RATE, FREQ_DEV, RADIO_FREQ, 70)
 
 // [0x19] Cut-off frequency of the DC offset canceller (DCC), in % of RxBw
 // _16, _8, _4, _2, _1, _0_5, _0_25, _0_125
@@ -185,8 +188,18 @@ dell'implementazione della classe RFM69).
 
 
 // [0x37] Defines the behavior of the packet handler when CRC check fails
-// ON OFF
+// ON OFF (sempre ON se FEC == ON)
 #define PAYLOAD_READY_ON_CRC_FAIL       OFF
+
+// [software] Forward Error Correction: aggiunge a ogni messaggio dei byte di
+// parità Reed-Solomon che permettono di riparare i messaggi ricevuti con errori
+// invece di scartarli. Deve essere uguale per tutte le radio nella rete.
+// ON OFF
+#define FEC                             OFF
+// [software] Numero di byte di parità (usato solo se FEC == ON). Il codice
+// corregge fino a FEC_BYTE_PARITA/2 byte errati per messaggio.
+// x ; 2 - 16, pari
+#define FEC_BYTE_PARITA                 4
 // [0x3D] After PayloadReady, delay between FIFO empty and the next RSSI phase
 // x
 #define INTER_PACKET_RX_DELAY           0
@@ -21,6 +21,12 @@ Il file è suddiviso in 5 sezioni:
 #include "RFM69_impostazioni.h"
 
 #include <Arduino.h>
+// placement new per l'interfaccia di comunicazione (cfr. memoriaBus)
+#ifdef __AVR__
+#include <new.h>
+#else
+#include <new>
+#endif
 
 
 /// @cond 0
@@ -84,6 +90,13 @@ Il file è suddiviso in 5 sezioni:
 // [0x3D] Enables automatic RX restart after PayloadReady and FIFO empty
 // ON OFF
 #define AUTO_RX_RESTART_EN              OFF
+// [0x37] Con la FEC attiva i messaggi con CRC errato devono comunque arrivare
+// al microcontrollore, che proverà a ripararli
+#if FEC == ON
+#define PAYLOAD_READY_ON_CRC_FAIL_VAL   ON
+#else
+#define PAYLOAD_READY_ON_CRC_FAIL_VAL   PAYLOAD_READY_ON_CRC_FAIL
+#endif
 
 
 
@@ -164,7 +177,7 @@ static const PROGMEM uint8_t valoreRegistri[80] = {
     sync_val[5],                                                // 47 | RFM69_34_SYNC_VALUE_6
     sync_val[6],                                                // 48 | RFM69_35_SYNC_VALUE_7
     sync_val[7],                                                // 49 | RFM69_36_SYNC_VALUE_8
-    (PACKET_FORMAT << 7) | (ENCODING << 5) | (CRC_EN << 4) | (PAYLOAD_READY_ON_CRC_FAIL << 3) | (ADDRESS_FILTERING << 1),// 50 | RFM69_37_PACKET_CONFIG_1
+    (PACKET_FORMAT << 7) | (ENCODING << 5) | (CRC_EN << 4) | (PAYLOAD_READY_ON_CRC_FAIL_VAL << 3) | (ADDRESS_FILTERING << 1),// 50 | RFM69_37_PACKET_CONFIG_1
     PAYLOAD_LENGHT,                                              // 51 | RFM69_38_PAYLOAD_LENGHT
     NODE_ADDRESS,                                                // 52 | RFM69_39_NODE_ADRS
     BROADCAST_ADDRESS,                                           // 53 | RFM69_3A_BROADCAST_ADRS
@@ -222,9 +235,65 @@ static const PROGMEM uint8_t valoreRegistri[80] = {
 
 
 
+// # Profili per la bit rate adattiva #
+
+// Ogni profilo contiene i valori dei registri BitRate (0x03, 0x04), Fdev (0x05,
+// 0x06) e RxBw (0x19, usato anche per 0x1A) e la sensibilità stimata della
+// radio con quelle impostazioni (dBm). I valori sono calcolati e verificati in
+// fase di compilazione da RFM69::Configurazione, che sceglie il channel filter
+// più stretto che contiene il segnale.
+#define PROFILO_MODEM(br, fdev, sensibilita) {                              \
+    (uint8_t)(RFM69::Configurazione<br, fdev, RADIO_FREQ>::valBitRate >> 8), \
+    (uint8_t)RFM69::Configurazione<br, fdev, RADIO_FREQ>::valBitRate,       \
+    (uint8_t)(RFM69::Configurazione<br, fdev, RADIO_FREQ>::valFreqDev >> 8), \
+    (uint8_t)RFM69::Configurazione<br, fdev, RADIO_FREQ>::valFreqDev,       \
+    (uint8_t)((DCC_FREQ << 5) | RFM69::Configurazione<br, fdev, RADIO_FREQ>::valRxBw), \
+    (uint8_t)(sensibilita) }
+
+// dal più lento (rendezvous) al più veloce; il numero di profili è
+// `nrProfiliModem` in RFM69.h
+static const PROGMEM uint8_t profiliModem[][6] = {
+    PROFILO_MODEM(  4800,   5000, -112),
+    PROFILO_MODEM(  9600,   9600, -109),
+    PROFILO_MODEM( 19200,  38400, -105),
+    PROFILO_MODEM( 38400,  38400, -102),
+    PROFILO_MODEM(100000,  50000,  -97),
+    PROFILO_MODEM(200000, 100000,  -94),
+    PROFILO_MODEM(250000,  62500,  -92)
+};
+
+#define VALORE_PROFILO(p, i) pgm_read_byte_near(&profiliModem[p][i])
+#define BIT_RATE_PROFILO(p) (F_OSC / (((uint16_t)VALORE_PROFILO(p, 0) << 8) | VALORE_PROFILO(p, 1)))
+
+
+
+// Verifica in fase di compilazione dei vincoli tra bit rate, Frequency
+// Deviation e channel filter del file di impostazione (cfr. Configurazione):
+// il filtro è quello scritto davvero nel registro, scelto da RX_BW_VAL con la
+// tabella del datasheet
+#if MODULATION == MODULATION_FSK
+typedef RFM69::Configurazione<BIT_RATE, FREQ_DEV, RADIO_FREQ> ConfigurazioneFile;
+static_assert(ConfigurazioneFile::filtroSufficiente(RX_BW_VAL(RX_BW, MODULATION)),
+              "il channel filter di RX_BW deve contenere 2*FREQ_DEV + BIT_RATE + errore dei quarzi");
+#endif
+
+
 // Esecuzione di una macro per la definizione dell'unica impostazione del file
 // di impostazione della radio che non va nei registri ma serve alla classe
 #define HIGH_POWER      IS_HIGH_POWER(POTENZA_TX)
+// Numero di byte di parità aggiunti a ogni messaggio (0 se la FEC non è attiva)
+#if FEC == ON
+#if FEC_BYTE_PARITA < 2 || FEC_BYTE_PARITA > 16 || FEC_BYTE_PARITA % 2
+#error "FEC_BYTE_PARITA deve essere un numero pari compreso tra 2 e 16"
+#endif
+#define BYTE_PARITA_FEC FEC_BYTE_PARITA
+#else
+#define BYTE_PARITA_FEC 0
+#endif
+// Bytes che precedono la lunghezza del pacchetto e CRC, per il calcolo del
+// tempo di trasmissione
+#define BYTE_SINCRONIZZAZIONE   (PREAMBLE_SIZE + (SYNC_EN == ON ? SYNC_SIZE : 0))
+#define BYTE_CRC                (CRC_EN == ON ? 2 : 0)
 
 
 // ### da qui in poi saranno usate solo le costanti etichettate come [software] nel
@@ -241,6 +310,8 @@ static const PROGMEM uint8_t valoreRegistri[80] = {
 // Definizione dei membri `static`di questa classe
 uint8_t RFM69::nrIstanze = 0;
 RFM69* RFM69::pointerRadio = nullptr;
+alignas(RFM69::Spi) alignas(RFM69::SC18IS602B) uint8_t RFM69::memoriaBus[RFM69::dimensioneMemoriaBus];
+constexpr uint8_t RFM69::dimensioneMemoriaBus;
 
 
 // ### 4. Constructor e destructor ### //
@@ -251,6 +322,10 @@ pinReset(pinReset),
 numeroInterrupt(digitalPinToInterrupt(pinInterrupt)),
 haReset(pinReset == 0xff ? false : true),
 highPower(HIGH_POWER), // highPower non è constante
+byteParitaFEC(BYTE_PARITA_FEC),
+byteSincronizzazione(BYTE_SINCRONIZZAZIONE),
+byteCrc(BYTE_CRC),
+codificaManchester(ENCODING == ENCODING_MANCHESTER),
 bus(interfaccia)
 {
     nrIstanze++;
@@ -264,19 +339,21 @@ RFM69::Bus* RFM69::creaInterfacciaSpi(uint8_t pinSS) {
     // a 4'000'000 sembra aver generato un errore segnalato da avrdude con
     // "content mismatch: 0x45 != 0x0c at 0x0000", che si è risolto solo dopo la
     // reinstallazione del bootloader.
-    return new Spi(pinSS, 200000, Spi::BitOrder::MSBFirst, Spi::DataMode::cpol0cpha0);
+    return new (memoriaBus) Spi(pinSS, 200000, Spi::BitOrder::MSBFirst, Spi::DataMode::cpol0cpha0);
 }
 
 
 RFM69::Bus* RFM69::creaInterfacciaSC18IS602B(uint8_t indirizzoSC18, uint8_t numeroSS) {
-    return new SC18IS602B(indirizzoSC18, numeroSS);
+    return new (memoriaBus) SC18IS602B(indirizzoSC18, numeroSS);
 }
 
 
 // Destructor
 RFM69::~RFM69() {
     // il buffer è in una classe wrapper che si occupa di liberare la memoria
-    delete bus;
+    // l'interfaccia creata da una funzione "creaInterfaccia" non è nello heap
+    if((void*)bus == (void*)memoriaBus) bus->~Bus();
+    else delete bus;
     nrIstanze--;
 }
 
@@ -291,7 +368,13 @@ RFM69::~RFM69() {
 // Inizializzazione della radio
 // Cerca di inizializzare la radio e restituisce ErroreInit::ok (-> 0) se ci riesce
 //
-int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio) {
+int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda) {
+    return inizializza(lunghezzaMaxMessaggio, nrMessaggiInCoda, nullptr, nullptr, 0);
+}
+
+
+int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda,
+                    uint8_t* dati, InfoMessaggio* info, uint8_t byteParitaMemoria) {
 
     // Questa versione della classe ha un'unica ISR, dichiarata come static,
     // quindi in un programma ne può esistere una sola instanza.
@@ -370,19 +453,68 @@ int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio) {
     // variabili (l'unica modalità usata in questa classe) determina la
     // lunghezza massima dei messagi ricevuti.
     // PAYLOAD_LENGHT massima nell'implementazioen attuale: 64
-    if(lunghezzaMaxMessaggio > PAYLOAD_LENGHT) return Errore::initLunghMaxMessEccessiva;
-    buffer.init(lunghezzaMaxMessaggio);
+    // Con la FEC attiva i byte di parità occupano parte del pacchetto, e il
+    // buffer deve poter contenere l'intera parola di codice (intestazione,
+    // messaggio e parità) per correggerla.
+    // Una memoria statica deve avere posto anche per i byte di parità.
+    if(lunghezzaMaxMessaggio > PAYLOAD_LENGHT - byteParitaFEC) return Errore::initLunghMaxMessEccessiva;
+    if(dati != nullptr && byteParitaMemoria < byteParitaFEC) return Errore::initLunghMaxMessEccessiva;
+    if(nrMessaggiInCoda < 1) nrMessaggiInCoda = 1;
+    if(nrMessaggiInCoda > maxMessaggiInCoda) nrMessaggiInCoda = maxMessaggiInCoda;
+    // La posizione occupa tutta la memoria riservata ai suoi byte di parità,
+    // anche se la FEC ne usa di meno: Memoria ha posizioni di questa lunghezza.
+    uint8_t byteParitaPosizione = dati != nullptr ? byteParitaMemoria : byteParitaFEC;
+    buffer.init(lunghezzaMaxMessaggio + (byteParitaPosizione ? 1 + byteParitaPosizione : 0),
+                nrMessaggiInCoda, dati, info);
     lungMaxMessEntrata = lunghezzaMaxMessaggio;
 
 
     messaggiInviati = 0;
     messaggiRicevuti = 0;
+    messaggiCorretti = 0;
+    messaggiIrrecuperabili = 0;
+    messaggiScartatiCodaPiena = 0;
+    messaggiFiltrati = 0;
 
     durataUltimaAttesaAck = 0;
+    durataUltimaAttesaAckUs = 0;
+    durataDopoSincUltimoInvio = 0;
     durataMassimaAttesaAck = 0;
     sommaAtteseAck = 0;
     nrAckRicevuti = 0;
 
+    bitRateCorrente = BIT_RATE;
+    bitRateAdattiva = false;
+    profiloModem = nessunProfilo;
+    profiloDaApplicare = nessunProfilo;
+    profiloDaProporre = nessunProfilo;
+
+    potenzaTx = POTENZA_TX;
+    potenzaMassimaTx = POTENZA_TX;
+    controlloPotenza = false;
+    rssiRiportato = 0;
+    energiaTx = 0;
+    byteConsegnati = 0;
+    lunghezzaUltimoInvio = 0;
+    profiloRadioAttivo = nullptr;
+    durataCambioProfiloUs = 0;
+    byteSincronizzazione = BYTE_SINCRONIZZAZIONE;
+    frfNominale = RADIO_FREQ_VAL(RADIO_FREQ);
+    correzioneApplicata = 0;
+    correzioneTemperatura = 0;
+
+    durataIdleListenUs = LISTEN_COEF_IDLE * risoluzioneListenUs(LISTEN_RESOL_IDLE);
+    durataRxListenUs = LISTEN_COEF_RX * risoluzioneListenUs(LISTEN_RESOL_RX);
+    risveglioAttivo = false;
+    tempoInRx = 0;
+    tempoInListen = 0;
+    inizioModalitaAttuale = millis();
+
+    for(uint8_t i = 0; i < nrClassiLatenzaTx; i++) {
+        latenzaTx[0][i] = 0;
+        latenzaTx[1][i] = 0;
+    }
+
     standby(true);
 
     return Errore::ok;
@@ -392,9 +524,16 @@ int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio) {
 
 // Inizializza la radio e stampa il risultato dell'inizializzazione
 //
-int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio, HardwareSerial& serial) {
+int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio, HardwareSerial& serial, uint8_t nrMessaggiInCoda) {
+    return inizializza(lunghezzaMaxMessaggio, nrMessaggiInCoda, nullptr, nullptr, 0, serial);
+}
+
+
+int RFM69::inizializza(uint8_t lunghezzaMaxMessaggio, uint8_t nrMessaggiInCoda,
+                    uint8_t* dati, InfoMessaggio* info, uint8_t byteParitaMemoria,
+                    HardwareSerial& serial) {
     serial.print(F("Inizializzazione RFM69... "));
-    int errore = inizializza(lunghezzaMaxMessaggio);
+    int errore = inizializza(lunghezzaMaxMessaggio, nrMessaggiInCoda, dati, info, byteParitaMemoria);
     if(!errore) serial.println(F("ok"));
     else stampaErroreSerial(serial, errore, false);
     return errore;
@@ -475,52 +614,42 @@ bool RFM69::caricaImpostazioni() {
 
 
 //Imposta la potenza di trasmissione del segnale radio
+// Con il controllo automatico della potenza attivo il valore è la potenza massima
 //
 bool RFM69::impostaPotenzaTx(int dBm) {
+    if(!scriviPotenzaTx(dBm)) return false;
+    potenzaMassimaTx = dBm;
+    return true;
+}
+
+
+// Scrive la potenza nel registro PaLevel (usata anche dal controllo automatico)
+//
+bool RFM69::scriviPotenzaTx(int dBm) {
 
 
     // Controlla che la potenza sia all'interno dei limiti
     if(dBm < -18) return false;
     if(dBm > 20) return false;
 
-    bool pa0, pa1, pa2;
-    int outPow; //solo i primi 5 bit possono essere usati.
+    // il controllo automatico non deve mai scendere su PA0, con cui il modulo
+    // non trasmette, né uscire dal campo di OutputPower (5 bit)
+    static_assert(valorePaLevel(potenzaMinimaTx) == (0x40 | 16),
+                  "la potenza minima deve usare PA1 con OutputPower = 16");
+    static_assert(valorePaLevel(-3) == (0x80 | 15) && valorePaLevel(13) == (0x40 | 31)
+                  && valorePaLevel(17) == (0x60 | 31) && valorePaLevel(20) == (0x60 | 31),
+                  "limiti delle opzioni di PaLevel errati");
 
+    // la modalità high power è attivata da cambiaModalita() a ogni trasmissione;
+    // se non serve più i suoi registri vanno ripristinati subito perché
+    // cambiaModalita() lo fa solo se highPower è ancora true
+    bool highPowerPrima = highPower;
+    highPower = dBm > 17;
 
-    if(dBm <= -2) {      //opzione 1
-        pa0 = 1;
-        pa1 = 0;
-        pa2 = 0;
-        outPow = dBm + 18;
-        highPower = false;
-    }
-    else if(dBm <= 13) { //opzione 2
-        pa0 = 0;
-        pa1 = 1;
-        pa2 = 0;
-        outPow = dBm + 18;
-        highPower = false;
-    }
-    else if(dBm <= 17) { //opzione 3
-        pa0 = 0;
-        pa1 = 1;
-        pa2 = 1;
-        outPow = dBm + 14;
-        highPower = false;
-    }
-    else if(dBm <= 20) { //opzione 4
-        pa0 = 0;
-        pa1 = 1;
-        pa2 = 1;
-        outPow = dBm + 11;
-        highPower = true;
-    }
-
-    //prepara il byte che sarà scritto nel registro e invia alla radio
-    uint8_t paLevel = 0;
-    paLevel = (pa0 << 7) | (pa1 << 6) | (pa2 << 5) | outPow;
+    bus->scriviRegistro(RFM69_11_PA_LEVEL, valorePaLevel(dBm));
 
-    bus->scriviRegistro(RFM69_11_PA_LEVEL, paLevel);
+    if(highPowerPrima && !highPower) highPowerSettings(false);
+    potenzaTx = dBm;
 
     return true;
 }
@@ -545,6 +674,10 @@ int RFM69::impostaBitRate(uint32_t bitRate) {
     bus->scriviRegistro(RFM69_03_BITRATE_MSB, val >> 8);
     bus->scriviRegistro(RFM69_04_BITRATE_LSB, val);
 
+    bitRateCorrente = bitRate;
+    profiloModem = nessunProfilo;
+    profiloRadioAttivo = nullptr;
+
     if(bitRate == (((uint16_t)bus->leggiRegistro(RFM69_03_BITRATE_MSB) << 8) | bus->leggiRegistro(RFM69_04_BITRATE_LSB)))
     return Errore::ok;
 
@@ -567,6 +700,7 @@ int RFM69::impostaFreqDev(uint32_t freqDev) {
     // Scrivi i registri e assicurati che sianon stati scritti correttamente
     bus->scriviRegistro(RFM69_05_FDEV_MSB, val << 8);
     bus->scriviRegistro(RFM69_06_FDEF_LSB, val);
+    profiloRadioAttivo = nullptr;
 
     if(freqDev == (((uint16_t)bus->leggiRegistro(RFM69_05_FDEV_MSB) << 8) | bus->leggiRegistro(RFM69_06_FDEF_LSB)))
     return Errore::ok;
@@ -580,23 +714,92 @@ int RFM69::impostaFreqDev(uint32_t freqDev) {
 //
 int RFM69::impostaFrequenzaMHz(uint32_t freq) {
 
-    // Divide il valore come indicato alla p. 17 del datasheet del modulo RFM69HCW:
+    if(freq < 290000000UL || freq > 1020000000UL) return Errore::errore;
+
+    // Valore indicato alla p. 17 del datasheet del modulo RFM69HCW:
     // [Valore nei registri = FreqRadioHz / Fstep] dove [Fstep = Fxosc / 2^19]
-    // con  [Fxosc = 32MHz].
-    freq /= 32000000 / 524288;
-
-    // Scrive il valore ottenuto nei registri
-    //Registro RegFrfMsb
-    bus->scriviRegistro(RFM69_07_FRF_MSB, freq >> 16);
-    //Registro RegFrfMid
-    bus->scriviRegistro(RFM69_08_FRF_MID, freq >> 8);
-    //Registro RegFrfLsb
-    bus->scriviRegistro(RFM69_09_FRF_LSB, freq);
-
-    if(freq == (((uint32_t)bus->leggiRegistro(RFM69_07_FRF_MSB) << 16) | (bus->leggiRegistro(RFM69_08_FRF_MID) << 8) | (bus->leggiRegistro(RFM69_09_FRF_LSB))))
+    // con  [Fxosc = 32MHz]. La frequenza cambia alla scrittura di RegFrfLsb,
+    // quindi i tre registri sono scritti in una sola sequenza.
+    // Le correzioni per la temperatura e per il corrispondente attuale
+    // restano applicate.
+    frfNominale = valoreFrequenza(freq);
+    uint32_t val = frfNominale + correzioneTemperatura + correzioneApplicata;
+    uint8_t frf[3] = {(uint8_t)(val >> 16), (uint8_t)(val >> 8), (uint8_t)val};
+    bus->scriviSequenza(RFM69_07_FRF_MSB, 3, frf);
+
     return Errore::ok;
+}
 
-    return Errore::errore;
+
+
+// Scrive nei registri un profilo della tabella `profiliModem` (bit rate
+// adattiva). La radio deve essere in standby.
+//
+void RFM69::applicaProfiloModem(uint8_t profilo) {
+
+    static_assert(sizeof(profiliModem) / sizeof(profiliModem[0]) == nrProfiliModem,
+        "nrProfiliModem deve corrispondere al numero di profili nella tabella");
+
+    if(profilo >= nrProfiliModem) return;
+
+    bus->scriviRegistro(RFM69_03_BITRATE_MSB, VALORE_PROFILO(profilo, 0));
+    bus->scriviRegistro(RFM69_04_BITRATE_LSB, VALORE_PROFILO(profilo, 1));
+    bus->scriviRegistro(RFM69_05_FDEV_MSB, VALORE_PROFILO(profilo, 2));
+    bus->scriviRegistro(RFM69_06_FDEF_LSB, VALORE_PROFILO(profilo, 3));
+    bus->scriviRegistro(RFM69_19_RX_BW, VALORE_PROFILO(profilo, 4));
+    bus->scriviRegistro(RFM69_1A_AFC_BW, VALORE_PROFILO(profilo, 4));
+
+    bitRateCorrente = BIT_RATE_PROFILO(profilo);
+    profiloModem = profilo;
+    profiloRadioAttivo = nullptr;
+    // il timeout di rendezvous riparte con il nuovo profilo
+    tempoUltimoMessaggio = millis();
+}
+
+
+// Riempie un profilo radio (cfr. RFM69_profili.cpp) con i valori calcolati
+// da Configurazione o da creaProfilo() e il resto dal file di impostazione.
+// L'ordine dei registri è quello di `ProfiloRadio::registri`.
+//
+void RFM69::riempiProfilo(ProfiloRadio& profilo, const char* nome, uint16_t valBitRate,
+                          uint16_t valFreqDev, uint8_t valRxBw, uint16_t preambolo) {
+
+    if(preambolo == 0) preambolo = PREAMBLE_SIZE;
+
+    profilo.nome = nome;
+    uint8_t* r = profilo.registri;
+    r[0] = VALORE_REGISTRI(2);                  // DataModul
+    r[1] = valBitRate >> 8;
+    r[2] = valBitRate;
+    r[3] = valFreqDev >> 8;
+    r[4] = valFreqDev;
+    r[5] = (DCC_FREQ << 5) | valRxBw;
+    r[6] = (DCC_FREQ_AFC << 5) | valRxBw;
+    r[7] = preambolo >> 8;
+    r[8] = preambolo;
+    // SyncConfig e SyncValue 1 - 8 (indici 41 - 49 di valoreRegistri)
+    for(uint8_t i = 0; i < 9; i++) r[9 + i] = VALORE_REGISTRI(41 + i);
+}
+
+
+uint32_t RFM69::bandaNecessaria(uint32_t bitRate, uint32_t freqDev) {
+    return bandaNecessariaFSK(bitRate, freqDev, RADIO_FREQ);
+}
+
+
+int8_t RFM69::rssiMinimoProfilo(uint8_t profilo) {
+    return (int8_t)VALORE_PROFILO(profilo, 5);
+}
+
+
+// Sensibilità del profilo in uso o, se la bit rate è stata impostata in un
+// altro modo, del profilo più veloce che non la supera
+//
+int8_t RFM69::sensibilitaStimata() {
+    if(profiloModem != nessunProfilo) return rssiMinimoProfilo(profiloModem);
+    uint8_t p = 0;
+    while(p + 1 < nrProfiliModem && (uint32_t)BIT_RATE_PROFILO(p + 1) <= bitRateCorrente) ++p;
+    return rssiMinimoProfilo(p);
 }
 
 
@@ -0,0 +1,533 @@
+/*! @file
+
+@brief Instradamento mesh: inoltro salto per salto e rotte distance-vector
+
+1. Attivazione e invio
+2. Ricezione
+3. Tabelle
+4. Code e annunci
+
+I messaggi mesh sono messaggi di servizio e usano il meccanismo normale degli
+ACK. Solo il destinatario del salto deve rispondere: esaminaMessaggioMesh(),
+chiamata da controlla() subito dopo lo scaricamento, toglie la richiesta di
+ACK ai messaggi destinati ad altri, e anche a quelli che non possono essere
+accettati (coda di inoltro piena), così il vicino li ritrasmetterà. Un
+messaggio per questa radio è convertito lì in un messaggio normale, così la
+coda di ricezione e le funzioni di gestione funzionano come sempre.
+
+Le ritrasmissioni dopo un ACK perso hanno lo stesso numero di sequenza:
+ricevono un nuovo ACK ma non sono inoltrate né consegnate una seconda volta.
+
+Tabelle, code e stato sono nella memoria dell'utente (`MemoriaMesh`): con il
+mesh non attivo la classe contiene solo il puntatore `mesh`, nullo.
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Attivazione e invio ### //
+
+
+int RFM69::attivaMesh(uint8_t indirizzo, StatoMesh& stato,
+                      VicinoMesh* vicini, RottaMesh* rotte, uint8_t nrNodi,
+                      uint8_t* datiLocali, uint8_t* lunghezzeLocali, uint8_t* intestazioniLocali,
+                      uint8_t* datiInoltro, uint8_t* lunghezzeInoltro, uint8_t* intestazioniInoltro,
+                      uint8_t* annuncio, uint8_t lunghezzaMax, uint8_t nrMessaggi, uint16_t intervalloAnnunci) {
+
+    // 0 indica una posizione libera nelle tabelle, 255 è riservato
+    if(indirizzo == 0 || indirizzo == 255 || intervalloAnnunci == 0) {
+        return Errore::meshImpostazioneNonValida;
+    }
+    // il messaggio più lungo con l'intestazione deve entrare nella coda di ricezione
+    if(lunghezzaMax + byteIntestazioneMesh > lungMaxMessEntrata) {
+        return Errore::meshImpostazioneNonValida;
+    }
+
+    disattivaMesh();
+
+    for(uint8_t i = 0; i < nrNodi; i++) {
+        vicini[i].indirizzo = 0;
+        rotte[i].destinazione = 0;
+    }
+    StatoMesh& m = stato;
+    m = StatoMesh();
+    m.indirizzo = indirizzo;
+    m.vicini = vicini;
+    m.rotte = rotte;
+    m.nrNodi = nrNodi;
+    m.lunghezzaMax = lunghezzaMax;
+    m.codaLocale.init(datiLocali, lunghezzeLocali, intestazioniLocali, lunghezzaMax + 4, nrMessaggi);
+    m.codaInoltro.init(datiInoltro, lunghezzeInoltro, intestazioniInoltro, lunghezzaMax + 4, nrMessaggi);
+    m.annuncio = annuncio;
+    m.intervalloAnnunci = intervalloAnnunci;
+    // il primo annuncio parte presto, per farsi conoscere dai vicini
+    m.ultimoAnnuncio = millis();
+    m.ultimoControlloScadenze = m.ultimoAnnuncio;
+    m.prossimoAnnuncio = m.ultimoAnnuncio
+        + random(ritardoMinimoAnnuncioMs, ritardoMassimoAnnuncioMs);
+    mesh = &stato;
+
+    return Errore::ok;
+}
+
+
+void RFM69::disattivaMesh() {
+    mesh = nullptr;
+}
+
+
+int RFM69::inviaMesh(uint8_t destinazione, const uint8_t messaggio[], uint8_t lunghezza, uint8_t titolo) {
+
+    if(!mesh) return Errore::meshNessunaRotta;
+    if(lunghezza == 0) return Errore::inviaMessaggioVuoto;
+    if(lunghezza > mesh->lunghezzaMax) return Errore::messaggioTroppoLungo;
+
+    RottaMesh* rotta = trovaRottaMesh(destinazione);
+    if(!rotta || rotta->costo == costoInfinitoMesh) return Errore::meshNessunaRotta;
+
+    if(titolo > valMaxTitolo) titolo = 0;
+
+    // [origine][destinazione][salti][titolo], poi il messaggio
+    uint8_t prefisso[4] = {mesh->indirizzo, destinazione, 0, titolo};
+    if(!mesh->codaLocale.aggiungi(messaggio, lunghezza, 0, prefisso, 4)) return Errore::inviaCodaPiena;
+    return Errore::ok;
+}
+
+
+const RFM69::StimaCollegamento* RFM69::stimaVicinoMesh(uint8_t indirizzo) {
+    VicinoMesh* vicino = mesh && indirizzo ? trovaVicinoMesh(indirizzo) : nullptr;
+    return vicino ? &vicino->stima : nullptr;
+}
+
+
+bool RFM69::rottaMesh(uint8_t destinazione, uint8_t& prossimoSalto, uint8_t& costo) {
+    RottaMesh* rotta = mesh ? trovaRottaMesh(destinazione) : nullptr;
+    if(!rotta || rotta->costo == costoInfinitoMesh) return false;
+    prossimoSalto = rotta->prossimoSalto;
+    costo = rotta->costo;
+    return true;
+}
+
+
+void RFM69::stampaTabelleMesh(HardwareSerial& serial) {
+
+    serial.print(F("Mesh, indirizzo "));
+    serial.println(mesh ? mesh->indirizzo : 0);
+    if(!mesh) return;
+
+    serial.println(F("vicini:"));
+    for(uint8_t i = 0; i < mesh->nrNodi; i++) {
+        const VicinoMesh& v = mesh->vicini[i];
+        if(!v.indirizzo) continue;
+        serial.print(F("  "));
+        serial.print(v.indirizzo);
+        serial.print(F("\trssi "));
+        serial.print(v.stima.rssi16 / 16);
+        serial.print(F("\tprr "));
+        serial.print(v.stima.prr);
+        serial.print(F("\tetx/16 "));
+        serial.print(v.stima.etx16);
+        serial.print(F("\tcosto "));
+        serial.println(costoCollegamentoMesh(v));
+    }
+
+    serial.println(F("rotte:"));
+    for(uint8_t i = 0; i < mesh->nrNodi; i++) {
+        const RottaMesh& r = mesh->rotte[i];
+        if(!r.destinazione) continue;
+        serial.print(F("  "));
+        serial.print(r.destinazione);
+        serial.print(F("\tvia "));
+        serial.print(r.prossimoSalto);
+        serial.print(F("\tcosto "));
+        if(r.costo == costoInfinitoMesh) serial.println(F("-"));
+        else serial.println(r.costo);
+    }
+}
+
+
+
+// ### 2. Ricezione ### //
+
+
+// Il buffer contiene il messaggio appena scaricato (valido). L'RSSI è già noto.
+//
+void RFM69::esaminaMessaggioMesh() {
+
+    Intestazione& intestazione = ultimoMessaggio.intestazione;
+    if(intestazione.bit.ack || intestazione.bit.titolo != titoloServizio) return;
+    uint8_t dimensione = ultimoMessaggio.dimensione;
+    if(dimensione < 3) return;
+
+    Servizio tipo = (Servizio)buffer[0];
+    if(tipo != Servizio::meshDati && tipo != Servizio::meshVettore) return;
+
+    // qualsiasi messaggio mesh, anche se destinato a un altro, dice che il
+    // mittente è un vicino e con che RSSI lo si sente
+    VicinoMesh* vicino = aggiornaVicinoMesh(buffer[1], ultimoMessaggio.rssi);
+    if(tipo != Servizio::meshDati) return;
+
+    // solo il destinatario del salto risponde
+    if(buffer[2] != mesh->indirizzo || dimensione < byteIntestazioneMesh) {
+        intestazione.bit.richiestaAck = 0;
+        return;
+    }
+
+    // ritrasmissione di un messaggio già accettato: basta l'ACK
+    uint8_t sequenza = buffer[3];
+    if(vicino && vicino->sequenzaValida && vicino->ultimaSequenza == sequenza) return;
+
+    uint8_t origine = buffer[4];
+    uint8_t destinazione = buffer[5];
+    uint8_t salti = buffer[6];
+    uint8_t titolo = buffer[7];
+    uint8_t* dati = buffer;
+
+    if(destinazione == mesh->indirizzo) {
+        // diventa un messaggio normale: [origine][messaggio...]
+        if(titolo > valMaxTitolo) titolo = 0;
+        uint8_t lunghezza = dimensione - byteIntestazioneMesh;
+        dati[0] = origine;
+        for(uint8_t i = 0; i < lunghezza; i++) dati[1 + i] = dati[byteIntestazioneMesh + i];
+        ultimoMessaggio.dimensione = lunghezza + 1;
+        intestazione.bit.titolo = titolo;
+        messaggioFiltrato = daFiltrare(intestazione);
+        messaggioMeshConsegnato = true;
+        // senza posto in coda non ci sarà ACK: la ritrasmissione va accettata
+        if(destinatoAllaCoda() && buffer.pieno()) return;
+        ++mesh->messaggiRicevuti;
+    }
+    else if(salti >= maxSaltiMesh) {
+        // probabilmente un ciclo tra rotte non ancora aggiornate
+        ++mesh->messaggiPersi;
+    }
+    else {
+        dati[6] = salti + 1;
+        if(!mesh->codaInoltro.aggiungi(dati + 4, dimensione - 4, 0)) {
+            intestazione.bit.richiestaAck = 0;
+            return;
+        }
+    }
+
+    if(vicino) {
+        vicino->ultimaSequenza = sequenza;
+        vicino->sequenzaValida = true;
+    }
+}
+
+
+// [tipo][mittente][nr rotte][destinazione, costo, prossimo salto...]
+//
+void RFM69::riceviVettoreMesh() {
+
+    if(!mesh || ultimoMessaggio.dimensione < 3) return;
+    uint8_t mittente = buffer[1];
+    uint8_t nrRotte = buffer[2];
+    if(ultimoMessaggio.dimensione < 3 + 3 * nrRotte) return;
+
+    VicinoMesh* vicino = trovaVicinoMesh(mittente);
+    if(!vicino) return;
+    uint8_t costoCollegamento = costoCollegamentoMesh(*vicino);
+
+    aggiornaRottaMesh(mittente, mittente, costoCollegamento);
+
+    for(uint8_t i = 0; i < nrRotte; i++) {
+        uint8_t destinazione = buffer[3 + 3 * i];
+        uint8_t costo = buffer[4 + 3 * i];
+        uint8_t prossimoSalto = buffer[5 + 3 * i];
+        // split horizon: una rotta che passa da questa radio non serve
+        if(destinazione == mesh->indirizzo || prossimoSalto == mesh->indirizzo) continue;
+        if(destinazione == 0 || destinazione == 255) continue;
+        uint16_t totale = (uint16_t)costo + costoCollegamento;
+        if(costo == costoInfinitoMesh || totale >= costoInfinitoMesh) totale = costoInfinitoMesh;
+        aggiornaRottaMesh(destinazione, mittente, totale);
+    }
+}
+
+
+
+// ### 3. Tabelle ### //
+
+
+RFM69::VicinoMesh* RFM69::trovaVicinoMesh(uint8_t indirizzo) {
+    for(uint8_t i = 0; i < mesh->nrNodi; i++) {
+        if(mesh->vicini[i].indirizzo == indirizzo) return mesh->vicini + i;
+    }
+    return nullptr;
+}
+
+
+RFM69::RottaMesh* RFM69::trovaRottaMesh(uint8_t destinazione) {
+    for(uint8_t i = 0; i < mesh->nrNodi; i++) {
+        if(mesh->rotte[i].destinazione == destinazione) return mesh->rotte + i;
+    }
+    return nullptr;
+}
+
+
+// Un vicino nuovo occupa una posizione libera: se non ce ne sono è ignorato
+// fino alla scadenza di uno di quelli noti
+//
+RFM69::VicinoMesh* RFM69::aggiornaVicinoMesh(uint8_t indirizzo, int8_t rssi) {
+
+    if(indirizzo == 0 || indirizzo == 255 || indirizzo == mesh->indirizzo) return nullptr;
+
+    VicinoMesh* vicino = trovaVicinoMesh(indirizzo);
+    if(!vicino) {
+        vicino = trovaVicinoMesh(0);
+        if(!vicino) return nullptr;
+        vicino->indirizzo = indirizzo;
+        vicino->sequenzaValida = false;
+        azzeraStima(vicino->stima);
+    }
+    registraRicezioneStima(vicino->stima, rssi);
+    return vicino;
+}
+
+
+// Regola di Bellman-Ford: la rotta attuale segue sempre il suo prossimo salto
+// (anche se peggiora), un'altra la sostituisce solo se costa meno
+//
+void RFM69::aggiornaRottaMesh(uint8_t destinazione, uint8_t prossimoSalto, uint8_t costo) {
+
+    RottaMesh* rotta = trovaRottaMesh(destinazione);
+
+    if(rotta && rotta->prossimoSalto == prossimoSalto) {
+        uint8_t differenza = costo > rotta->costo ? costo - rotta->costo : rotta->costo - costo;
+        if(differenza >= isteresiCostoMesh
+                || (costo == costoInfinitoMesh) != (rotta->costo == costoInfinitoMesh)) {
+            anticipaAnnuncioMesh();
+        }
+        // una rotta irraggiungibile resta nella tabella (ed è annunciata) solo
+        // fino alla sua scadenza
+        if(costo != costoInfinitoMesh || rotta->costo != costoInfinitoMesh) rotta->aggiornata = millis();
+        rotta->costo = costo;
+        return;
+    }
+
+    if(costo == costoInfinitoMesh) return;
+    if(rotta && rotta->costo != costoInfinitoMesh && costo + isteresiCostoMesh > rotta->costo) return;
+
+    if(!rotta) {
+        // una posizione libera o la rotta più costosa, se costa più di questa
+        rotta = trovaRottaMesh(0);
+        if(!rotta) {
+            for(uint8_t i = 0; i < mesh->nrNodi; i++) {
+                if(mesh->rotte[i].costo > costo && (!rotta || mesh->rotte[i].costo > rotta->costo)) {
+                    rotta = mesh->rotte + i;
+                }
+            }
+        }
+        if(!rotta) return;
+    }
+
+    rotta->destinazione = destinazione;
+    rotta->prossimoSalto = prossimoSalto;
+    rotta->costo = costo;
+    rotta->aggiornata = millis();
+    anticipaAnnuncioMesh();
+}
+
+
+void RFM69::invalidaRotteMesh(uint8_t prossimoSalto) {
+    for(uint8_t i = 0; i < mesh->nrNodi; i++) {
+        RottaMesh& rotta = mesh->rotte[i];
+        if(rotta.destinazione && rotta.prossimoSalto == prossimoSalto
+                && rotta.costo != costoInfinitoMesh) {
+            rotta.costo = costoInfinitoMesh;
+            rotta.aggiornata = millis();
+            anticipaAnnuncioMesh();
+        }
+    }
+}
+
+
+uint8_t RFM69::costoCollegamentoMesh(const VicinoMesh& vicino) {
+    uint16_t costo = vicino.stima.etx16 / 4;
+    int8_t rssi = vicino.stima.rssi16 / 16;
+    if(rssi < rssiMinimoMesh) costo += rssiMinimoMesh - rssi;
+    return costo < 100 ? costo : 100;
+}
+
+
+void RFM69::controllaScadenzeMesh() {
+
+    StatoMesh& m = *mesh;
+    uint32_t ora = millis();
+    uint32_t scadenza = 3UL * m.intervalloAnnunci;
+
+    for(uint8_t i = 0; i < m.nrNodi; i++) {
+        VicinoMesh& vicino = m.vicini[i];
+        if(vicino.indirizzo && ora - vicino.stima.ultimoContatto > scadenza) {
+            invalidaRotteMesh(vicino.indirizzo);
+            vicino.indirizzo = 0;
+        }
+    }
+
+    for(uint8_t i = 0; i < m.nrNodi; i++) {
+        RottaMesh& rotta = m.rotte[i];
+        if(!rotta.destinazione) continue;
+        if(rotta.costo == costoInfinitoMesh) {
+            // annunciata come irraggiungibile per un intervallo, poi dimenticata
+            if(ora - rotta.aggiornata > m.intervalloAnnunci) rotta.destinazione = 0;
+        }
+        else if(ora - rotta.aggiornata > scadenza) {
+            rotta.costo = costoInfinitoMesh;
+            rotta.aggiornata = ora;
+            anticipaAnnuncioMesh();
+        }
+    }
+}
+
+
+
+// ### 4. Code e annunci ### //
+
+
+void RFM69::anticipaAnnuncioMesh() {
+    uint32_t ora = millis();
+    uint32_t annuncio = ora + random(ritardoMinimoAnnuncioMs, ritardoMassimoAnnuncioMs);
+    if((int32_t)(mesh->prossimoAnnuncio - annuncio) > 0) mesh->prossimoAnnuncio = annuncio;
+}
+
+
+// Chiamata alla fine di controlla() quando la radio è libera
+//
+void RFM69::controllaMesh() {
+
+    StatoMesh& m = *mesh;
+    if(m.invioInCorso) return;
+
+    uint32_t ora = millis();
+    if(ora - m.ultimoControlloScadenze >= 1000) {
+        m.ultimoControlloScadenze = ora;
+        controllaScadenzeMesh();
+    }
+
+    if((int32_t)(ora - m.prossimoAnnuncio) >= 0) {
+        inviaVettoreMesh();
+        return;
+    }
+
+    if((int32_t)(ora - m.prossimoTentativo) >= 0) inviaDaCodaMesh();
+}
+
+
+void RFM69::inviaVettoreMesh() {
+
+    StatoMesh& m = *mesh;
+
+    // le rotte che entrano in un pacchetto lungo al massimo quanto un messaggio
+    // mesh (che entra nella coda di ricezione dei vicini, cfr. attivaMesh())
+    uint8_t massimo = m.lunghezzaMax + byteIntestazioneMesh;
+    if(63 - byteParitaFEC < massimo) massimo = 63 - byteParitaFEC;
+    uint8_t nrMassimo = (massimo - 3) / 3;
+
+    uint8_t* vettore = m.annuncio;
+    vettore[0] = (uint8_t)Servizio::meshVettore;
+    vettore[1] = m.indirizzo;
+    uint8_t nr = 0;
+    uint8_t i = 0;
+    for(; i < m.nrNodi && nr < nrMassimo; i++) {
+        const RottaMesh& rotta = m.rotte[(m.primaRottaAnnuncio + i) % m.nrNodi];
+        if(!rotta.destinazione) continue;
+        vettore[3 + 3 * nr] = rotta.destinazione;
+        vettore[4 + 3 * nr] = rotta.costo;
+        vettore[5 + 3 * nr] = rotta.prossimoSalto;
+        ++nr;
+    }
+    vettore[2] = nr;
+    // il prossimo annuncio comincia dalla prima rotta esclusa
+    m.primaRottaAnnuncio = i < m.nrNodi ? (m.primaRottaAnnuncio + i) % m.nrNodi : 0;
+
+    // programmato prima dell'invio, che richiama controlla()
+    m.ultimoAnnuncio = millis();
+    m.prossimoAnnuncio = m.ultimoAnnuncio + m.intervalloAnnunci - m.intervalloAnnunci / 4
+        + random(m.intervalloAnnunci / 2);
+
+    m.invioInCorso = true;
+    inviaServizio(vettore, 3 + 3 * nr, false);
+    m.invioInCorso = false;
+}
+
+
+// Le due code sono servite a turno. Ogni chiamata fa un solo tentativo; dopo
+// un ACK mancato il successivo aspetta un tempo casuale, più lungo a ogni
+// tentativo, per non collidere di nuovo con la stessa radio. Con il controllo
+// della congestione attivo si aspetta anche il suo intervallo.
+// Il turno non passa all'altra coda finché un messaggio aspetta di essere
+// ritrasmesso: il vicino ricorda solo l'ultima sequenza ricevuta da questa
+// radio, e un messaggio nuovo in mezzo farebbe passare la ritrasmissione per
+// un messaggio diverso (consegnato o inoltrato due volte).
+//
+void RFM69::inviaDaCodaMesh() {
+
+    StatoMesh& m = *mesh;
+    bool inoltro;
+    if(m.codaLocale.vuota() && m.codaInoltro.vuota()) return;
+    if(!invioConsentito()) return;
+    else if(m.tentativi[m.turnoInoltro]) inoltro = m.turnoInoltro;
+    else if(m.codaLocale.vuota()) inoltro = true;
+    else if(m.codaInoltro.vuota()) inoltro = false;
+    else inoltro = !m.turnoInoltro;
+    m.turnoInoltro = inoltro;
+
+    CodaInvio& coda = inoltro ? m.codaInoltro : m.codaLocale;
+    const uint8_t* voce = coda.primoMessaggio();
+    uint8_t lunghezza = coda.lunghezzaPrimo();
+
+    RottaMesh* rotta = trovaRottaMesh(voce[1]);
+    if(!rotta || rotta->costo == costoInfinitoMesh) {
+        coda.rimuoviPrimo();
+        m.tentativi[inoltro] = 0;
+        ++m.messaggiPersi;
+        return;
+    }
+    uint8_t prossimoSalto = rotta->prossimoSalto;
+
+    // le ritrasmissioni hanno lo stesso numero di sequenza
+    if(m.tentativi[inoltro] == 0) {
+        m.sequenzaInvio[inoltro] = m.prossimaSequenza++;
+        m.inizioSalto[inoltro] = micros();
+    }
+
+    // la voce è inviata direttamente dalla coda, dopo l'intestazione del salto
+    uint8_t prefisso[4] = {(uint8_t)Servizio::meshDati, m.indirizzo, prossimoSalto, m.sequenzaInvio[inoltro]};
+
+    m.invioInCorso = true;
+    if(inviaServizio(prefisso, 4, voce, lunghezza, true) != Errore::ok) {
+        m.invioInCorso = false;
+        return;
+    }
+    while(ackInSospeso());
+    m.invioInCorso = false;
+
+    bool ack = ricevutoAck();
+    ++m.tentativiSalto;
+    VicinoMesh* vicino = trovaVicinoMesh(prossimoSalto);
+    if(vicino) registraInvioStima(vicino->stima, ack);
+
+    if(ack) {
+        ++m.ackSalto;
+        m.sommaLatenzeSaltoUs += micros() - m.inizioSalto[inoltro];
+        ++m.saltiMisurati;
+        if(inoltro) ++m.messaggiInoltrati;
+        coda.rimuoviPrimo();
+        m.tentativi[inoltro] = 0;
+        return;
+    }
+
+    if(++m.tentativi[inoltro] >= maxTentativiMesh) {
+        // il vicino non risponde: le sue rotte sono inutilizzabili finché
+        // non si fa sentire di nuovo
+        coda.rimuoviPrimo();
+        m.tentativi[inoltro] = 0;
+        ++m.messaggiPersi;
+        invalidaRotteMesh(prossimoSalto);
+        return;
+    }
+    m.prossimoTentativo = millis() + random(10, 10 + 20 * m.tentativi[inoltro]);
+}
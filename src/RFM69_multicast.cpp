@@ -0,0 +1,367 @@
+/*! @file
+
+@brief Broadcast e multicast affidabile con NACK
+
+1. Mittente
+2. Riceventi
+3. NACK, ritrasmissioni e annunci
+4. Statistiche
+
+Lo stato dei gruppi è fornito dall'utente (`attivaMulticast()`); i broadcast
+non ne hanno bisogno. Nessun messaggio multicast richiede un ACK. I riceventi tengono per ogni
+gruppo il numero del prossimo messaggio atteso e una maschera dei 32
+precedenti che mancano; un buco nella numerazione (o un annuncio del mittente
+con un numero più alto) fa partire un NACK dopo un ritardo casuale. Il NACK
+contiene la maschera intera, così chi ne sente uno che chiede già tutti i
+suoi messaggi mancanti non invia il proprio.
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Mittente ### //
+
+
+void RFM69::attivaMulticast(StatoMulticast& stato, uint16_t finestraNack) {
+    StatoMulticast& m = stato;
+    for(uint8_t gruppo = 0; gruppo < nrGruppiMulticast; gruppo++) {
+        m.gruppi[gruppo] = GruppoMulticast();
+        m.sequenzaInvio[gruppo] = 0;
+        m.annunci[gruppo] = 0;
+        m.prossimoAnnuncio[gruppo] = 0;
+    }
+    m.gruppiAttivi = 0;
+    m.finestraNackMs = finestraNack;
+    m.dati = nullptr;
+    m.lunghezze = nullptr;
+    m.gruppiInviati = nullptr;
+    m.sequenze = nullptr;
+    m.titoli = nullptr;
+    m.ultimaRitrasmissione = nullptr;
+    m.lunghezzaMax = 0;
+    m.nrMessaggi = 0;
+    m.prossimaPosizione = 0;
+    m.daRitrasmettere = 0;
+    m.invioInCorso = false;
+    m.nackInviati = 0;
+    m.nackSoppressi = 0;
+    m.ritrasmissioni = 0;
+    m.messaggiPersi = 0;
+    multicast = &stato;
+}
+
+
+void RFM69::impostaMemoriaMulticast(uint8_t* dati, uint8_t* lunghezze, uint8_t* gruppi, uint8_t* sequenze,
+                                    uint8_t* titoli, uint32_t* ultimaRitrasmissione,
+                                    uint8_t lunghezzaMax, uint8_t nrMessaggi) {
+    StatoMulticast& m = *multicast;
+    for(uint8_t i = 0; i < nrMessaggi; i++) lunghezze[i] = 0;
+    m.dati = dati;
+    m.lunghezze = lunghezze;
+    m.gruppiInviati = gruppi;
+    m.sequenze = sequenze;
+    m.titoli = titoli;
+    m.ultimaRitrasmissione = ultimaRitrasmissione;
+    m.lunghezzaMax = lunghezzaMax;
+    m.nrMessaggi = nrMessaggi;
+}
+
+
+void RFM69::disattivaMulticast() {
+    multicast = nullptr;
+}
+
+
+int RFM69::inviaMulticast(uint8_t gruppo, const uint8_t messaggio[], uint8_t lunghezza, uint8_t titolo) {
+
+    if(!multicast || gruppo >= nrGruppiMulticast) return Errore::multicastGruppoNonValido;
+    StatoMulticast& m = *multicast;
+    if(lunghezza == 0) return Errore::inviaMessaggioVuoto;
+    if(m.dati && lunghezza > m.lunghezzaMax) return Errore::messaggioTroppoLungo;
+    if(titolo > valMaxTitolo) titolo = 0;
+
+    uint8_t sequenza = m.sequenzaInvio[gruppo];
+    m.invioInCorso = true;
+    int errore = inviaMessaggioMulticast(gruppo, sequenza, titolo, messaggio, lunghezza);
+    m.invioInCorso = false;
+    if(errore != Errore::ok) return errore;
+    ++m.sequenzaInvio[gruppo];
+
+    // senza memoria i messaggi persi non possono essere ritrasmessi
+    if(!m.dati) return Errore::ok;
+
+    uint8_t k = m.prossimaPosizione;
+    for(uint8_t i = 0; i < lunghezza; i++) m.dati[k * m.lunghezzaMax + i] = messaggio[i];
+    m.lunghezze[k] = lunghezza;
+    m.gruppiInviati[k] = gruppo;
+    m.sequenze[k] = sequenza;
+    m.titoli[k] = titolo;
+    // un NACK può arrivare subito
+    m.ultimaRitrasmissione[k] = millis() - m.finestraNackMs - 1;
+    m.daRitrasmettere &= ~(1UL << k);
+    m.prossimaPosizione = (k + 1) % m.nrMessaggi;
+
+    m.annunci[gruppo] = 2;
+    m.prossimoAnnuncio[gruppo] = millis() + 2UL * m.finestraNackMs;
+
+    return Errore::ok;
+}
+
+
+int RFM69::inviaBroadcast(const uint8_t messaggio[], uint8_t lunghezza, uint8_t titolo) {
+    if(lunghezza == 0) return Errore::inviaMessaggioVuoto;
+    if(titolo > valMaxTitolo) titolo = 0;
+    return inviaMessaggioMulticast(gruppoBroadcast, 0, titolo, messaggio, lunghezza);
+}
+
+
+int RFM69::inviaMessaggioMulticast(uint8_t gruppo, uint8_t sequenza, uint8_t titolo,
+                                   const uint8_t messaggio[], uint8_t lunghezza) {
+    if(lunghezza + byteIntestazioneMulticast > lungMaxMessEntrata) return Errore::messaggioTroppoLungo;
+    uint8_t intestazione[byteIntestazioneMulticast] = {(uint8_t)Servizio::multicast, gruppo, sequenza, titolo};
+    return inviaServizio(intestazione, byteIntestazioneMulticast, messaggio, lunghezza, false);
+}
+
+
+
+// ### 2. Riceventi ### //
+
+
+void RFM69::entraGruppo(uint8_t gruppo, uint16_t finestraNack) {
+    if(!multicast || gruppo >= nrGruppiMulticast) return;
+    multicast->gruppiAttivi |= 1 << gruppo;
+    multicast->gruppi[gruppo] = GruppoMulticast();
+    multicast->finestraNackMs = finestraNack;
+}
+
+
+void RFM69::esciGruppo(uint8_t gruppo) {
+    if(!multicast || gruppo >= nrGruppiMulticast) return;
+    multicast->gruppiAttivi &= ~(1 << gruppo);
+}
+
+
+// Il buffer contiene il messaggio appena scaricato (valido). L'"ora" di
+// ricezione è già calcolata sulla lunghezza in aria, con l'intestazione.
+// I broadcast sono ricevuti anche senza multicast attivo.
+//
+void RFM69::esaminaMessaggioMulticast() {
+
+    Intestazione& intestazione = ultimoMessaggio.intestazione;
+    if(intestazione.bit.ack || intestazione.bit.titolo != titoloServizio) return;
+    if(ultimoMessaggio.dimensione < byteIntestazioneMulticast) return;
+    if(buffer[0] != (uint8_t)Servizio::multicast) return;
+
+    // nessuno risponde a un messaggio con più destinatari
+    intestazione.bit.richiestaAck = 0;
+
+    uint8_t gruppo = buffer[1];
+    uint8_t sequenza = buffer[2];
+    uint8_t titolo = buffer[3];
+
+    GruppoMulticast* g = nullptr;
+    uint8_t posizione = 0;
+    if(gruppo != gruppoBroadcast) {
+        if(!inGruppo(gruppo)) return;
+        g = multicast->gruppi + gruppo;
+        // il primo messaggio fissa la numerazione (non mancano i precedenti)
+        if(!g->sequenzaNota) {
+            g->sequenzaNota = true;
+            g->prossimaSequenza = sequenza;
+            g->mancanti = 0;
+        }
+        if((uint8_t)(sequenza - g->prossimaSequenza) < 128) {
+            avanzaSequenzaMulticast(gruppo, sequenza + 1);
+        }
+        // già ricevuto, o troppo vecchio per saperlo
+        posizione = g->prossimaSequenza - 1 - sequenza;
+        if(posizione >= 32 || !((g->mancanti >> posizione) & 1)) return;
+    }
+
+    // diventa un messaggio normale
+    if(titolo > valMaxTitolo) titolo = 0;
+    uint8_t lunghezza = ultimoMessaggio.dimensione - byteIntestazioneMulticast;
+    uint8_t* dati = buffer;
+    for(uint8_t i = 0; i < lunghezza; i++) dati[i] = dati[byteIntestazioneMulticast + i];
+    ultimoMessaggio.dimensione = lunghezza;
+    intestazione.bit.titolo = titolo;
+    messaggioFiltrato = daFiltrare(intestazione);
+
+    // un messaggio che non entra nella coda sarà richiesto di nuovo
+    if(g && !(destinatoAllaCoda() && buffer.pieno())) {
+        g->mancanti &= ~(1UL << posizione);
+        if(!g->mancanti) g->tentativiNack = 0;
+    }
+}
+
+
+bool RFM69::inGruppo(uint8_t gruppo) {
+    return multicast && gruppo < nrGruppiMulticast && ((multicast->gruppiAttivi >> gruppo) & 1);
+}
+
+
+void RFM69::avanzaSequenzaMulticast(uint8_t gruppo, uint8_t nuovaProssima) {
+
+    GruppoMulticast& g = multicast->gruppi[gruppo];
+    bool nessunoMancante = g.mancanti == 0;
+
+    uint8_t nuovi = nuovaProssima - g.prossimaSequenza;
+    for(uint8_t i = 0; i < nuovi; i++) {
+        // un messaggio che esce dalla maschera non può più essere richiesto
+        if(g.mancanti & (1UL << 31)) ++multicast->messaggiPersi;
+        g.mancanti = (g.mancanti << 1) | 1;
+    }
+    g.prossimaSequenza = nuovaProssima;
+
+    if(nessunoMancante) {
+        g.prossimoNack = millis() + random(multicast->finestraNackMs + 1);
+        g.tentativiNack = 0;
+    }
+}
+
+
+// [tipo][gruppo][sequenza dell'ultimo messaggio inviato]
+//
+void RFM69::riceviStatoMulticast() {
+
+    if(ultimoMessaggio.dimensione < 3) return;
+    uint8_t gruppo = buffer[1];
+    uint8_t ultimo = buffer[2];
+    if(!inGruppo(gruppo)) return;
+
+    GruppoMulticast& g = multicast->gruppi[gruppo];
+    if(!g.sequenzaNota) {
+        // radio entrata nel gruppo dopo l'invio: i messaggi precedenti non la riguardano
+        g.sequenzaNota = true;
+        g.prossimaSequenza = ultimo + 1;
+        g.mancanti = 0;
+        return;
+    }
+    uint8_t avanti = (uint8_t)(ultimo + 1) - g.prossimaSequenza;
+    if(avanti > 0 && avanti < 128) avanzaSequenzaMulticast(gruppo, ultimo + 1);
+}
+
+
+
+// ### 3. NACK, ritrasmissioni e annunci ### //
+
+
+// [tipo][gruppo][prossima sequenza][mancanti (4 bytes)]
+//
+void RFM69::riceviNackMulticast() {
+
+    if(!multicast || ultimoMessaggio.dimensione < 7) return;
+    StatoMulticast& m = *multicast;
+    uint8_t gruppo = buffer[1];
+    uint8_t prossima = buffer[2];
+    uint32_t mancanti = (uint32_t)buffer[3] | (uint32_t)buffer[4] << 8
+        | (uint32_t)buffer[5] << 16 | (uint32_t)buffer[6] << 24;
+
+    // Mittente: segna i messaggi da ritrasmettere, tranne quelli appena
+    // ritrasmessi (NACK di chi non aveva ancora sentito la ritrasmissione)
+    for(uint8_t k = 0; m.dati && k < m.nrMessaggi; k++) {
+        if(!m.lunghezze[k] || m.gruppiInviati[k] != gruppo) continue;
+        uint8_t posizione = prossima - 1 - m.sequenze[k];
+        if(posizione >= 32 || !((mancanti >> posizione) & 1)) continue;
+        if(millis() - m.ultimaRitrasmissione[k] > m.finestraNackMs) m.daRitrasmettere |= 1UL << k;
+    }
+
+    // Riceventi: soppressione, se il NACK chiede già tutti i messaggi mancanti
+    if(!inGruppo(gruppo)) return;
+    GruppoMulticast& g = m.gruppi[gruppo];
+    if(!g.mancanti || g.prossimaSequenza != prossima || (g.mancanti & ~mancanti)) return;
+    ++m.nackSoppressi;
+    ++g.tentativiNack;
+    g.prossimoNack = millis() + 2UL * m.finestraNackMs + random(m.finestraNackMs + 1);
+}
+
+
+// Chiamata alla fine di controlla() quando la radio è libera e il multicast è
+// attivo. Un solo invio per chiamata: ritrasmissioni, poi annunci, poi NACK.
+//
+void RFM69::controllaMulticast() {
+
+    StatoMulticast& m = *multicast;
+    if(m.invioInCorso) return;
+    uint32_t ora = millis();
+
+    if(m.daRitrasmettere) {
+        uint8_t k = 0;
+        while(!((m.daRitrasmettere >> k) & 1)) ++k;
+        m.daRitrasmettere &= ~(1UL << k);
+        m.ultimaRitrasmissione[k] = ora;
+        ++m.ritrasmissioni;
+        m.invioInCorso = true;
+        inviaMessaggioMulticast(m.gruppiInviati[k], m.sequenze[k], m.titoli[k],
+                                m.dati + k * m.lunghezzaMax, m.lunghezze[k]);
+        m.invioInCorso = false;
+        return;
+    }
+
+    for(uint8_t gruppo = 0; gruppo < nrGruppiMulticast; gruppo++) {
+        if(!m.annunci[gruppo] || (int32_t)(ora - m.prossimoAnnuncio[gruppo]) < 0) continue;
+        --m.annunci[gruppo];
+        m.prossimoAnnuncio[gruppo] = ora + 4UL * m.finestraNackMs;
+        uint8_t stato[3] = {(uint8_t)Servizio::statoMulticast, gruppo,
+                            (uint8_t)(m.sequenzaInvio[gruppo] - 1)};
+        m.invioInCorso = true;
+        inviaServizio(stato, sizeof(stato), false);
+        m.invioInCorso = false;
+        return;
+    }
+
+    for(uint8_t gruppo = 0; gruppo < nrGruppiMulticast; gruppo++) {
+        GruppoMulticast& g = m.gruppi[gruppo];
+        if(!((m.gruppiAttivi >> gruppo) & 1) || !g.mancanti) continue;
+        if((int32_t)(ora - g.prossimoNack) < 0) continue;
+
+        if(g.tentativiNack >= maxTentativiNack) {
+            // il mittente non risponde o non ha più questi messaggi
+            for(uint8_t i = 0; i < 32; i++) {
+                if((g.mancanti >> i) & 1) ++m.messaggiPersi;
+            }
+            g.mancanti = 0;
+            g.tentativiNack = 0;
+            continue;
+        }
+
+        uint8_t nack[7] = {(uint8_t)Servizio::nackMulticast, gruppo, g.prossimaSequenza,
+                           (uint8_t)g.mancanti, (uint8_t)(g.mancanti >> 8),
+                           (uint8_t)(g.mancanti >> 16), (uint8_t)(g.mancanti >> 24)};
+        ++g.tentativiNack;
+        ++m.nackInviati;
+        // la ritrasmissione arriva dopo il ritardo dei NACK degli altri
+        g.prossimoNack = ora + 2UL * m.finestraNackMs + random(m.finestraNackMs + 1);
+        m.invioInCorso = true;
+        inviaServizio(nack, sizeof(nack), false);
+        m.invioInCorso = false;
+        return;
+    }
+}
+
+
+
+// ### 4. Statistiche ### //
+
+
+uint16_t RFM69::nrNackInviati() {
+    return multicast ? multicast->nackInviati : 0;
+}
+
+
+uint16_t RFM69::nrNackSoppressi() {
+    return multicast ? multicast->nackSoppressi : 0;
+}
+
+
+uint16_t RFM69::nrRitrasmissioniMulticast() {
+    return multicast ? multicast->ritrasmissioni : 0;
+}
+
+
+uint16_t RFM69::nrMessaggiPersiMulticast() {
+    return multicast ? multicast->messaggiPersi : 0;
+}
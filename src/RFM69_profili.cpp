@@ -0,0 +1,101 @@
+/*! @file
+
+@brief Profili radio: gruppi di impostazioni applicati con poche scritture
+
+creaProfilo() è in RFM69_inizializzazione.cpp, l'unico file che conosce il
+file di impostazione.
+*/
+
+#include "RFM69.h"
+#include "RFM69_registri.h"
+
+#include <Arduino.h>
+
+
+
+// Gruppi di registri adiacenti nell'immagine di un profilo, nell'ordine
+//
+static const struct {
+    uint8_t indirizzo;
+    uint8_t nr;
+} gruppiProfilo[] = {
+    {RFM69_02_DATA_MODUL, 5},   // DataModul, BitRate, Fdev
+    {RFM69_19_RX_BW, 2},        // RxBw, AfcBw
+    {RFM69_2C_PREAMBLE_MSB, 11} // Preamble, SyncConfig, SyncValue 1 - 8
+};
+
+
+
+int RFM69::creaProfilo(ProfiloRadio& profilo, const char* nome, uint32_t bitRate,
+                       uint32_t freqDev, uint16_t preambolo) {
+
+    // gli stessi vincoli che Configurazione verifica in fase di compilazione
+    if(!vincoliFSK(bitRate, freqDev)) return Errore::errore;
+    uint8_t valRxBw = valoreRxBw(bandaNecessaria(bitRate, freqDev));
+    if(valRxBw == 0xFF) return Errore::errore;
+
+    riempiProfilo(profilo, nome, valoreBitRate(bitRate), valoreFreqDev(freqDev), valRxBw, preambolo);
+    return Errore::ok;
+}
+
+
+// Legge i registri uno alla volta: leggiSequenza() di SC18IS602B rilegge lo
+// stesso indirizzo (va bene solo per la FIFO)
+//
+void RFM69::salvaProfilo(ProfiloRadio& profilo, const char* nome) {
+    profilo.nome = nome;
+    uint8_t k = 0;
+    for(auto& gruppo : gruppiProfilo) {
+        for(uint8_t i = 0; i < gruppo.nr; i++) {
+            profilo.registri[k++] = bus->leggiRegistro(gruppo.indirizzo + i);
+        }
+    }
+}
+
+
+int RFM69::applicaProfilo(const ProfiloRadio& profilo) {
+
+    static_assert(RFM69_02_DATA_MODUL + 5 == RFM69_07_FRF_MSB
+        && RFM69_2C_PREAMBLE_MSB + 11 == RFM69_37_PACKET_CONFIG_1,
+        "i gruppi di registri dei profili devono essere adiacenti");
+
+    if(!radioPronta(false)) return Errore::profiloRadioOccupata;
+
+    uint32_t inizio = micros();
+
+    // i registri di modulazione si scrivono in standby
+    disattivaAutoModes();
+    cambiaModalita(Modalita::standby, true);
+
+    // per ogni gruppo una sola sequenza, dal primo all'ultimo registro diverso
+    uint8_t k = 0;
+    for(auto& gruppo : gruppiProfilo) {
+        uint8_t primo = 0xFF, ultimo = 0;
+        for(uint8_t i = 0; i < gruppo.nr; i++) {
+            if(!profiloRadioAttivo || profiloRadioAttivo->registri[k + i] != profilo.registri[k + i]) {
+                if(primo == 0xFF) primo = i;
+                ultimo = i;
+            }
+        }
+        if(primo != 0xFF) {
+            bus->scriviSequenza(gruppo.indirizzo + primo, ultimo - primo + 1, profilo.registri + k + primo);
+        }
+        k += gruppo.nr;
+    }
+
+    durataCambioProfiloUs = micros() - inizio;
+    profiloRadioAttivo = &profilo;
+
+    // variabili che dipendono dai registri appena scritti
+    uint16_t valBitRate = ((uint16_t)profilo.registri[1] << 8) | profilo.registri[2];
+    if(valBitRate) bitRateCorrente = 32000000UL / valBitRate;
+    uint8_t syncConfig = profilo.registri[9];
+    byteSincronizzazione = (((uint16_t)profilo.registri[7] << 8) | profilo.registri[8])
+        + ((syncConfig & 0x80) ? ((syncConfig >> 3) & 0x07) + 1 : 0);
+    profiloModem = nessunProfilo;
+
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+
+    return Errore::ok;
+}
@@ -0,0 +1,217 @@
+/*! @file
+
+@brief Sincronizzazione del tempo tra le radio
+
+1. Radice
+2. Altri nodi
+3. Orologio globale
+
+Il protocollo è simile a FTSP (Flooding Time Synchronization Protocol), ma
+l'"ora" di invio di un beacon non è scritta nel beacon stesso durante la
+trasmissione (la FIFO è riempita prima): è inviata con il beacon successivo.
+Entrambe le "ore" si riferiscono alla fine della sync word (cfr.
+`tempoUltimoInvioUs()` e `tempoRicezioneUs()`), quindi non dipendono dalla
+latenza di avvio della trasmissione né dalla durata del pacchetto.
+
+La tabella dei beacon e le stime sono nello stato fornito dall'utente
+(`StatoSincronizzazione`).
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+void RFM69::attivaSincronizzazione(bool radice, StatoSincronizzazione& stato, uint16_t intervallo) {
+    disattivaSincronizzazione();
+    StatoSincronizzazione& s = stato;
+    s.ruolo = radice ? RuoloSincronizzazione::radice : RuoloSincronizzazione::nodo;
+    s.nrPuntiRegistrati = 0;
+    s.prossimoPunto = 0;
+    s.localeRiferimento = 0;
+    s.scartoRiferimento = 0;
+    s.deriva = 0;
+    s.numeroBeacon = 0;
+    s.tempoInvioBeaconPrecedente = 0;
+    s.beaconPrecedenteInviato = false;
+    s.intervalloBeacon = intervallo;
+    // il primo beacon parte alla prossima chiamata a controlla()
+    s.tempoUltimoBeacon = millis() - intervallo;
+    s.numeroUltimoBeacon = 0;
+    s.ricezioneUltimoBeacon = 0;
+    s.ricevutoBeacon = false;
+    sincronizzazione = &stato;
+}
+
+
+void RFM69::disattivaSincronizzazione() {
+    sincronizzazione = nullptr;
+}
+
+
+
+// ### 1. Radice ### //
+
+
+int RFM69::inviaBeaconSincronizzazione() {
+
+    if(!sincronizzazione || sincronizzazione->ruolo != RuoloSincronizzazione::radice) {
+        return Errore::errore;
+    }
+    StatoSincronizzazione& s = *sincronizzazione;
+
+    // Se il beacon precedente non è stato inviato il numero salta di uno, così
+    // i nodi non associano l'"ora" contenuta in questo beacon all'ultimo
+    // beacon che hanno ricevuto
+    if(!s.beaconPrecedenteInviato) ++s.numeroBeacon;
+
+    uint8_t beacon[6];
+    beacon[0] = (uint8_t)Servizio::sincronizzazione;
+    beacon[1] = s.numeroBeacon;
+    for(uint8_t i = 0; i < 4; i++) beacon[2 + i] = s.tempoInvioBeaconPrecedente >> (8 * i);
+
+    // chiamata anche da controlla(): evita di inviare un altro beacon
+    // mentre si aspetta la radio
+    s.tempoUltimoBeacon = millis();
+
+    int errore = inviaServizio(beacon, 6, false);
+    s.beaconPrecedenteInviato = false;
+    if(errore) return errore;
+
+    // L'"ora" di invio è nota solo alla fine della trasmissione
+    if(!radioPronta(true)) return Errore::inviaTimeout;
+    s.tempoInvioBeaconPrecedente = tempoUltimoInvioUs();
+    ++s.numeroBeacon;
+    s.beaconPrecedenteInviato = true;
+
+    return Errore::ok;
+}
+
+
+// Chiamata sulla radice. Con il salto di frequenza i beacon partono solo dal
+// canale di partenza, dove aspettano i nodi non sincronizzati (l'intervallo
+// si allunga fino al prossimo passaggio sul canale)
+//
+void RFM69::controllaBeaconSincronizzazione() {
+    if(nrCanaliFHSS && posizioneFHSS() != 0) return;
+    StatoSincronizzazione& s = *sincronizzazione;
+    if(s.intervalloBeacon && millis() - s.tempoUltimoBeacon >= s.intervalloBeacon) {
+        inviaBeaconSincronizzazione();
+    }
+}
+
+
+
+// ### 2. Altri nodi ### //
+
+
+// Il beacon numero n porta l'"ora" di invio del beacon n-1: se quest'ultimo è
+// stato ricevuto si ottiene un punto (ora locale, ora globale)
+//
+void RFM69::riceviBeaconSincronizzazione() {
+
+    if(!sincronizzazione || sincronizzazione->ruolo != RuoloSincronizzazione::nodo) return;
+    if(ultimoMessaggio.dimensione < 6) return;
+    StatoSincronizzazione& s = *sincronizzazione;
+
+    uint8_t numero = buffer[1];
+    uint32_t globalePrecedente = 0;
+    for(uint8_t i = 0; i < 4; i++) globalePrecedente |= (uint32_t)buffer[2 + i] << (8 * i);
+
+    if(s.ricevutoBeacon && (uint8_t)(s.numeroUltimoBeacon + 1) == numero) {
+        aggiungiPuntoSincronizzazione(s.ricezioneUltimoBeacon,
+                                      (int32_t)(globalePrecedente - s.ricezioneUltimoBeacon));
+    }
+
+    s.numeroUltimoBeacon = numero;
+    s.ricezioneUltimoBeacon = ultimoMessaggio.tempoRicezioneUs;
+    s.ricevutoBeacon = true;
+}
+
+
+// Regressione lineare dello scarto in funzione dell'"ora" locale. Per non
+// perdere precisione con i float i calcoli sono fatti rispetto all'ultimo
+// punto, così i valori restano piccoli (al massimo qualche minuto e qualche
+// millisecondo rispettivamente).
+//
+void RFM69::aggiungiPuntoSincronizzazione(uint32_t locale, int32_t scarto) {
+
+    StatoSincronizzazione& s = *sincronizzazione;
+
+    // un punto incompatibile con la stima attuale cancella la tabella
+    if(sincronizzato()) {
+        int32_t errore = (int32_t)(localeInGlobale(locale) - locale) - scarto;
+        if(errore > (int32_t)massimoErroreSincronizzazioneUs
+                || errore < -(int32_t)massimoErroreSincronizzazioneUs) {
+            s.nrPuntiRegistrati = 0;
+            s.prossimoPunto = 0;
+        }
+    }
+
+    s.punti[s.prossimoPunto].locale = locale;
+    s.punti[s.prossimoPunto].scarto = scarto;
+    s.prossimoPunto = (s.prossimoPunto + 1) % nrPuntiSincronizzazione;
+    if(s.nrPuntiRegistrati < nrPuntiSincronizzazione) ++s.nrPuntiRegistrati;
+
+    float mediaX = 0, mediaY = 0;
+    for(uint8_t i = 0; i < s.nrPuntiRegistrati; i++) {
+        mediaX += (int32_t)(s.punti[i].locale - locale);
+        mediaY += s.punti[i].scarto - scarto;
+    }
+    mediaX /= s.nrPuntiRegistrati;
+    mediaY /= s.nrPuntiRegistrati;
+
+    float sxy = 0, sxx = 0;
+    for(uint8_t i = 0; i < s.nrPuntiRegistrati; i++) {
+        float dx = (int32_t)(s.punti[i].locale - locale) - mediaX;
+        float dy = (s.punti[i].scarto - scarto) - mediaY;
+        sxy += dx * dy;
+        sxx += dx * dx;
+    }
+
+    // la retta passa per il punto medio
+    s.localeRiferimento = locale + (int32_t)mediaX;
+    s.scartoRiferimento = scarto + (int32_t)mediaY;
+    s.deriva = sxx > 0 ? sxy / sxx : 0;
+}
+
+
+
+// ### 3. Orologio globale ### //
+
+
+bool RFM69::sincronizzato() {
+    if(!sincronizzazione) return false;
+    if(sincronizzazione->ruolo == RuoloSincronizzazione::radice) return true;
+    // tre beacon consecutivi danno due punti, cioè anche una stima della deriva
+    return sincronizzazione->nrPuntiRegistrati >= 2;
+}
+
+
+uint32_t RFM69::tempoGlobaleUs() {
+    return localeInGlobale(micros());
+}
+
+
+uint32_t RFM69::localeInGlobale(uint32_t localeUs) {
+    if(!sincronizzazione || sincronizzazione->ruolo != RuoloSincronizzazione::nodo
+            || sincronizzazione->nrPuntiRegistrati == 0) return localeUs;
+    StatoSincronizzazione& s = *sincronizzazione;
+    int32_t distanza = localeUs - s.localeRiferimento;
+    return localeUs + s.scartoRiferimento + (int32_t)(s.deriva * distanza);
+}
+
+
+// L'inversione esatta richiederebbe una divisione per (1 + deriva); con una
+// deriva di qualche decina di ppm basta correggere una volta la stima
+//
+uint32_t RFM69::globaleInLocale(uint32_t globaleUs) {
+    uint32_t locale = globaleUs - (sincronizzazione ? sincronizzazione->scartoRiferimento : 0);
+    return locale - (localeInGlobale(locale) - globaleUs);
+}
+
+
+float RFM69::derivaPpm() {
+    return sincronizzazione ? sincronizzazione->deriva * 1e6f : 0;
+}
@@ -0,0 +1,146 @@
+/*! @file
+
+@brief Sniffer: registrazione di tutti i pacchetti in formato pcap
+
+1. Attivazione
+2. Pacchetti
+
+Lo sniffer usa il percorso normale di ricezione (ISR, AutoModes, controlla())
+con tre differenze: PayloadReady arriva anche con il CRC errato
+(CrcAutoClearOff), il pacchetto è scaricato per intero senza filtri né FEC, e
+ultimoMessaggio è segnato come non valido dopo la registrazione, così non
+riceve ACK e non arriva all'applicazione.
+*/
+
+#include "RFM69.h"
+#include "RFM69_registri.h"
+
+#include <Arduino.h>
+
+
+
+// Scrive un intero little endian di 2 o 4 bytes (pcap usa l'ordine della
+// macchina che scrive: il magic number permette al lettore di riconoscerlo)
+//
+static void scriviLE(HardwareSerial& uscita, uint32_t valore, uint8_t bytes) {
+    for(uint8_t i = 0; i < bytes; i++) uscita.write((uint8_t)(valore >> (8 * i)));
+}
+
+
+
+// ### 1. Attivazione ### //
+
+
+int RFM69::attivaSniffer(HardwareSerial& uscita) {
+
+    if(snifferAttivo) return Errore::ok;
+    if(!radioPronta(false)) return Errore::snifferRadioOccupata;
+
+    // CrcAutoClearOff: PayloadReady anche con il CRC errato
+    regPacketConfig1Sniffer = bus->leggiRegistro(RFM69_37_PACKET_CONFIG_1);
+    bus->scriviRegistro(RFM69_37_PACKET_CONFIG_1, regPacketConfig1Sniffer | (1 << 3));
+    // AfcAutoclearOn, AfcAutoOn: errore di frequenza di ogni pacchetto
+    regAfcFeiSniffer = bus->leggiRegistro(RFM69_1E_AFC_FEI);
+    bus->scriviRegistro(RFM69_1E_AFC_FEI, (1 << 3) | (1 << 2));
+
+    uscitaSniffer = &uscita;
+    snifferAttivo = true;
+    pacchettiSniffer = 0;
+    pacchettiErratiSniffer = 0;
+    tempoSnifferUs = localeInGlobale(micros());
+    ultimoTempoSniffer = (uint32_t)tempoSnifferUs;
+
+    // Intestazione globale: magic number (risoluzione in us), versione 2.4,
+    // fuso orario e precisione, lunghezza massima di un record, tipo di
+    // collegamento
+    scriviLE(uscita, 0xA1B2C3D4, 4);
+    scriviLE(uscita, 2, 2);
+    scriviLE(uscita, 4, 2);
+    scriviLE(uscita, 0, 4);
+    scriviLE(uscita, 0, 4);
+    scriviLE(uscita, 12 + 255, 4);
+    scriviLE(uscita, tipoCollegamentoPcap, 4);
+
+    // la condizione di AutoModes per la ricezione dipende dallo sniffer
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+
+    return Errore::ok;
+}
+
+
+void RFM69::disattivaSniffer() {
+
+    if(!snifferAttivo) return;
+    snifferAttivo = false;
+
+    bus->scriviRegistro(RFM69_37_PACKET_CONFIG_1, regPacketConfig1Sniffer);
+    bus->scriviRegistro(RFM69_1E_AFC_FEI, regAfcFeiSniffer);
+
+    if(stato == Stato::passivo) {
+        richiestaModalitaDefaultAppenaPossibile = true;
+        controlla();
+    }
+}
+
+
+
+// ### 2. Pacchetti ### //
+
+
+void RFM69::scaricaMessaggioSniffer() {
+
+    // CrcOk resta valido fino a quando la FIFO non è vuota
+    crcOkSniffer = bus->leggiRegistro(RFM69_28_IRQ_FLAGS_2) & RFM69_FLAGS_2_CRC_OK;
+    lunghezzaSniffer = bus->leggiRegistro(RFM69_00_FIFO);
+
+    scaricatiSniffer = lunghezzaSniffer;
+    if(scaricatiSniffer > buffer.lunghezzaPosizione()) scaricatiSniffer = buffer.lunghezzaPosizione();
+    if(scaricatiSniffer) bus->leggiSequenza(RFM69_00_FIFO, scaricatiSniffer, buffer);
+    // il resto di un pacchetto troncato è scartato
+    if(scaricatiSniffer < lunghezzaSniffer) {
+        bus->scriviRegistro(RFM69_28_IRQ_FLAGS_2, RFM69_FLAGS_2_FIFO_OVERRUN);
+    }
+
+    ultimoMessaggio.dimensione = scaricatiSniffer;
+    if(scaricatiSniffer) ultimoMessaggio.intestazione.byte = buffer[0];
+}
+
+
+void RFM69::registraPacchettoSniffer() {
+
+    HardwareSerial& uscita = *uscitaSniffer;
+
+    // tempo esteso a 64 bit con la differenza dall'ultimo pacchetto
+    uint32_t tempo = localeInGlobale(ultimoMessaggio.tempoRicezioneUs);
+    tempoSnifferUs += (uint32_t)(tempo - ultimoTempoSniffer);
+    ultimoTempoSniffer = tempo;
+
+    int16_t afc = (int16_t)(((uint16_t)bus->leggiRegistro(RFM69_1F_AFC_MSB) << 8)
+                            | bus->leggiRegistro(RFM69_20_AFC_LSB));
+    // frequenza in uso durante la ricezione
+    int32_t frf = frfNominale + correzioneTemperatura + correzioneApplicata;
+    uint32_t frequenza = ((uint64_t)frf * 15625) / 256;
+
+    // Record: secondi, microsecondi, lunghezza salvata e originale
+    scriviLE(uscita, tempoSnifferUs / 1000000, 4);
+    scriviLE(uscita, tempoSnifferUs % 1000000, 4);
+    scriviLE(uscita, 12 + scaricatiSniffer, 4);
+    scriviLE(uscita, 12 + lunghezzaSniffer, 4);
+
+    // Intestazione del collegamento (cfr. RFM69.h, gruppo Sniffer)
+    uscita.write((uint8_t)1);
+    uscita.write((uint8_t)(crcOkSniffer ? 1 : 0));
+    uscita.write((uint8_t)ultimoRssi);
+    uscita.write(byteParitaFEC);
+    scriviLE(uscita, (uint32_t)hzDaFstep(afc), 4);
+    scriviLE(uscita, frequenza, 4);
+
+    uscita.write((const uint8_t*)buffer, scaricatiSniffer);
+
+    ++pacchettiSniffer;
+    if(!crcOkSniffer) ++pacchettiErratiSniffer;
+
+    // il pacchetto non va oltre: niente ACK, coda o funzioni di gestione
+    ultimoMessaggio.valido = false;
+}
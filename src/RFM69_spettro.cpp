@@ -0,0 +1,155 @@
+/*! @file
+
+@brief Analisi dello spettro: misura del rumore su una serie di canali
+
+1. Misura
+2. Analisi completa e in sottofondo
+
+Una misura porta la radio sul canale da misurare, in ricezione, e aspetta una
+nuova lettura dell'RSSI (RssiStart / RssiDone nel registro RssiConfig). Poi
+la radio torna alla frequenza precedente (nominale, cioè del file di
+impostazione o del canale attuale del salto di frequenza, più le correzioni)
+e alla sua modalità default.
+*/
+
+#include "RFM69.h"
+#include "RFM69_registri.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Misura ### //
+
+
+int8_t RFM69::misuraRssiCanale(uint32_t frequenza) {
+
+    uint32_t val = valoreFrequenza(frequenza);
+    uint8_t frf[3] = {(uint8_t)(val >> 16), (uint8_t)(val >> 8), (uint8_t)val};
+
+    disattivaAutoModes();
+    cambiaModalita(Modalita::standby, true);
+    bus->scriviSequenza(RFM69_07_FRF_MSB, 3, frf);
+
+    // un messaggio ricevuto sul canale misurato sarebbe perso al ritorno in
+    // standby: l'ISR non deve considerarlo
+    stato = Stato::misuraRssi;
+    cambiaModalita(Modalita::rx, true);
+
+    // RssiStart: una misura completa dopo l'avvio del ricevitore
+    bus->scriviRegistro(RFM69_23_RSSI_CONFIG, 0x01);
+    uint32_t inizio = micros();
+    while(!(bus->leggiRegistro(RFM69_23_RSSI_CONFIG) & 0x02)
+            && micros() - inizio < timeoutMisuraRssiUs);
+    int8_t rssi = -(bus->leggiRegistro(RFM69_24_RSSI_VALUE) / 2);
+
+    // la frequenza precedente è quella dello stato del driver (non riletta dai
+    // registri: leggiSequenza() di SC18IS602B rilegge lo stesso indirizzo);
+    // la modalità default è ripristinata dal chiamante dopo l'ultima misura
+    scriviFrequenza(false);
+    stato = Stato::passivo;
+
+    return rssi;
+}
+
+
+void RFM69::registraMisuraSpettro(CanaleSpettro& canale, int8_t rssi) {
+    // in sottofondo le misure continuano: dimezzare somma e numero mantiene la media
+    if(canale.nrMisure == 0xFFFF) {
+        canale.somma /= 2;
+        canale.nrMisure /= 2;
+    }
+    if(canale.nrMisure == 0 || rssi < canale.minimo) canale.minimo = rssi;
+    if(canale.nrMisure == 0 || rssi > canale.massimo) canale.massimo = rssi;
+    canale.somma += rssi;
+    ++canale.nrMisure;
+}
+
+
+uint8_t RFM69::canaleMenoDisturbato(const CanaleSpettro canali[], uint8_t nrCanali) {
+    uint8_t migliore = 0xFF;
+    for(uint8_t i = 0; i < nrCanali; i++) {
+        if(canali[i].nrMisure == 0) continue;
+        if(migliore == 0xFF
+                || canali[i].media() < canali[migliore].media()
+                || (canali[i].media() == canali[migliore].media()
+                    && canali[i].massimo < canali[migliore].massimo)) {
+            migliore = i;
+        }
+    }
+    return migliore;
+}
+
+
+
+// ### 2. Analisi completa e in sottofondo ### //
+
+
+// Tutti i canali devono essere nella banda della radio
+//
+static bool canaliSpettroValidi(uint8_t nrCanali, uint32_t frequenzaBase, uint32_t spaziatura) {
+    uint32_t ultima = frequenzaBase + (uint32_t)(nrCanali - 1) * spaziatura;
+    return nrCanali && frequenzaBase >= 290000000UL && ultima <= 1020000000UL && ultima >= frequenzaBase;
+}
+
+
+int RFM69::analizzaSpettro(CanaleSpettro canali[], uint8_t nrCanali, uint32_t frequenzaBase,
+                           uint32_t spaziatura, uint8_t nrPassate) {
+
+    if(!canaliSpettroValidi(nrCanali, frequenzaBase, spaziatura) || nrPassate == 0)
+        return Errore::analisiSpettroImpossibile;
+    if(!radioPronta(true)) return Errore::analisiSpettroImpossibile;
+
+    for(uint8_t i = 0; i < nrCanali; i++) {
+        canali[i].somma = 0;
+        canali[i].nrMisure = 0;
+    }
+
+    for(uint8_t p = 0; p < nrPassate; p++) {
+        for(uint8_t i = 0; i < nrCanali; i++) {
+            registraMisuraSpettro(canali[i], misuraRssiCanale(frequenzaBase + (uint32_t)i * spaziatura));
+        }
+    }
+
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+
+    return Errore::ok;
+}
+
+
+int RFM69::avviaAnalisiSpettro(CanaleSpettro canali[], uint8_t nrCanali, uint32_t frequenzaBase,
+                               uint32_t spaziatura, uint16_t intervalloMs) {
+
+    if(!canaliSpettroValidi(nrCanali, frequenzaBase, spaziatura))
+        return Errore::analisiSpettroImpossibile;
+
+    for(uint8_t i = 0; i < nrCanali; i++) {
+        canali[i].somma = 0;
+        canali[i].nrMisure = 0;
+    }
+
+    canaliSpettro = canali;
+    nrCanaliSpettro = nrCanali;
+    frequenzaBaseSpettro = frequenzaBase;
+    spaziaturaSpettro = spaziatura;
+    intervalloSpettro = intervalloMs;
+    prossimoCanaleSpettro = 0;
+    tempoUltimaMisuraSpettro = millis();
+
+    return Errore::ok;
+}
+
+
+void RFM69::controllaAnalisiSpettro() {
+
+    if(millis() - tempoUltimaMisuraSpettro < intervalloSpettro) return;
+    tempoUltimaMisuraSpettro = millis();
+
+    uint8_t i = prossimoCanaleSpettro;
+    registraMisuraSpettro(canaliSpettro[i], misuraRssiCanale(frequenzaBaseSpettro + (uint32_t)i * spaziaturaSpettro));
+    prossimoCanaleSpettro = (i + 1) % nrCanaliSpettro;
+
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+}
@@ -0,0 +1,84 @@
+/*! @file
+
+@brief Stima della qualità dei collegamenti per corrispondente
+
+1. Tabella
+2. Aggiornamento
+
+Le medie sono esponenziali con peso 1/8, in aritmetica intera: ogni
+messaggio costa poche operazioni e nessuna divisione per un numero di
+campioni. L'ETX è ricalcolato a ogni invio, così leggerlo non costa nulla.
+*/
+
+#include "RFM69.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Tabella ### //
+
+
+void RFM69::attivaStimaCollegamenti(StimaCollegamento tabella[], uint8_t nrCorrispondenti) {
+    for(uint8_t i = 0; i < nrCorrispondenti; i++) azzeraStima(tabella[i]);
+    tabellaCollegamenti = tabella;
+    nrCorrispondentiCollegamenti = nrCorrispondenti;
+}
+
+
+void RFM69::disattivaStimaCollegamenti() {
+    tabellaCollegamenti = nullptr;
+    nrCorrispondentiCollegamenti = 0;
+}
+
+
+void RFM69::azzeraStima(StimaCollegamento& stima) {
+    stima.rssi16 = 0;
+    stima.prr = prrIniziale;
+    stima.etx16 = 16 * 255 / prrIniziale;
+    stima.inviati = 0;
+    stima.ritrasmissioni = 0;
+    stima.ricevuti = 0;
+    stima.ultimoContatto = 0;
+}
+
+
+
+// ### 2. Aggiornamento ### //
+
+
+void RFM69::registraRicezioneStima(StimaCollegamento& stima, int8_t rssi) {
+    int16_t campione = (int16_t)rssi * 16;
+    // il primo messaggio è la stima migliore che si abbia
+    if(stima.ricevuti == 0) stima.rssi16 = campione;
+    else stima.rssi16 += (campione - stima.rssi16) / 8;
+    if(stima.ricevuti < 0xFFFF) ++stima.ricevuti;
+    stima.ultimoContatto = millis();
+}
+
+
+void RFM69::registraInvioStima(StimaCollegamento& stima, bool ack) {
+    int16_t esito = ack ? 255 : 0;
+    stima.prr += (esito - stima.prr) / 8;
+    // con la media intera il PRR resta tra 7 e 248, quindi l'ETX è finito
+    stima.etx16 = 16 * 255 / stima.prr;
+    if(stima.inviati < 0xFFFF) ++stima.inviati;
+    if(!ack && stima.ritrasmissioni < 0xFFFF) ++stima.ritrasmissioni;
+}
+
+
+// I messaggi mesh hanno il mittente nell'intestazione: con il mesh attivo
+// sono attribuiti al vicino giusto da esaminaMessaggioMesh()
+//
+void RFM69::registraRicezioneCollegamento() {
+    if(mesh) return;
+    uint8_t c = corrispondenteAttuale();
+    if(c < nrCorrispondentiCollegamenti) registraRicezioneStima(tabellaCollegamenti[c], ultimoMessaggio.rssi);
+}
+
+
+void RFM69::registraInvioCollegamento(bool ack) {
+    if(mesh) return;
+    uint8_t c = corrispondenteAttuale();
+    if(c < nrCorrispondentiCollegamenti) registraInvioStima(tabellaCollegamenti[c], ack);
+}
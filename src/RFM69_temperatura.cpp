@@ -0,0 +1,124 @@
+/*! @file
+
+@brief Sensore di temperatura e compensazione della deriva del quarzo
+
+1. Misura
+2. Compensazione
+
+Il registro Temp2 diminuisce di 1 per ogni °C; il valore assoluto dipende dal
+singolo chip. Senza calibrazione è usata la stessa stima della libreria
+LowPowerLab: [°C = 165 - Temp2], con un errore di qualche grado.
+*/
+
+#include "RFM69.h"
+#include "RFM69_registri.h"
+
+#include <Arduino.h>
+
+
+
+// ### 1. Misura ### //
+
+
+int RFM69::avviaMisuraTemperatura() {
+    if(!radioPronta(false)) return Errore::temperaturaImpossibile;
+    // il sensore funziona solo in standby o FS
+    disattivaAutoModes();
+    cambiaModalita(Modalita::standby, true);
+    // TempMeasStart
+    bus->scriviRegistro(RFM69_4E_TEMP_1, 1 << 3);
+    return Errore::ok;
+}
+
+
+bool RFM69::temperaturaPronta() {
+    // TempMeasRunning
+    return !(bus->leggiRegistro(RFM69_4E_TEMP_1) & (1 << 2));
+}
+
+
+int8_t RFM69::temperatura() {
+    temperaturaGrezza = bus->leggiRegistro(RFM69_4F_TEMP_2);
+    richiestaModalitaDefaultAppenaPossibile = true;
+    controlla();
+    return 165 - temperaturaGrezza + calibrazioneTemperatura;
+}
+
+
+void RFM69::calibraTemperatura(int8_t gradiReali) {
+    calibrazioneTemperatura = gradiReali - (165 - temperaturaGrezza);
+}
+
+
+
+// ### 2. Compensazione ### //
+
+
+int RFM69::attivaCompensazioneTemperatura(const PuntoTemperatura tabella[], uint8_t nrPunti,
+                                          uint16_t intervalloS) {
+    if(nrPunti == 0) return Errore::temperaturaImpossibile;
+    tabellaTemperatura = tabella;
+    nrPuntiTemperatura = nrPunti;
+    intervalloTemperatura = intervalloS;
+    // la prima misura parte alla prossima chiamata a controlla()
+    tempoUltimaTemperatura = millis() - (uint32_t)intervalloS * 1000;
+    return Errore::ok;
+}
+
+
+void RFM69::disattivaCompensazioneTemperatura() {
+    tabellaTemperatura = nullptr;
+    nrPuntiTemperatura = 0;
+    if(correzioneTemperatura == 0) return;
+    correzioneTemperatura = 0;
+    if(stato == Stato::passivo) scriviFrequenza();
+}
+
+
+// Interpolazione lineare tra i due punti più vicini
+//
+int16_t RFM69::erroreQuarzo(int8_t gradi) {
+    const PuntoTemperatura* t = tabellaTemperatura;
+    if(gradi <= t[0].gradi) return t[0].erroreDecimiPpm;
+    for(uint8_t i = 1; i < nrPuntiTemperatura; i++) {
+        if(gradi <= t[i].gradi) {
+            int16_t dx = t[i].gradi - t[i - 1].gradi;
+            int32_t dy = t[i].erroreDecimiPpm - t[i - 1].erroreDecimiPpm;
+            return t[i - 1].erroreDecimiPpm + dy * (gradi - t[i - 1].gradi) / dx;
+        }
+    }
+    return t[nrPuntiTemperatura - 1].erroreDecimiPpm;
+}
+
+
+// Chiamata da controlla() quando la radio è libera. La misura è breve (circa
+// 100 us) e si fa in standby, dove va scritta anche la nuova frequenza: per
+// questo è fatta qui tutta insieme invece che in più chiamate.
+//
+void RFM69::controllaCompensazioneTemperatura() {
+
+    if(millis() - tempoUltimaTemperatura < (uint32_t)intervalloTemperatura * 1000) return;
+    tempoUltimaTemperatura = millis();
+
+    disattivaAutoModes();
+    cambiaModalita(Modalita::standby, true);
+    bus->scriviRegistro(RFM69_4E_TEMP_1, 1 << 3);
+    uint32_t inizio = micros();
+    while(!temperaturaPronta()) {
+        if(micros() - inizio > timeoutTemperaturaUs) {
+            richiestaModalitaDefaultAppenaPossibile = true;
+            controlla();
+            return;
+        }
+    }
+    temperaturaGrezza = bus->leggiRegistro(RFM69_4F_TEMP_2);
+    int8_t gradi = 165 - temperaturaGrezza + calibrazioneTemperatura;
+
+    // un quarzo troppo veloce alza la frequenza reale: i registri Frf vanno
+    // abbassati della stessa frazione
+    int16_t errore = erroreQuarzo(gradi);
+    correzioneTemperatura = -(int32_t)((int64_t)frfNominale * errore / 10000000);
+
+    // scrive la frequenza e torna nella modalità default
+    scriviFrequenza();
+}